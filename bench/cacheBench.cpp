@@ -0,0 +1,121 @@
+/*
+ * cacheBench.cpp
+ * Lookups per second of a cacheLevel for 4 to 32 ways,
+ * with LRU and PLRU. The accesses are the loads and
+ * stores of a kernel run on mipsPipelined, captured
+ * from its data side, half of them random over 128K and
+ * half sequential. The cycles the level returned and its
+ * misses must not change between the SSE2 build, the one
+ * with -mavx2 and the one with -DCACHE_SCALAR.
+ */
+#include "../processor/mipsPipelined.h"
+#include "../processor/register_file.h"
+#include "../memory/memory.h"
+#include "../memory/cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <sys/time.h>
+
+using namespace std;
+
+#define MEM_BYTES	0x200000
+#define REPLAYS		200
+#define L1_BYTES	0x8000
+#define LINE_BYTES	32
+
+static const uint32_t kernel[] = {
+	0x34034000,		// ori $3,$0,0x4000
+	0x3c041234,		// lui $4,0x1234
+	0x34845678,		// ori $4,$4,0x5678
+	0x3c050010,		// lui $5,0x10
+				// loop: xorshift $4
+	0x00044340,		// sll $8,$4,13
+	0x00882026,		// xor $4,$4,$8
+	0x00044442,		// srl $8,$4,17
+	0x00882026,		// xor $4,$4,$8
+	0x00044140,		// sll $8,$4,5
+	0x00882026,		// xor $4,$4,$8
+	0x308a7ffc,		// andi $10,$4,0x7ffc
+	0x000a5080,		// sll $10,$10,2
+	0x01455020,		// add $10,$10,$5
+	0x8d4b0000,		// lw $11,0($10)
+	0x012b4820,		// add $9,$9,$11
+	0xad490000,		// sw $9,0($10)
+	0x8ccc0000,		// lw $12,0($6)
+	0x20c60004,		// addi $6,$6,4
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fff0,		// bne $3,$0,loop
+	0x00000000		// nop
+};
+
+//a data cache that always hits, and keeps the address of every access with the low bit set for stores
+class captureLevel : public memoryLevel {
+
+public:
+	uint32_t read( uint32_t addr ) { stream.push_back( addr & ~1U ); return 1; }
+	uint32_t write( uint32_t addr ) { stream.push_back( addr | 1 ); return 1; }
+
+	vector<uint32_t> stream;
+
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void measure( const vector<uint32_t> &stream, uint32_t ways, uint8_t policy )
+{
+	cacheConfig config = { L1_BYTES, ways, LINE_BYTES, 1, policy, WRITE_BACK };
+	mainMemory memory( 20 );
+	cacheLevel l1( "L1D", config, &memory );
+	uint64_t cycles = 0;
+	double start = now();
+
+	for( int r=0; r<REPLAYS; ++r )
+		for( size_t i=0; i<stream.size(); ++i ) {
+			uint32_t a = stream[i];
+			cycles += ( a & 1 ) ? l1.write( a & ~1U ) : l1.read( a );
+		}
+
+	double secs = now() - start;
+	const cacheStats &st = l1.getStats();
+	printf( "%2u ways %-5s %8.2f M lookups/s  misses %llu  writebacks %llu  cycles %llu\n", ways,
+		policy == REPLACE_LRU ? "LRU" : "PLRU", REPLAYS * stream.size() / secs / 1e6,
+		(unsigned long long)( st.readMisses + st.writeMisses ), (unsigned long long) st.writebacks,
+		(unsigned long long) cycles );
+}
+
+int main()
+{
+	Memory *mem = new simpleMemory<BIG_END>( MEM_BYTES );
+	for( uint32_t i=0; i<sizeof( kernel ) / 4; ++i )
+		mem->storeWord( 4*i, kernel[i] );
+
+	RegisterFile regs;
+	captureLevel capture;
+	mipsPipelined proc( mem, &regs, 0, sizeof( kernel ) - 4 );
+	proc.setCaches( NULL, &capture );
+	runResult res = proc.run( UINT64_MAX );
+	if( res.status != RUN_DONE )
+		printf( "%s after %llu cycles\n", proc.runError().c_str(), (unsigned long long) res.cycles );
+
+#ifdef CACHE_SCALAR
+	printf( "scalar, " );
+#elif defined( __AVX2__ )
+	printf( "AVX2, " );
+#elif defined( __SSE2__ )
+	printf( "SSE2, " );
+#endif
+	printf( "%zu accesses replayed %d times into %dK with %d byte lines\n", capture.stream.size(), REPLAYS,
+		L1_BYTES / 1024, LINE_BYTES );
+
+	for( uint32_t ways=4; ways<=32; ways *= 2 ) {
+		measure( capture.stream, ways, REPLACE_LRU );
+		measure( capture.stream, ways, REPLACE_PLRU );
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * coreBench.cpp
+ * Instructions per second of the functional cores on
+ * the same loop, and a check that each ends with the
+ * same registers and memory as simpleProcessor.
+ * The tiers of jitProcessor are reported apart, and the
+ * loop is run once more with its verification on.
+ */
+#include "../processor/processor.h"
+#include "../processor/threadedProcessor.h"
+#include "../processor/blockProcessor.h"
+#include "../processor/jitProcessor.h"
+#include <stdio.h>
+#include <string>
+#include <sys/time.h>
+
+using namespace std;
+
+#define ITERATIONS	0x100000
+#define DATA		0x1000
+
+static const uint32_t program[] = {
+	0x3c030010,		// lui $3,0x10
+	0x20051000,		// addi $5,$0,0x1000
+	0x20840003,		// loop: addi $4,$4,3
+	0x00833026,		// xor $6,$4,$3
+	0x00c03880,		// sll $7,$6,2
+	0xaca70000,		// sw $7,0($5)
+	0x8ca80000,		// lw $8,0($5)
+	0x01284820,		// add $9,$9,$8
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fff9,		// bne $3,$0,loop
+	0x200a0001		// addi $10,$0,1
+};
+
+#define WORDS		( sizeof( program ) / 4 )
+#define EXECUTED	( 3.0 + 8.0 * ITERATIONS )
+
+struct result {
+	RegisterFile *regs;
+	Memory *mem;
+	double secs;
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Both processors leave the text area through the
+ * "pc out of range" exception.
+ */
+template <class proc>
+static result measure()
+{
+	result res;
+	res.regs = new RegisterFile();
+	res.mem = new simpleMemory<BIG_END>( 0x10000 );
+	for( uint32_t i=0; i<WORDS; ++i )
+		res.mem->storeWord( 4*i, program[i] );
+
+	proc p( res.mem, res.regs, 0, 4*( WORDS-1 ) );
+	double start = now();
+	try {
+		p.run();
+	} catch( string msg ) {
+	}
+	res.secs = now() - start;
+	return res;
+}
+
+static bool same( const result &a, const result &b )
+{
+	for( int i=0; i<REG_NR; ++i )
+		if( a.regs->getReg( i ) != b.regs->getReg( i ) )
+			return false;
+	if( a.regs->getHI() != b.regs->getHI() || a.regs->getLO() != b.regs->getLO() )
+		return false;
+	return a.mem->loadWord( DATA ) == b.mem->loadWord( DATA );
+}
+
+template <class proc>
+static bool report( const char *name, const result &simple )
+{
+	result res = measure<proc>();
+	bool ok = same( simple, res );
+	printf( "%-20s %10.1f M instr/s %8.2fx  %s\n", name, EXECUTED / res.secs / 1e6,
+		simple.secs / res.secs, ok ? "identical" : "DIFFERS" );
+	return ok;
+}
+
+//instructions and share of the ticks each tier of jitProcessor took
+static void tiers()
+{
+	RegisterFile regs;
+	simpleMemory<BIG_END> mem( 0x10000 );
+	for( uint32_t i=0; i<WORDS; ++i )
+		mem.storeWord( 4*i, program[i] );
+
+	jitProcessor p( &mem, &regs, 0, 4*( WORDS-1 ) );
+	try {
+		p.run();
+	} catch( string msg ) {
+	}
+
+	static const char *const names[ TIER_COUNT ] = { "interpreter", "blocks", "native" };
+	const tierStats &st = p.stats();
+	uint64_t total = st.translateCycles;
+	for( int i=0; i<TIER_COUNT; ++i )
+		total += st.cycles[i];
+
+	for( int i=0; i<TIER_COUNT; ++i )
+		printf( "  %-18s %12llu instr %6.2f%% of ticks\n", names[i],
+			(unsigned long long) st.instructions[i], 100.0 * st.cycles[i] / total );
+	printf( "  %-18s %18s %6.2f%% of ticks\n", "translation", "", 100.0 * st.translateCycles / total );
+}
+
+/*
+ * Every instruction translated on its own and checked
+ * against simpleProcessor. The loop leaves through the
+ * same exception, anything else thrown is a mismatch.
+ */
+static bool verified( const result &simple )
+{
+	RegisterFile regs;
+	simpleMemory<BIG_END> mem( 0x10000 );
+	for( uint32_t i=0; i<WORDS; ++i )
+		mem.storeWord( 4*i, program[i] );
+
+	jitProcessor p( &mem, &regs, 0, 4*( WORDS-1 ) );
+	p.setWarmThreshold( 0 );
+	p.setVerify( true );
+	string error;
+	double start = now();
+	try {
+		p.run();
+	} catch( string msg ) {
+		if( msg.find( "jit verification" ) != string::npos )
+			error = msg;
+	}
+	double secs = now() - start;
+
+	result res = { &regs, &mem, secs };
+	bool ok = error.empty() && same( simple, res );
+	printf( "%-20s %10.1f M instr/s %10s %s\n", "jitProcessor verify", EXECUTED / secs / 1e6, "",
+		ok ? "identical" : error.empty() ? "DIFFERS" : error.c_str() );
+	return ok;
+}
+
+int main()
+{
+	result simple = measure<simpleProcessor>();
+	printf( "%-20s %10.1f M instr/s\n", "simpleProcessor", EXECUTED / simple.secs / 1e6 );
+
+	bool ok = true;
+	ok &= report<threadedProcessor>( "threadedProcessor", simple );
+	ok &= report<blockProcessor>( "blockProcessor", simple );
+	ok &= report<jitProcessor>( "jitProcessor", simple );
+	tiers();
+	ok &= verified( simple );
+
+	return ok ? 0 : 1;
+}
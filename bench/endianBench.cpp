@@ -0,0 +1,115 @@
+/*
+ * endianBench.cpp
+ * Loads and stores per second of the byte order specialized
+ * simpleMemory, for both guest orders, against the previous 
+ * implementation which tested the byte order on every access.
+ * All accesses go through a Memory pointer, like the 
+ * processors do.
+ */
+#include "../memory/memory.h"
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+
+#define SIZE	( 1U << 20 )
+#define OPS	( 1U << 26 )
+
+
+/*
+ * The previous flat memory, byte order chosen at runtime.
+ * Kept here only as a baseline.
+ */
+class legacyMemory : public Memory {
+
+public:
+	legacyMemory( uint32_t size, endian order ) : byteOrder( order ), mem_size( size ) { mem = new uint8_t[ size ](); }
+	~legacyMemory() { delete [] mem; }
+
+	uint32_t loadWord( uint32_t addr );
+	void storeWord( uint32_t addr, uint32_t val );
+
+	uint16_t loadHalfWord( uint32_t addr ) { return 0; }
+	void storeHalfWord( uint32_t addr, uint16_t val ) {}
+	uint8_t loadByte( uint32_t addr ) { return mem[addr]; }
+	void storeByte( uint32_t addr, uint8_t val ) { mem[addr] = val; }
+
+private:
+	endian byteOrder;
+	uint8_t *mem;
+	uint32_t mem_size;
+};
+
+//out of line like the real backends, which live in memory.cpp
+__attribute__(( noinline )) uint32_t legacyMemory::loadWord( uint32_t addr )
+{
+	if( addr % 4 != 0 )
+		throw "Memory addresses should be word aligned";
+	if( addr >= mem_size )
+		throw "Address requested is out of bounds";
+
+	uint32_t ret;
+	if( byteOrder == BIG_END )
+		memcpy( &ret, &mem[addr], 4 );
+	else {
+		ret = mem[addr+3];
+		for( int i=2; i>=0; --i) {
+			ret = ret << 8;
+			ret = ret | mem[addr+i];
+		}
+	}
+	return ret;
+}
+
+__attribute__(( noinline )) void legacyMemory::storeWord( uint32_t addr, uint32_t val )
+{
+	if( addr % 4 != 0 )
+		throw "Memory addresses should be word aligned";
+	if( addr >= mem_size )
+		throw "Address requested is out of bounds";
+
+	if( byteOrder == BIG_END )
+		memcpy( &mem[addr], &val, 4 );
+	else {
+		for( int i=0; i<4; ++i ) {
+			mem[addr+i] = val & 0x000000ff;
+			val = val >> 8;
+		}
+	}
+}
+
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//kept out of line so calls stay virtual for every backend
+static void __attribute__(( noinline )) run( const char *name, Memory *mem )
+{
+	uint32_t sum = 0;
+
+	double t0 = now();
+	for( uint32_t i=0; i<OPS; ++i )
+		mem->storeWord( ( i * 4 ) & ( SIZE - 1 ), i );
+	double t1 = now();
+	for( uint32_t i=0; i<OPS; ++i )
+		sum += mem->loadWord( ( i * 4 ) & ( SIZE - 1 ) );
+	double t2 = now();
+
+	printf( "%-16s stores: %7.1f M/s\tloads: %7.1f M/s\t(checksum %x)\n",
+			name, OPS / ( t1 - t0 ) / 1e6, OPS / ( t2 - t1 ) / 1e6, sum );
+	delete mem;
+}
+
+int main()
+{
+	run( "legacy BIG_END", new legacyMemory( SIZE, BIG_END ) );
+	run( "legacy LITTLE_END", new legacyMemory( SIZE, LITTLE_END ) );
+	run( "BIG_END", new simpleMemory<BIG_END>( SIZE ) );
+	run( "LITTLE_END", new simpleMemory<LITTLE_END>( SIZE ) );
+
+	return 0;
+}
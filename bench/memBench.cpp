@@ -0,0 +1,159 @@
+/*
+ * memBench.cpp
+ * Compares the flat simpleMemory against the demand-paged 
+ * pagedMemory and the reservedMemory for a full sized 
+ * address space. Each backend runs in its own process so 
+ * that startup time and resident set size are not polluted 
+ * by the other ones.
+ */
+#include "../memory/memory.h"
+#include "../memory/pagedMemory.h"
+#include "../memory/reservedMemory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+//same layout as processor.h and register_file.h
+#define MEM_SIZE	0x7ffffffd
+#define DATA_LOW	0x10000000
+#define TEXT_LOW	0x00400000
+#define STACK_MAX	0x7ffffffc
+
+//footprint of a typical test program
+#define TEXT_BYTES	( 64 * 1024 )
+#define DATA_BYTES	( 256 * 1024 )
+#define STACK_BYTES	( 64 * 1024 )
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//VmSize and VmRSS in KB, read from /proc
+static void memUsage( long *vsz, long *rss )
+{
+	char line[256];
+	FILE *f = fopen( "/proc/self/status", "r" );
+
+	*vsz = *rss = -1;
+	if( f == NULL )
+		return;
+
+	while( fgets( line, sizeof( line ), f ) ) {
+		if( strncmp( line, "VmSize:", 7 ) == 0 )
+			*vsz = atol( line + 7 );
+		else if( strncmp( line, "VmRSS:", 6 ) == 0 )
+			*rss = atol( line + 6 );
+	}
+	fclose( f );
+}
+
+static void touch( Memory *mem, uint32_t start, uint32_t bytes )
+{
+	for( uint32_t a = start; a < start + bytes; a += 4 )
+		mem->storeWord( a, a );
+}
+
+//reads what touch() wrote, false if any word differs
+static bool readBack( Memory *mem, uint32_t start, uint32_t bytes )
+{
+	bool ok = true;
+	for( uint32_t a = start; a < start + bytes; a += 4 )
+		ok &= mem->loadWord( a ) == a;
+	return ok;
+}
+
+typedef enum {
+	BACKEND_FLAT,
+	BACKEND_PAGED,
+	BACKEND_RESERVED
+} backend;
+
+/*
+ * Two accesses outside the committed regions before the
+ * fault is cleared, as a fetch and a load can do in one
+ * pipeline cycle. The first one is to be reported.
+ */
+static void faults( reservedMemory<BIG_END> *mem )
+{
+	uint32_t first = DATA_LOW + 2 * DATA_BYTES;
+	uint32_t word = mem->loadWord( first );
+	mem->storeWord( first + 0x100000, 1 );
+	bool ok = word == 0 && mem->fault() == LOAD_FAULT && mem->faultAddr() == first;
+	mem->clearFault();
+	ok &= mem->fault() == NO_FAULT && mem->loadWord( first + 0x100000 ) == 0;
+	mem->clearFault();
+	printf( "%-8s two faults pending: %s\n", "", ok ? "first reported" : "WRONG" );
+}
+
+static void run( const char *name, backend kind )
+{
+	long vsz0, rss0, vsz, rss;
+	memUsage( &vsz0, &rss0 );
+
+	double t0 = now();
+	Memory *mem;
+	pagedMemory<BIG_END> *paged = NULL;
+	reservedMemory<BIG_END> *reserved = NULL;
+	if( kind == BACKEND_PAGED )
+		mem = paged = new pagedMemory<BIG_END>( MEM_SIZE );
+	else if( kind == BACKEND_RESERVED ) {
+		mem = reserved = new reservedMemory<BIG_END>();
+		reserved->commit( TEXT_LOW, TEXT_BYTES );
+		reserved->commit( DATA_LOW, DATA_BYTES );
+		reserved->commit( ( STACK_MAX & ~3 ) - STACK_BYTES, STACK_BYTES );
+	} else
+		mem = new simpleMemory<BIG_END>( MEM_SIZE );
+	double t1 = now();
+
+	touch( mem, TEXT_LOW, TEXT_BYTES );
+	touch( mem, DATA_LOW, DATA_BYTES );
+	touch( mem, ( STACK_MAX & ~3 ) - STACK_BYTES, STACK_BYTES );
+	double t2 = now();
+
+	memUsage( &vsz, &rss );
+	printf( "%-8s construct: %8.3f ms\tload program: %8.3f ms\tVmSize: +%8ld KB\tVmRSS: +%6ld KB\n",
+			name, ( t1 - t0 ) * 1e3, ( t2 - t1 ) * 1e3, vsz - vsz0, rss - rss0 );
+
+	if( paged != NULL ) {
+		bool ok = readBack( mem, TEXT_LOW, TEXT_BYTES );
+		ok &= readBack( mem, DATA_LOW, DATA_BYTES );
+		ok &= readBack( mem, ( STACK_MAX & ~3 ) - STACK_BYTES, STACK_BYTES );
+		if( !ok )
+			printf( "%-8s read back WRONG\n", name );
+		paged->printTLBStats();
+	}
+	if( reserved != NULL )
+		faults( reserved );
+
+	delete mem;
+}
+
+int main()
+{
+	const char *names[] = { "flat", "paged", "reserved" };
+
+	for( int i=0; i<3; ++i ) {
+		pid_t pid = fork();
+		if( pid == 0 ) {
+			try {
+				run( names[i], (backend) i );
+			} catch( char const *msg ) {
+				printf( "%-8s failed: %s\n", names[i], msg );
+			} catch( ... ) {
+				printf( "%-8s failed: allocation error\n", names[i] );
+			}
+			exit( 0 );
+		}
+		waitpid( pid, NULL, 0 );
+	}
+
+	return 0;
+}
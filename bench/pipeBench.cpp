@@ -0,0 +1,694 @@
+/*
+ * pipeBench.cpp
+ * Simulated cycles per second of mipsPipelined on a
+ * long straight-line kernel, with a checksum of the
+ * registers so that runs can be compared, and where
+ * the stall cycles came from, for each bypass path.
+ * A second kernel is mostly loads and stores, run again
+ * with every access traced to a file, and a
+ * third a loop calling a function, for each way of
+ * handling branches. One takes an exception of every kind
+ * and an interrupt, stopping at the vector and back at EPC
+ * each time. Then one with a branch taken every
+ * fourth time and a random one, for the predictors. The
+ * last ones walk an array, for the data cache, and gather
+ * from four places of it, for the MSHRs and store buffer
+ * of a non-blocking one, and both again for the prefetchers
+ * and over DRAM banks instead of a flat memory.
+ */
+#include "../processor/mipsPipelined.h"
+#include "../processor/register_file.h"
+#include "../memory/memory.h"
+#include "../memory/dram.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <time.h>
+
+using namespace std;
+
+#define REPEAT		0x8000
+#define RUNS		4
+#define DATA		0x1f0000
+#define MEM_BYTES	0x200000
+#define ARRAY		0x180000
+#define ARRAY_BYTES	0x8000
+#define TRAP_VECTOR	0x08
+#define TRAP_MAIN	0x80
+#define TRAP_LOG	0x1f0100
+
+typedef enum {
+	NO_PREFETCH,
+	NEXT_LINE,
+	STRIDE,
+	STREAM
+} prefetchKind;
+
+static const uint32_t prologue[] = {
+	0x3c030010,		// lui $3,0x10
+	0x3c05001f		// lui $5,0x1f
+};
+
+static const uint32_t body[] = {
+	0x20840003,		// addi $4,$4,3
+	0x00833026,		// xor $6,$4,$3
+	0x00c03880,		// sll $7,$6,2
+	0xaca70000,		// sw $7,0($5)
+	0x8ca80000,		// lw $8,0($5)
+	0x01284820,		// add $9,$9,$8
+	0x2063ffff,		// addi $3,$3,-1
+	0x354a0001		// ori $10,$10,1
+};
+
+static const uint32_t memBody[] = {
+	0x8ca80000,		// lw $8,0($5)
+	0xaca80004,		// sw $8,4($5)
+	0x84a90002,		// lh $9,2($5)
+	0xa0a90008,		// sb $9,8($5)
+	0x8caa0004,		// lw $10,4($5)
+	0xacaa000c,		// sw $10,12($5)
+	0x90ab0008,		// lbu $11,8($5)
+	0xa4ab0010		// sh $11,16($5)
+};
+
+//the delay slots hold nops, so that every branch setting gets the same registers
+static const uint32_t loop[] = {
+	0x3c05001f,		// lui $5,0x1f
+	0x34034000,		// ori $3,$0,0x4000
+	0x08000008,		// j loop
+	0x00000000,		// nop
+				// func:
+	0x00833026,		// xor $6,$4,$3
+	0xaca60000,		// sw $6,0($5)
+	0x03e00008,		// jr $31
+	0x00000000,		// nop
+				// loop:
+	0x20840003,		// addi $4,$4,3
+	0x0c000004,		// jal func
+	0x00000000,		// nop
+	0x8ca80000,		// lw $8,0($5)
+	0x01284820,		// add $9,$9,$8
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fff9,		// bne $3,$0,loop
+	0x00000000,		// nop
+	0x341f0000		// ori $31,$0,0
+};
+
+static const uint32_t patterns[] = {
+	0x34034000,		// ori $3,$0,0x4000
+	0x3c041234,		// lui $4,0x1234
+	0x34845678,		// ori $4,$4,0x5678
+				// loop:
+	0x30660003,		// andi $6,$3,3
+	0x10c00002,		// beq $6,$0,1f
+	0x00000000,		// nop
+	0x21290001,		// addi $9,$9,1
+				// 1: xorshift $4
+	0x00044340,		// sll $8,$4,13
+	0x00882026,		// xor $4,$4,$8
+	0x00044442,		// srl $8,$4,17
+	0x00882026,		// xor $4,$4,$8
+	0x00044140,		// sll $8,$4,5
+	0x00882026,		// xor $4,$4,$8
+	0x308a0100,		// andi $10,$4,0x100
+	0x15400002,		// bne $10,$0,2f
+	0x00000000,		// nop
+	0x216b0001,		// addi $11,$11,1
+				// 2:
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fff0,		// bne $3,$0,loop
+	0x00000000		// nop
+};
+
+/*
+ * A handler at TRAP_VECTOR logging EPC, Cause and BadVAddr
+ * from $20 on. It returns past the instruction that raised
+ * the exception, and past its branch too in a delay slot,
+ * or for an interrupt to the instruction that took it.
+ */
+static const uint32_t trapHandler[] = {
+	0x08000020,		// j main
+	0x00000000,		// nop
+	0x401a7000,		// handler: mfc0 $26,$14 (EPC)
+	0x401b6800,		// mfc0 $27,$13 (Cause)
+	0x40184000,		// mfc0 $24,$8 (BadVAddr)
+	0xae9a0000,		// sw $26,0($20)
+	0xae9b0004,		// sw $27,4($20)
+	0xae980008,		// sw $24,8($20)
+	0x2294000c,		// addi $20,$20,12
+	0x3379007c,		// andi $25,$27,0x7c
+	0x13200007,		// beq $25,$0,back
+	0x00000000,		// nop
+	0x001bcfc2,		// srl $25,$27,31
+	0x0019c880,		// sll $25,$25,2
+	0x235a0004,		// addi $26,$26,4
+	0x0359d020,		// add $26,$26,$25
+	0x409a7000,		// mtc0 $26,$14
+	0x00000000,		// nop
+	0x42000018		// back: eret
+};
+
+//at TRAP_MAIN, AdEL, AdES in a delay slot, SYSCALL, RI and BREAK, then a loop to interrupt
+static const uint32_t traps[] = {
+	0x3c05001f,		// main: lui $5,0x1f
+	0x34b40100,		// ori $20,$5,0x100
+	0x8ca10002,		// lw $1,2($5)
+	0x20020005,		// addi $2,$0,5
+	0x10000003,		// beq $0,$0,1f
+	0xaca20001,		// sw $2,1($5)
+	0x20030007,		// addi $3,$0,7
+	0x20630001,		// addi $3,$3,1
+	0x0000000c,		// 1: syscall
+	0x20060001,		// addi $6,$0,1
+	0xfc000000,		// reserved opcode
+	0x0000000d,		// break
+	0x34070401,		// ori $7,$0,0x401
+	0x40876000,		// mtc0 $7,$12 (Status: IE, IM2)
+	0x20090040,		// addi $9,$0,0x40
+	0x2129ffff,		// 2: addi $9,$9,-1
+	0x1520fffe,		// bne $9,$0,2b
+	0x00000000,		// nop
+	0x200a0001,		// addi $10,$0,1
+	0x200b0002		// addi $11,$0,2
+};
+
+//what the vector sees for each exception of traps, and where the handler goes back to
+struct trapStop {
+	uint32_t epc;
+	uint32_t cause;		//BD and the exception code
+	uint32_t badVAddr;
+	uint32_t back;
+};
+
+static const trapStop trapStops[] = {
+	{ 0x88, 4 << 2, 0x1f0002, 0x8c },		//AdEL
+	{ 0x90, 0x80000000 | 5 << 2, 0x1f0001, 0x98 },	//AdES, EPC at the branch
+	{ 0xa0, 8 << 2, 0x1f0001, 0xa4 },		//SYSCALL
+	{ 0xa8, 10 << 2, 0x1f0001, 0xac },		//RI
+	{ 0xac, 9 << 2, 0x1f0001, 0xb0 }		//BREAK
+};
+
+#define TRAP_STOPS	( sizeof( trapStops ) / sizeof( trapStops[0] ) )
+#define TRAP_LOOP	0xbc
+
+//four passes over ARRAY_BYTES, adding up and storing the running sum
+static const uint32_t walk[] = {
+	0x34070004,		// ori $7,$0,4
+				// outer:
+	0x3c050018,		// lui $5,0x18
+	0x34032000,		// ori $3,$0,0x2000
+				// inner:
+	0x8ca80000,		// lw $8,0($5)
+	0x01284820,		// add $9,$9,$8
+	0xaca90000,		// sw $9,0($5)
+	0x20a50004,		// addi $5,$5,4
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fffa,		// bne $3,$0,inner
+	0x00000000,		// nop
+	0x20e7ffff,		// addi $7,$7,-1
+	0x14e0fff5,		// bne $7,$0,outer
+	0x00000000		// nop
+};
+
+//four loads of lines in different sets, then their sum is stored
+static const uint32_t gather[] = {
+	0x34030400,		// ori $3,$0,0x400
+	0x3c050018,		// lui $5,0x18
+				// loop:
+	0x8ca80000,		// lw $8,0($5)
+	0x8caa2020,		// lw $10,0x2020($5)
+	0x8cab4040,		// lw $11,0x4040($5)
+	0x8cac6060,		// lw $12,0x6060($5)
+	0x01284820,		// add $9,$9,$8
+	0x012a4820,		// add $9,$9,$10
+	0x012b4820,		// add $9,$9,$11
+	0x012c4820,		// add $9,$9,$12
+	0xaca97080,		// sw $9,0x7080($5)
+	0x20a50004,		// addi $5,$5,4
+	0x2063ffff,		// addi $3,$3,-1
+	0x1460fff4,		// bne $3,$0,loop
+	0x00000000		// nop
+};
+
+#define PROLOGUE_WORDS	( sizeof( prologue ) / 4 )
+#define BODY_WORDS	( sizeof( body ) / 4 )
+#define WORDS		( PROLOGUE_WORDS + BODY_WORDS * REPEAT )
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static stallStats stalls;
+
+//steps until the pipeline drains past the end of the text
+static uint64_t runKernel( Memory *mem, RegisterFile *regs, unsigned bypass, traceRecorder *tracer = NULL )
+{
+	mipsPipelined proc( mem, regs, 0, 4*( WORDS-1 ) );
+	proc.setBypass( bypass );
+	proc.setTracer( tracer );
+
+	runResult res = proc.run( UINT64_MAX );
+	if( res.status != RUN_DONE )
+		printf( "%s after %llu cycles\n", proc.runError().c_str(), (unsigned long long) res.cycles );
+
+	const stallStats &st = proc.stallCounts();
+	stalls.cycles += st.cycles;
+	for( int i=0; i<STAGES; ++i )
+		stalls.byStage[i] += st.byStage[i];
+	for( int i=0; i<SCOREBOARD_REGS; ++i )
+		stalls.byReg[i] += st.byReg[i];
+	return res.cycles;
+}
+
+/*
+ * The same runs without and with a trace written to file,
+ * which is removed after. Records are fetches and data
+ * accesses, waits the times the ring was full, CPUs the
+ * CPU time of both threads over the wall time.
+ */
+static void measureTrace( Memory *mem, const char *file )
+{
+	uint64_t cycles = 0, records = 0, bytes = 0, waits = 0;
+	double start = now();
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		cycles += runKernel( mem, &regs, BYPASS_ALL );
+	}
+	double plain = now() - start;
+
+	start = now();
+	clock_t cpu = clock();
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		traceRecorder tracer( file );
+		runKernel( mem, &regs, BYPASS_ALL, &tracer );
+		tracer.close();
+		records += tracer.records();
+		bytes += tracer.bytes();
+		waits += tracer.waits();
+	}
+	double traced = now() - start;
+	double busy = (double)( clock() - cpu ) / CLOCKS_PER_SEC;
+	remove( file );
+
+	printf( "%-20s %10.2f M cycles/s  untraced %.2f M cycles/s, %.2fx slower\n", "traced", cycles / traced / 1e6,
+		cycles / plain / 1e6, traced / plain );
+	printf( "  %llu records, %.2f bytes each, ring full %llu times, %.2f CPUs busy\n", (unsigned long long) records,
+		(double) bytes / records, (unsigned long long) waits, busy / traced );
+}
+
+//one line per bypass setting, the checksum must not depend on it
+static void measure( Memory *mem, const char *name, unsigned bypass )
+{
+	uint64_t cycles = 0;
+	uint32_t sum = 0;
+	memset( &stalls, 0, sizeof( stalls ) );
+	double start = now();
+
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		cycles += runKernel( mem, &regs, bypass );
+		for( int i=0; i<REG_NR; ++i )
+			sum = sum * 31 + regs.getReg( i );
+		sum = sum * 31 + mem->loadWord( DATA );
+	}
+
+	double secs = now() - start;
+	printf( "%-20s %10.2f M cycles/s  CPI %.3f  checksum %08x\n", name,
+		cycles / secs / 1e6, (double) cycles / ( RUNS * WORDS ), sum );
+
+	printf( "  stall cycles %llu: on EX %llu, on MEM %llu, on WB %llu\n", (unsigned long long) stalls.cycles,
+		(unsigned long long) stalls.byStage[ EX ], (unsigned long long) stalls.byStage[ MEM ],
+		(unsigned long long) stalls.byStage[ WB ] );
+	for( int i=0; i<SCOREBOARD_REGS; ++i )
+		if( stalls.byReg[i] != 0 )
+			printf( "    waiting for r%d: %llu\n", i, (unsigned long long) stalls.byReg[i] );
+}
+
+//CPI, and the cycles lost to taken branches and to their operands
+static void measureBranches( Memory *mem, const char *name, int s, bool slots )
+{
+	uint64_t cycles = 0, instructions = 0;
+	uint32_t sum = 0;
+	branchStats br;
+	memset( &br, 0, sizeof( br ) );
+	double start = now();
+
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		mipsPipelined proc( mem, &regs, 0, sizeof( loop ) - 4 );
+		proc.setBranchStage( s );
+		proc.setDelaySlot( slots );
+
+		runResult res = proc.run( UINT64_MAX );
+		if( res.status != RUN_DONE )
+			printf( "%s after %llu cycles\n", proc.runError().c_str(), (unsigned long long) res.cycles );
+		cycles += res.cycles;
+		instructions += res.instructions;
+
+		const branchStats &b = proc.branchCounts();
+		br.branches += b.branches;
+		br.taken += b.taken;
+		br.jumps += b.jumps;
+		br.flushed += b.flushed;
+		br.operandStalls += b.operandStalls;
+		for( int i=0; i<REG_NR; ++i )
+			sum = sum * 31 + regs.getReg( i );
+	}
+
+	double secs = now() - start;
+	printf( "%-20s %10.2f M cycles/s  CPI %.3f  checksum %08x\n", name,
+		cycles / secs / 1e6, (double) cycles / instructions, sum );
+	printf( "  %llu of %llu branches taken, %llu jumps: %llu flushed, %llu operand stalls, %.3f cycles per branch or jump\n",
+		(unsigned long long) br.taken, (unsigned long long) br.branches, (unsigned long long) br.jumps,
+		(unsigned long long) br.flushed, (unsigned long long) br.operandStalls,
+		(double) ( br.flushed + br.operandStalls ) / ( br.branches + br.jumps ) );
+}
+
+/*
+ * Runs traps to the vector and back to EPC for every
+ * exception, then raises interrupt line 2 in its loop.
+ * CP0 is checked at every stop, the registers and the
+ * handler's log at the end.
+ */
+static bool runTraps( Memory *mem, RegisterFile &regs, int s, runResult &total, unsigned &stops )
+{
+	mipsPipelined proc( mem, &regs, 0, TRAP_MAIN + sizeof( traps ) - 4 );
+	proc.setBranchStage( s );
+	proc.setExceptionVector( TRAP_VECTOR );
+	bool ok = true;
+	runResult res;
+
+	for( unsigned i=0; i<TRAP_STOPS; ++i ) {
+		const trapStop &t = trapStops[i];
+		res = proc.runUntil( TRAP_VECTOR, 1000 );
+		total.cycles += res.cycles;
+		total.instructions += res.instructions;
+		stops += res.status == RUN_PC;
+		ok &= res.status == RUN_PC && proc.readCP0( CP0_EPC ) == t.epc
+			&& ( proc.readCP0( CP0_CAUSE ) & 0x8000007c ) == t.cause
+			&& proc.readCP0( CP0_BADVADDR ) == t.badVAddr;
+
+		res = proc.runUntil( t.back, 1000 );
+		total.cycles += res.cycles;
+		total.instructions += res.instructions;
+		stops += res.status == RUN_PC;
+		ok &= res.status == RUN_PC && !( proc.readCP0( CP0_STATUS ) & 2 );
+	}
+
+	//the interrupt is taken once MTC0 has enabled it, in the loop
+	res = proc.runUntil( TRAP_LOOP, 1000 );
+	proc.setInterrupt( 2, true );
+	runResult irq = proc.runUntil( TRAP_VECTOR, 1000 );
+	uint32_t epc = proc.readCP0( CP0_EPC );
+	uint32_t cause = proc.readCP0( CP0_CAUSE );
+	ok &= res.status == RUN_PC && irq.status == RUN_PC && ( cause & 0x7c ) == 0 && ( cause & 0x400 )
+		&& epc >= TRAP_LOOP && epc <= TRAP_MAIN + sizeof( traps ) - 4;
+	stops += ( res.status == RUN_PC ) + ( irq.status == RUN_PC );
+	total.cycles += res.cycles + irq.cycles;
+	total.instructions += res.instructions + irq.instructions;
+
+	proc.setInterrupt( 2, false );
+	res = proc.runUntil( epc, 1000 );
+	stops += res.status == RUN_PC;
+	ok &= res.status == RUN_PC && !( proc.readCP0( CP0_STATUS ) & 2 );
+	total.cycles += res.cycles;
+	total.instructions += res.instructions;
+
+	res = proc.run( 10000 );
+	ok &= res.status == RUN_DONE;
+	total.cycles += res.cycles;
+	total.instructions += res.instructions;
+	if( res.status == RUN_ERROR )
+		printf( "%s\n", proc.runError().c_str() );
+
+	for( unsigned i=0; i<TRAP_STOPS; ++i ) {
+		uint32_t entry = TRAP_LOG + 12 * i;
+		ok &= mem->loadWord( entry ) == trapStops[i].epc && mem->loadWord( entry + 8 ) == trapStops[i].badVAddr
+			&& ( mem->loadWord( entry + 4 ) & 0x8000007c ) == trapStops[i].cause;
+	}
+	ok &= mem->loadWord( TRAP_LOG + 12 * TRAP_STOPS ) == epc;
+
+	ok &= regs.getReg( 1 ) == 0 && regs.getReg( 2 ) == 5 && regs.getReg( 3 ) == 8 && regs.getReg( 6 ) == 1
+		&& regs.getReg( 9 ) == 0 && regs.getReg( 10 ) == 1 && regs.getReg( 11 ) == 2
+		&& regs.getReg( 20 ) == (int32_t)( TRAP_LOG + 12 * ( TRAP_STOPS + 1 ) );
+	return ok;
+}
+
+static void measureTraps( Memory *mem, const char *name, int s )
+{
+	runResult total = { RUN_DONE, 0, 0 };
+	unsigned stops = 0, good = 0;
+	double start = now();
+
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		for( uint32_t i=0; i<=TRAP_STOPS; ++i )
+			mem->storeWord( TRAP_LOG + 12 * i, 0 );
+		good += runTraps( mem, regs, s, total, stops );
+	}
+
+	double secs = now() - start;
+	printf( "%-20s %10.2f M cycles/s  CPI %.3f  %u stops, %s\n", name, total.cycles / secs / 1e6,
+		(double) total.cycles / total.instructions, stops, ( good == RUNS ) ? "CP0 and registers right" : "WRONG" );
+}
+
+//the pattern kernel with p, a 512 entry BTB and an 8 entry return stack, warm after the first run
+static void measurePredictor( Memory *mem, branchPredictor *p )
+{
+	uint64_t cycles = 0, instructions = 0, flushed = 0;
+	uint32_t sum = 0;
+	branchTargetBuffer btb( 9 );
+	returnStack ras( 3 );
+	double start = now();
+
+	for( int run=0; run<RUNS; ++run ) {
+		RegisterFile regs;
+		mipsPipelined proc( mem, &regs, 0, sizeof( patterns ) - 4 );
+		if( p != NULL )
+			proc.setPredictor( p, &btb, &ras );
+
+		runResult res = proc.run( UINT64_MAX );
+		if( res.status != RUN_DONE )
+			printf( "%s after %llu cycles\n", proc.runError().c_str(), (unsigned long long) res.cycles );
+		cycles += res.cycles;
+		instructions += res.instructions;
+		flushed += proc.branchCounts().flushed;
+		for( int i=0; i<REG_NR; ++i )
+			sum = sum * 31 + regs.getReg( i );
+	}
+
+	double secs = now() - start;
+	printf( "%-20s %10.2f M cycles/s  CPI %.3f  checksum %08x  flushed %llu\n", p ? p->name() : "no predictor",
+		cycles / secs / 1e6, (double) cycles / instructions, sum, (unsigned long long) flushed );
+	if( p != NULL ) {
+		printf( "  " );
+		p->printStats( 3 );
+		delete p;
+	}
+}
+
+/*
+ * The kernel of textBytes over a 16K I-cache, l1d and a
+ * 256K L2 in front of a 60 cycle memory, or without caches
+ * for a NULL l1d. With mshrs l1d does not block. Every run
+ * starts cold, with the array cleared, and a new prefetcher
+ * of kind on l1d. With dram, that is under a 16K L2 the
+ * array does not fit in, instead of a 60 cycle memory under
+ * a 256K one, so that dirty lines reach the write queue.
+ */
+static prefetcher *makePrefetcher( int kind )
+{
+	switch( kind ) {
+		case NEXT_LINE: return new nextLinePrefetcher( 2 );
+		case STRIDE: return new stridePrefetcher( 8, 2 );
+		case STREAM: return new streamBuffers( 8, 4 );
+		default: return NULL;
+	}
+}
+
+static void measureCaches( Memory *mem, const char *name, uint32_t textBytes, const cacheConfig *l1d,
+	unsigned mshrs, unsigned stores, int kind = NO_PREFETCH, const dramConfig *dram = NULL )
+{
+	static const cacheConfig l1i = { 0x4000, 2, 32, 1, REPLACE_LRU, WRITE_BACK };
+	static const cacheConfig l2 = { 0x40000, 8, 64, 8, REPLACE_LRU, WRITE_BACK };
+	static const cacheConfig smallL2 = { 0x4000, 8, 64, 8, REPLACE_LRU, WRITE_BACK };
+	uint64_t cycles = 0, instructions = 0, fetchStalls = 0, memStalls = 0;
+	uint32_t sum = 0;
+	cacheHierarchy *caches = NULL;
+	nonBlockingCache *lsu = NULL;
+	prefetcher *pf = NULL;
+	dramMemory *banks = NULL;
+	double start = now();
+
+	for( int run=0; run<RUNS; ++run ) {
+		for( uint32_t addr=ARRAY; addr<ARRAY+ARRAY_BYTES; addr += 4 )
+			mem->storeWord( addr, 0 );
+
+		RegisterFile regs;
+		mipsPipelined proc( mem, &regs, 0, textBytes - 4 );
+		delete lsu;
+		delete caches;
+		delete pf;
+		delete banks;
+		banks = ( dram != NULL ) ? new dramMemory( *dram ) : NULL;
+		if( banks != NULL )
+			caches = new cacheHierarchy( l1i, l1d ? *l1d : l1i, smallL2, banks );
+		else
+			caches = new cacheHierarchy( l1i, l1d ? *l1d : l1i, l2, 60 );
+		pf = makePrefetcher( kind );
+		caches->l1d.setPrefetcher( pf );
+		lsu = ( mshrs != 0 ) ? new nonBlockingCache( &caches->l1d, mshrs, stores ) : NULL;
+		if( l1d != NULL )
+			proc.setCaches( caches->icache(), caches->dcache() );
+		if( lsu != NULL )
+			proc.setNonBlocking( lsu );
+
+		runResult res = proc.run( UINT64_MAX );
+		if( res.status != RUN_DONE )
+			printf( "%s after %llu cycles\n", proc.runError().c_str(), (unsigned long long) res.cycles );
+		cycles += res.cycles;
+		instructions += res.instructions;
+		fetchStalls += proc.stallCounts().fetchCycles;
+		memStalls += proc.stallCounts().memoryCycles;
+		for( int i=0; i<REG_NR; ++i )
+			sum = sum * 31 + regs.getReg( i );
+	}
+
+	double secs = now() - start;
+	printf( "%-20s %10.2f M cycles/s  CPI %.3f  checksum %08x  stalls IF %llu MEM %llu\n", name,
+		cycles / secs / 1e6, (double) cycles / instructions, sum,
+		(unsigned long long) fetchStalls, (unsigned long long) memStalls );
+	if( l1d != NULL ) {
+		printf( "  " );
+		caches->l1d.printStats();
+		printf( "  " );
+		caches->l2.printStats();
+	}
+	if( banks != NULL )
+		banks->printStats();
+	if( lsu != NULL )
+		lsu->printStats();
+	if( pf != NULL ) {
+		printf( "  " );
+		pf->printStats();
+	}
+	delete lsu;
+	delete caches;
+	delete pf;
+	delete banks;
+}
+
+//the prologue, then the body REPEAT times
+static void loadKernel( Memory *mem, const uint32_t *words )
+{
+	uint32_t addr = 0;
+	for( uint32_t i=0; i<PROLOGUE_WORDS; ++i, addr += 4 )
+		mem->storeWord( addr, prologue[i] );
+	for( uint32_t r=0; r<REPEAT; ++r )
+		for( uint32_t i=0; i<BODY_WORDS; ++i, addr += 4 )
+			mem->storeWord( addr, words[i] );
+}
+
+int main()
+{
+	Memory *mem = new simpleMemory<BIG_END>( MEM_BYTES );
+	mem->storeWord( DATA, 0x12345678 );
+	loadKernel( mem, body );
+
+	measure( mem, "no bypass", 0 );
+	measure( mem, "EX->EX", BYPASS_EX_EX );
+	measure( mem, "MEM->EX", BYPASS_MEM_EX );
+	measure( mem, "WB->ID", BYPASS_WB_ID );
+	measure( mem, "all bypasses", BYPASS_ALL );
+
+	loadKernel( mem, memBody );
+	measure( mem, "loads/stores", BYPASS_ALL );
+	measureTrace( mem, "pipeBench.trace" );
+
+	for( uint32_t i=0; i<sizeof( loop ) / 4; ++i )
+		mem->storeWord( 4*i, loop[i] );
+	measureBranches( mem, "branch in EX", EX, true );
+	measureBranches( mem, "branch in ID", ID, true );
+	measureBranches( mem, "EX, no delay slot", EX, false );
+	measureBranches( mem, "ID, no delay slot", ID, false );
+
+	for( uint32_t i=0; i<sizeof( trapHandler ) / 4; ++i )
+		mem->storeWord( 4*i, trapHandler[i] );
+	for( uint32_t addr=sizeof( trapHandler ); addr<TRAP_MAIN; addr += 4 )
+		mem->storeWord( addr, 0 );
+	for( uint32_t i=0; i<sizeof( traps ) / 4; ++i )
+		mem->storeWord( TRAP_MAIN + 4*i, traps[i] );
+	measureTraps( mem, "exceptions, EX", EX );
+	measureTraps( mem, "exceptions, ID", ID );
+
+	for( uint32_t i=0; i<sizeof( patterns ) / 4; ++i )
+		mem->storeWord( 4*i, patterns[i] );
+	measurePredictor( mem, NULL );
+	measurePredictor( mem, new staticPredictor() );
+	measurePredictor( mem, new btfnPredictor() );
+	measurePredictor( mem, new bimodalPredictor( 12 ) );
+	measurePredictor( mem, new gsharePredictor( 12 ) );
+	measurePredictor( mem, new tagePredictor( 12, 10 ) );
+
+	static const cacheConfig lru = { 0x4000, 4, 32, 1, REPLACE_LRU, WRITE_BACK };
+	static const cacheConfig plru = { 0x4000, 4, 32, 1, REPLACE_PLRU, WRITE_BACK };
+	static const cacheConfig random = { 0x4000, 4, 32, 1, REPLACE_RANDOM, WRITE_BACK };
+	static const cacheConfig direct = { 0x4000, 1, 32, 1, REPLACE_LRU, WRITE_BACK };
+	static const cacheConfig through = { 0x4000, 4, 32, 1, REPLACE_LRU, WRITE_THROUGH };
+	static const cacheConfig big = { 0x10000, 4, 32, 1, REPLACE_LRU, WRITE_BACK };
+	for( uint32_t i=0; i<sizeof( walk ) / 4; ++i )
+		mem->storeWord( 4*i, walk[i] );
+	measureCaches( mem, "no caches", sizeof( walk ), NULL, 0, 0 );
+	measureCaches( mem, "16K 4-way LRU", sizeof( walk ), &lru, 0, 0 );
+	measureCaches( mem, "16K 4-way PLRU", sizeof( walk ), &plru, 0, 0 );
+	measureCaches( mem, "16K 4-way random", sizeof( walk ), &random, 0, 0 );
+	measureCaches( mem, "16K direct mapped", sizeof( walk ), &direct, 0, 0 );
+	measureCaches( mem, "16K write-through", sizeof( walk ), &through, 0, 0 );
+	measureCaches( mem, "64K 4-way LRU", sizeof( walk ), &big, 0, 0 );
+
+	for( uint32_t i=0; i<sizeof( gather ) / 4; ++i )
+		mem->storeWord( 4*i, gather[i] );
+	measureCaches( mem, "gather, blocking", sizeof( gather ), &lru, 0, 0 );
+	measureCaches( mem, "1 MSHR, 4 stores", sizeof( gather ), &lru, 1, 4 );
+	measureCaches( mem, "2 MSHRs, 4 stores", sizeof( gather ), &lru, 2, 4 );
+	measureCaches( mem, "4 MSHRs, 4 stores", sizeof( gather ), &lru, 4, 4 );
+	measureCaches( mem, "8 MSHRs, 8 stores", sizeof( gather ), &lru, 8, 8 );
+	measureCaches( mem, "write-through, 4/1", sizeof( gather ), &through, 4, 1 );
+	measureCaches( mem, "write-through, 4/8", sizeof( gather ), &through, 4, 8 );
+
+	for( uint32_t i=0; i<sizeof( walk ) / 4; ++i )
+		mem->storeWord( 4*i, walk[i] );
+	measureCaches( mem, "walk, next line", sizeof( walk ), &lru, 0, 0, NEXT_LINE );
+	measureCaches( mem, "walk, stride", sizeof( walk ), &lru, 0, 0, STRIDE );
+	measureCaches( mem, "walk, stream buffers", sizeof( walk ), &lru, 0, 0, STREAM );
+
+	for( uint32_t i=0; i<sizeof( gather ) / 4; ++i )
+		mem->storeWord( 4*i, gather[i] );
+	measureCaches( mem, "gather, next line", sizeof( gather ), &lru, 0, 0, NEXT_LINE );
+	measureCaches( mem, "gather, stride", sizeof( gather ), &lru, 0, 0, STRIDE );
+	measureCaches( mem, "gather, stream buffers", sizeof( gather ), &lru, 0, 0, STREAM );
+	measureCaches( mem, "stride, 8/8", sizeof( gather ), &lru, 8, 8, STRIDE );
+
+	static const dramConfig open = { 1, 1, 8, 2048, 64, 20, 20, 20, 8, OPEN_ROW, 16 };
+	static const dramConfig closed = { 1, 1, 8, 2048, 64, 20, 20, 20, 8, CLOSED_ROW, 16 };
+	static const dramConfig twoChannels = { 2, 1, 8, 2048, 64, 20, 20, 20, 8, OPEN_ROW, 16 };
+	static const dramConfig shortQueue = { 1, 1, 8, 2048, 64, 20, 20, 20, 8, OPEN_ROW, 2 };
+	measureCaches( mem, "gather, open rows", sizeof( gather ), &lru, 0, 0, NO_PREFETCH, &open );
+	measureCaches( mem, "gather, closed rows", sizeof( gather ), &lru, 0, 0, NO_PREFETCH, &closed );
+	measureCaches( mem, "open, 8/8", sizeof( gather ), &lru, 8, 8, NO_PREFETCH, &open );
+	measureCaches( mem, "closed, 8/8", sizeof( gather ), &lru, 8, 8, NO_PREFETCH, &closed );
+	measureCaches( mem, "2 channels, 8/8", sizeof( gather ), &lru, 8, 8, NO_PREFETCH, &twoChannels );
+	measureCaches( mem, "2 writes queued, 8/8", sizeof( gather ), &lru, 8, 8, NO_PREFETCH, &shortQueue );
+
+	for( uint32_t i=0; i<sizeof( walk ) / 4; ++i )
+		mem->storeWord( 4*i, walk[i] );
+	measureCaches( mem, "walk, open rows", sizeof( walk ), &lru, 0, 0, NO_PREFETCH, &open );
+	measureCaches( mem, "walk, closed rows", sizeof( walk ), &lru, 0, 0, NO_PREFETCH, &closed );
+	measureCaches( mem, "open, stride", sizeof( walk ), &lru, 0, 0, STRIDE, &open );
+	return 0;
+}
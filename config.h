@@ -0,0 +1,21 @@
+/*
+ * config.h
+ * The memory system of main -C and -D, which traceReplay -C
+ * replays traces into.
+ */
+
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include "memory/cache.h"
+#include "memory/dram.h"
+
+//for -C, in front of a memory of MEM_LATENCY cycles
+#define MEM_LATENCY	60
+static const cacheConfig l1Config = { 0x4000, 4, 32, 1, REPLACE_LRU, WRITE_BACK };
+static const cacheConfig l2Config = { 0x40000, 8, 64, 8, REPLACE_LRU, WRITE_BACK };
+
+//or for -D, one channel of DDR-like timing, in pipeline cycles
+static const dramConfig ddrConfig = { 1, 1, 8, 2048, 64, 20, 20, 20, 8, OPEN_ROW, 16 };
+
+#endif /* __CONFIG_H__ */
@@ -1,19 +1,261 @@
 #include "processor/processor.h"
 #include "processor/mipsPipelined.h"
+#include "processor/branchPredictor.h"
 #include "processor/register_file.h"
 #include "memory/memory.h"
+#include "memory/cache.h"
+#include "memory/dram.h"
+#include "config.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <iomanip>
 #include <iostream>
+#include <string.h>
 
 using namespace std;
 
-int main()
+#define DEFAULT_MEM	0x100000
+
+static const char *statusNames[] = { "done", "cycle limit", "stop pc", "error" };
+
+static void usage( const char *name )
+{
+	cerr << "usage: " << name << " [-c max_cycles] [-a load_addr] [-m mem_bytes] [-v exception_vector] [-i] [-n] [-p predictor] [-C] [-N mshrs,stores] [-P prefetcher] [-Q prefetcher] [-D open|closed] [-T trace] program" << endl;
+	cerr << "  -i resolves branches in ID instead of EX, -n runs without delay slots." << endl;
+	cerr << "  -p is one of nt, btfn, bimodal, gshare or tage, with a BTB and a return stack." << endl;
+	cerr << "  -C adds 16K L1 caches and a 256K L2 in front of a " << MEM_LATENCY << " cycle memory." << endl;
+	cerr << "  -N makes the L1 data cache of -C non-blocking, with that many MSHRs and store buffer entries." << endl;
+	cerr << "  -P and -Q add a next, stride or stream prefetcher to the L1 data cache and the L2 of -C." << endl;
+	cerr << "  -D puts 8 DRAM banks with an open or closed row policy under the caches of -C, for the flat memory." << endl;
+	cerr << "  -T writes every fetch, load and store to trace, for traceReplay." << endl;
+	cerr << "  program holds one hex word per line, the rest of a line is ignored." << endl;
+	cerr << "  Without a program, steps a demo one cycle per key." << endl;
+	exit( 2 );
+}
+
+//NULL for an unknown name
+static branchPredictor *makePredictor( const char *name )
+{
+	if( strcmp( name, "nt" ) == 0 )
+		return new staticPredictor();
+	if( strcmp( name, "btfn" ) == 0 )
+		return new btfnPredictor();
+	if( strcmp( name, "bimodal" ) == 0 )
+		return new bimodalPredictor( 12 );
+	if( strcmp( name, "gshare" ) == 0 )
+		return new gsharePredictor( 12 );
+	if( strcmp( name, "tage" ) == 0 )
+		return new tagePredictor( 12, 10 );
+	return NULL;
+}
+
+//NULL for an unknown name
+static prefetcher *makePrefetcher( const char *name )
+{
+	if( strcmp( name, "next" ) == 0 )
+		return new nextLinePrefetcher( 2 );
+	if( strcmp( name, "stride" ) == 0 )
+		return new stridePrefetcher( 8, 2 );
+	if( strcmp( name, "stream" ) == 0 )
+		return new streamBuffers( 8, 4 );
+	return NULL;
+}
+
+/*
+ * Store the words of the program from addr on, returns
+ * the address of the last one or addr - 4 if none.
+ */
+static uint32_t loadProgram( Memory *mem, const char *file, uint32_t addr, uint32_t memBytes )
+{
+	FILE *f = fopen( file, "r" );
+	if( f == NULL ) {
+		perror( file );
+		exit( 2 );
+	}
+
+	char line[256];
+	while( fgets( line, sizeof( line ), f ) != NULL ) {
+		char *end;
+		uint32_t word = strtoul( line, &end, 16 );
+		if( end == line )
+			continue;
+		if( addr + 4 > memBytes ) {
+			cerr << file << ": does not fit in " << memBytes << " bytes" << endl;
+			exit( 2 );
+		}
+		mem->storeWord( addr, word );
+		addr += 4;
+	}
+
+	fclose( f );
+	return addr - 4;
+}
+
+//load a program and run it to completion
+static int batch( const char *file, uint64_t maxCycles, uint32_t start, uint32_t memBytes, uint32_t vector,
+	int branchStage, bool delaySlots, branchPredictor *predictor, bool withCaches, unsigned mshrs, unsigned stores,
+	prefetcher *l1Prefetch, prefetcher *l2Prefetch, int rows, const char *traceFile )
+{
+	RegisterFile *regs = new RegisterFile();
+	Memory *mem = new simpleMemory<BIG_END>( memBytes );
+	for( uint32_t addr=0; addr<memBytes; addr += 4 )
+		mem->storeWord( addr, 0 );
+
+	uint32_t end = loadProgram( mem, file, start, memBytes );
+	if( end < start ) {
+		cerr << file << ": no instructions" << endl;
+		return 2;
+	}
+
+	mipsPipelined *proc = new mipsPipelined( mem, regs, start, end );
+	proc->setExceptionVector( vector );
+	proc->setBranchStage( branchStage );
+	proc->setDelaySlot( delaySlots );
+	branchTargetBuffer btb( 10 );
+	returnStack ras( 4 );
+	if( predictor != NULL )
+		proc->setPredictor( predictor, &btb, &ras );
+	dramMemory *dram = NULL;
+	cacheHierarchy *caches;
+	if( rows >= 0 ) {
+		dramConfig dc = ddrConfig;
+		dc.policy = rows;
+		dram = new dramMemory( dc );
+		caches = new cacheHierarchy( l1Config, l1Config, l2Config, dram );
+	} else
+		caches = new cacheHierarchy( l1Config, l1Config, l2Config, MEM_LATENCY );
+	caches->l1d.setPrefetcher( l1Prefetch );
+	caches->l2.setPrefetcher( l2Prefetch );
+	if( withCaches )
+		proc->setCaches( caches->icache(), caches->dcache() );
+	nonBlockingCache *lsu = NULL;
+	if( mshrs != 0 ) {
+		lsu = new nonBlockingCache( &caches->l1d, mshrs, stores );
+		proc->setNonBlocking( lsu );
+	}
+	traceRecorder *tracer = NULL;
+	if( traceFile != NULL ) {
+		try {
+			tracer = new traceRecorder( traceFile );
+		}
+		catch( const char *e ) {
+			cerr << traceFile << ": " << e << endl;
+			return 2;
+		}
+		proc->setTracer( tracer );
+	}
+	runResult res = proc->run( maxCycles );
+	if( tracer != NULL )
+		tracer->close();
+	const stallStats &st = proc->stallCounts();
+	const branchStats &br = proc->branchCounts();
+
+	cout << "status:       " << statusNames[ res.status ] << endl;
+	if( res.status == RUN_ERROR ) {
+		cout << "error:        " << proc->runError() << endl;
+		cout << hex << "EPC " << proc->readCP0( CP0_EPC ) << " Cause " << proc->readCP0( CP0_CAUSE )
+		     << " BadVAddr " << proc->readCP0( CP0_BADVADDR ) << dec << endl;
+	}
+	cout << "cycles:       " << res.cycles << endl;
+	cout << "instructions: " << res.instructions << endl;
+	if( res.instructions != 0 )
+		cout << "CPI:          " << fixed << setprecision( 3 ) << (double) res.cycles / res.instructions << endl;
+	cout << "stalls:       " << st.cycles << ", fetch " << st.fetchCycles << ", memory " << st.memoryCycles << endl;
+	cout << "branches:     " << br.branches << ", " << br.taken << " taken, " << br.jumps << " jumps" << endl;
+	cout << "flushed:      " << br.flushed << ", operand stalls " << br.operandStalls << endl;
+	cout << "mispredicted: " << br.mispredicted << endl;
+	if( predictor != NULL )
+		predictor->printStats( 5 );
+	if( tracer != NULL )
+		cout << "trace:        " << tracer->records() << " records, " << tracer->bytes() << " bytes" << endl;
+	if( withCaches ) {
+		cout << flush;
+		caches->printStats();
+		if( dram != NULL )
+			dram->printStats();
+		if( lsu != NULL )
+			lsu->printStats();
+		if( l1Prefetch != NULL ) {
+			printf( "L1D " );
+			l1Prefetch->printStats();
+		}
+		if( l2Prefetch != NULL ) {
+			printf( "L2 " );
+			l2Prefetch->printStats();
+		}
+	}
+	regs->printRegisters();
+
+	return ( res.status == RUN_DONE ) ? 0 : 1;
+}
+
+int main( int argc, char **argv )
 {
+	uint64_t maxCycles = UINT64_MAX;
+	uint32_t start = 0;
+	uint32_t memBytes = DEFAULT_MEM;
+	uint32_t vector = EXC_VECTOR;
+	int branchStage = EX;
+	bool delaySlots = true;
+	branchPredictor *predictor = NULL;
+	bool withCaches = false;
+	unsigned mshrs = 0, stores = 0;
+	prefetcher *l1Prefetch = NULL, *l2Prefetch = NULL;
+	int rows = -1;
+	const char *traceFile = NULL;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "c:a:m:v:inp:CN:P:Q:D:T:h" ) ) != -1 ) {
+		switch( opt ) {
+			case 'c': maxCycles = strtoull( optarg, NULL, 0 ); break;
+			case 'a': start = strtoul( optarg, NULL, 0 ); break;
+			case 'm': memBytes = strtoul( optarg, NULL, 0 ); break;
+			case 'v': vector = strtoul( optarg, NULL, 0 ); break;
+			case 'i': branchStage = ID; break;
+			case 'n': delaySlots = false; break;
+			case 'C': withCaches = true; break;
+			case 'N':
+				if( sscanf( optarg, "%u,%u", &mshrs, &stores ) != 2 || mshrs == 0 || mshrs > MAX_MSHRS
+					|| stores == 0 || stores > MAX_STORE_BUFFER )
+					usage( argv[0] );
+				withCaches = true;
+				break;
+			case 'P':
+			case 'Q': {
+				prefetcher *p = makePrefetcher( optarg );
+				if( p == NULL )
+					usage( argv[0] );
+				( opt == 'P' ? l1Prefetch : l2Prefetch ) = p;
+				withCaches = true;
+				break;
+			}
+			case 'D':
+				if( strcmp( optarg, "open" ) == 0 )
+					rows = OPEN_ROW;
+				else if( strcmp( optarg, "closed" ) == 0 )
+					rows = CLOSED_ROW;
+				else
+					usage( argv[0] );
+				withCaches = true;
+				break;
+			case 'T': traceFile = optarg; break;
+			case 'p':
+				predictor = makePredictor( optarg );
+				if( predictor == NULL )
+					usage( argv[0] );
+				break;
+			default: usage( argv[0] );
+		}
+	}
+
+	if( optind < argc )
+		return batch( argv[ optind ], maxCycles, start, memBytes, vector, branchStage, delaySlots, predictor, withCaches, mshrs, stores,
+			l1Prefetch, l2Prefetch, rows, traceFile );
+
 	mipsPipelined *proc;
-	Register_File *regs = new Register_File();
-	simpleMemory *mem = new simpleMemory( 4096 );
+	RegisterFile *regs = new RegisterFile();
+	Memory *mem = new simpleMemory<BIG_END>( 4096 );
 
 	mem->storeWord( 100, 0x2003000a );		// addi $3,$0,10 
 	mem->storeWord( 104, 0xac030004 );		// sw $3,4($0)
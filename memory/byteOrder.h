@@ -0,0 +1,77 @@
+/*
+ * byteOrder.h
+ * Guest byte order policies. Memory backends are 
+ * templated on one of these, so converting between 
+ * guest and host order is resolved at compile time:
+ * either nothing or a single byte swap.
+ */
+
+#ifndef __BYTE_ORDER_H__
+#define __BYTE_ORDER_H__
+
+#include <stdint.h>
+#include <cstring>
+
+
+typedef enum {
+	BIG_END = 0, 
+	LITTLE_END = 1
+} endian;
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_ORDER	BIG_END
+#else
+#define HOST_ORDER	LITTLE_END
+#endif
+
+
+template <endian order, bool swap = ( order != HOST_ORDER )>
+struct byteOrder {
+	static uint32_t word( uint32_t v ) { return v; }
+	static uint16_t half( uint16_t v ) { return v; }
+};
+
+//guest order differs from the host
+template <endian order>
+struct byteOrder<order, true> {
+	static uint32_t word( uint32_t v ) { return __builtin_bswap32( v ); }
+	static uint16_t half( uint16_t v ) { return __builtin_bswap16( v ); }
+};
+
+
+/*
+ * Load/store a guest value at a host pointer.
+ * memcpy compiles to a plain (possibly unaligned) move.
+ */
+template <endian order>
+inline uint32_t guestWord( const uint8_t *p )
+{
+	uint32_t v;
+	memcpy( &v, p, 4 );
+	return byteOrder<order>::word( v );
+}
+
+template <endian order>
+inline void setGuestWord( uint8_t *p, uint32_t val )
+{
+	val = byteOrder<order>::word( val );
+	memcpy( p, &val, 4 );
+}
+
+template <endian order>
+inline uint16_t guestHalfWord( const uint8_t *p )
+{
+	uint16_t v;
+	memcpy( &v, p, 2 );
+	return byteOrder<order>::half( v );
+}
+
+template <endian order>
+inline void setGuestHalfWord( uint8_t *p, uint16_t val )
+{
+	val = byteOrder<order>::half( val );
+	memcpy( p, &val, 2 );
+}
+
+
+#endif /* __BYTE_ORDER_H__ */
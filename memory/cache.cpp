@@ -0,0 +1,535 @@
+/*
+ * cache.cpp
+ * set associative cache levels, timing only. With SSE2
+ * the tags of a set are compared four at a time, eight
+ * with AVX2, and the LRU ages of 4 to 32 ways are aged
+ * in one compare and subtract per 16 ways. -DCACHE_SCALAR
+ * keeps the plain loops, which give the same results.
+ */
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __SSE2__ ) && !defined( CACHE_SCALAR )
+#define CACHE_SIMD
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#endif
+
+static void *alignedAlloc( size_t bytes )
+{
+	void *p;
+	if( bytes < HOST_LINE )
+		bytes = HOST_LINE;
+	if( posix_memalign( &p, HOST_LINE, bytes ) != 0 )
+		throw "cacheLevel: out of memory";
+	return p;
+}
+
+#ifdef CACHE_SIMD
+/*
+ * The ages of a set, 4, 8 or 16 ways of them in the low
+ * bytes. Sets of 4 and 8 ways are as aligned as they are
+ * long, so no load crosses a host line.
+ */
+static inline __m128i loadAges( const uint8_t *a, uint32_t ways )
+{
+	if( ways >= 16 )
+		return _mm_load_si128( (const __m128i *) a );
+	if( ways == 8 )
+		return _mm_loadl_epi64( (const __m128i *) a );
+	return _mm_cvtsi32_si128( *(const int32_t *) a );
+}
+
+static inline void storeAges( uint8_t *a, uint32_t ways, __m128i v )
+{
+	if( ways >= 16 )
+		_mm_store_si128( (__m128i *) a, v );
+	else if( ways == 8 )
+		_mm_storel_epi64( (__m128i *) a, v );
+	else
+		*(int32_t *) a = _mm_cvtsi128_si32( v );
+}
+#endif
+
+//bit w set if way w holds tag, ways is a power of two and t aligned to it
+static inline uint32_t matchWays( const uint32_t *t, uint32_t ways, uint32_t tag )
+{
+	uint32_t hits = 0;
+#ifdef CACHE_SIMD
+#ifdef __AVX2__
+	if( ways >= 8 ) {
+		__m256i key = _mm256_set1_epi32( tag );
+		for( uint32_t w=0; w<ways; w += 8 ) {
+			__m256i eq = _mm256_cmpeq_epi32( _mm256_load_si256( (const __m256i *)( t + w ) ), key );
+			hits |= (uint32_t) _mm256_movemask_ps( _mm256_castsi256_ps( eq ) ) << w;
+		}
+		return hits;
+	}
+#endif
+	if( ways >= 4 ) {
+		__m128i key = _mm_set1_epi32( tag );
+		for( uint32_t w=0; w<ways; w += 4 ) {
+			__m128i eq = _mm_cmpeq_epi32( _mm_load_si128( (const __m128i *)( t + w ) ), key );
+			hits |= (uint32_t) _mm_movemask_ps( _mm_castsi128_ps( eq ) ) << w;
+		}
+		return hits;
+	}
+#endif
+	for( uint32_t w=0; w<ways; ++w )
+		hits |= (uint32_t)( t[w] == tag ) << w;
+	return hits;
+}
+
+cacheLevel::cacheLevel( const char *name, const cacheConfig &config, memoryLevel *next )
+	: name( name ), config( config ), next( next )
+{
+	if( !powerOfTwo( config.size ) || !powerOfTwo( config.ways ) || !powerOfTwo( config.lineSize ) )
+		throw "cacheLevel: size, ways and line size must be powers of two";
+	if( config.lineSize < 4 || config.ways > 32 || config.size < config.ways * config.lineSize )
+		throw "cacheLevel: bad geometry";
+	if( next == NULL )
+		throw "cacheLevel: nothing to miss to";
+
+	ways = config.ways;
+	lineBits = log2of( config.lineSize );
+	uint32_t sets = config.size / ( ways * config.lineSize );
+	setBits = log2of( sets );
+	setMask = sets - 1;
+
+	//ways is a power of two, so no set crosses a host line unless it is bigger
+	tags = (uint32_t *) alignedAlloc( sizeof( uint32_t ) * sets * ways );
+	age = (uint8_t *) alignedAlloc( sets * ways );
+	dirty = new uint32_t[ sets ];
+	tree = new uint32_t[ sets ];
+	prefetched = new uint32_t[ sets ];
+	readyAt = new uint64_t[ sets * ways ];
+	seed = 0x2545f491;
+	pf = NULL;
+	clock = 0;
+
+	invalidate();
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+cacheLevel::~cacheLevel()
+{
+	free( tags );
+	free( age );
+	delete[] dirty;
+	delete[] tree;
+	delete[] prefetched;
+	delete[] readyAt;
+}
+
+void cacheLevel::setPrefetcher( prefetcher *p )
+{
+	pf = p;
+	if( pf )
+		pf->lineBytes = config.lineSize;
+}
+
+void cacheLevel::invalidate()
+{
+	uint32_t sets = setMask + 1;
+	for( uint32_t i=0; i<sets * ways; ++i ) {
+		tags[i] = INVALID_TAG;
+		age[i] = i % ways;
+	}
+	memset( dirty, 0, sizeof( uint32_t ) * sets );
+	memset( tree, 0, sizeof( uint32_t ) * sets );
+	memset( prefetched, 0, sizeof( uint32_t ) * sets );
+	memset( readyAt, 0, sizeof( uint64_t ) * sets * ways );
+}
+
+//the lowest way holding tag, or -1
+int cacheLevel::lookup( uint32_t set, uint32_t tag ) const
+{
+	uint32_t hits = matchWays( tags + set * ways, ways, tag );
+	return hits ? __builtin_ctz( hits ) : -1;
+}
+
+/*
+ * LRU ages everything younger than way. PLRU points
+ * every node on the path to way away from it.
+ */
+void cacheLevel::touch( uint32_t set, int way )
+{
+	switch( config.replacement ) {
+		case REPLACE_LRU: {
+			uint8_t *a = age + set * ways;
+			uint8_t old = a[ way ];
+#ifdef CACHE_SIMD
+			//ages are below 32, so the signed compare does
+			if( ways >= 4 ) {
+				__m128i o = _mm_set1_epi8( old );
+				for( uint32_t w=0; w<ways; w += 16 ) {
+					__m128i v = loadAges( a + w, ways );
+					storeAges( a + w, ways, _mm_sub_epi8( v, _mm_cmplt_epi8( v, o ) ) );
+				}
+				a[ way ] = 0;
+				break;
+			}
+#endif
+			for( uint32_t w=0; w<ways; ++w )
+				a[w] += ( a[w] < old );
+			a[ way ] = 0;
+			break;
+		}
+		case REPLACE_PLRU: {
+			uint32_t bits = tree[ set ];
+			uint32_t node = 1;
+			for( uint32_t half=ways >> 1; half != 0; half >>= 1 ) {
+				bool right = ( way & half ) != 0;
+				if( right )
+					bits &= ~( 1U << node );
+				else
+					bits |= 1U << node;
+				node = 2 * node + right;
+			}
+			tree[ set ] = bits;
+			break;
+		}
+	}
+}
+
+//an invalid way if any, else the one the policy picks
+int cacheLevel::victim( uint32_t set )
+{
+	int way = lookup( set, INVALID_TAG );
+	if( way >= 0 )
+		return way;
+
+	switch( config.replacement ) {
+		case REPLACE_LRU: {
+			const uint8_t *a = age + set * ways;
+#ifdef CACHE_SIMD
+			if( ways >= 4 ) {
+				__m128i oldest = _mm_set1_epi8( ways - 1 );
+				for( uint32_t w=0; w<ways; w += 16 ) {
+					uint32_t m = _mm_movemask_epi8( _mm_cmpeq_epi8( loadAges( a + w, ways ), oldest ) );
+					if( m != 0 )
+						return w + __builtin_ctz( m );
+				}
+				return 0;
+			}
+#endif
+			for( uint32_t w=0; w<ways; ++w )
+				if( a[w] == ways - 1 )
+					return w;
+			return 0;
+		}
+		case REPLACE_PLRU: {
+			uint32_t bits = tree[ set ];
+			uint32_t node = 1;
+			while( node < ways )
+				node = 2 * node + ( ( bits >> node ) & 1 );
+			return node - ways;
+		}
+		default:
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return seed & ( ways - 1 );
+	}
+}
+
+/*
+ * Make room for tag, writing back the victim if it is
+ * dirty. Adds what that takes.
+ */
+int cacheLevel::replace( uint32_t set, uint32_t tag, uint32_t &cycles, uint64_t now )
+{
+	int way = victim( set );
+	uint32_t &t = tags[ set * ways + way ];
+
+	if( t != INVALID_TAG ) {
+		++stats.evictions;
+		if( dirty[ set ] & ( 1U << way ) ) {
+			++stats.writebacks;
+			cycles += next->access( ( t << ( lineBits + setBits ) ) | ( set << lineBits ), true, NO_PC, now + config.latency );
+		}
+		if( prefetched[ set ] & ( 1U << way ) )
+			++pf->useless;
+	}
+
+	t = tag;
+	dirty[ set ] &= ~( 1U << way );
+	prefetched[ set ] &= ~( 1U << way );
+	return way;
+}
+
+//and bring the line in from the level below
+int cacheLevel::fill( uint32_t set, uint32_t tag, uint32_t &cycles, uint32_t pc, uint64_t now )
+{
+	int way = replace( set, tag, cycles, now );
+	cycles += next->access( ( tag << ( lineBits + setBits ) ) | ( set << lineBits ), false, pc, now + config.latency );
+	return way;
+}
+
+/*
+ * Lines the prefetcher names that are not in yet are filled
+ * as if demanded now, but the access that named them does
+ * not wait. Stream buffers keep theirs.
+ */
+void cacheLevel::prefetch( uint32_t addr, uint32_t pc, bool missed, uint64_t now )
+{
+	uint32_t lines[ MAX_PREFETCH ];
+	unsigned n = pf->observe( addr, pc, missed, lines, MAX_PREFETCH );
+
+	for( unsigned i=0; i<n; ++i ) {
+		uint32_t line = lines[i] & ~( config.lineSize - 1 );
+		if( pf->buffered() ) {
+			++pf->issued;
+			uint64_t sent = now + config.latency;
+			pf->arrived( line, sent + next->access( line, false, NO_PC, sent ) );
+			continue;
+		}
+
+		uint32_t set = setOf( line ), tag = tagOf( line );
+		if( lookup( set, tag ) >= 0 )
+			continue;
+		++pf->issued;
+		uint32_t cycles = 0;
+		int way = fill( set, tag, cycles, NO_PC, now );
+		prefetched[ set ] |= 1U << way;
+		readyAt[ set * ways + way ] = now + config.latency + cycles;
+		touch( set, way );
+	}
+}
+
+uint32_t cacheLevel::read( uint32_t addr )
+{
+	return access( addr, false, NO_PC, clock );
+}
+
+uint32_t cacheLevel::write( uint32_t addr )
+{
+	return access( addr, true, NO_PC, clock );
+}
+
+/*
+ * The first use of a prefetched line is a miss it covered,
+ * late if the line is not in yet, and the access waits for
+ * it. A miss may find its line in a stream buffer instead.
+ */
+uint32_t cacheLevel::access( uint32_t addr, bool store, uint32_t pc, uint64_t now )
+{
+	uint32_t set = setOf( addr ), tag = tagOf( addr );
+	uint32_t cycles = config.latency;
+	uint64_t ready = 0;
+	clock = now;
+	if( store )
+		++stats.writes;
+	else
+		++stats.reads;
+
+	int way = lookup( set, tag );
+	bool missed = way < 0;
+	if( !missed && ( prefetched[ set ] & ( 1U << way ) ) ) {
+		prefetched[ set ] &= ~( 1U << way );
+		ready = readyAt[ set * ways + way ];
+		missed = true;
+		++pf->useful;
+	}
+
+	if( store && config.write == WRITE_THROUGH ) {
+		if( way < 0 )
+			++stats.writeMisses;
+		else
+			touch( set, way );
+		cycles += next->access( addr, true, NO_PC, now + config.latency );
+	} else {
+		if( way < 0 ) {
+			if( store )
+				++stats.writeMisses;
+			else
+				++stats.readMisses;
+			if( pf && pf->buffered() && pf->take( addr & ~( config.lineSize - 1 ), ready ) ) {
+				way = replace( set, tag, cycles, now );
+				++pf->useful;
+			} else {
+				way = fill( set, tag, cycles, pc, now );
+				if( pf )
+					++pf->missed;
+			}
+		}
+		if( store )
+			dirty[ set ] |= 1U << way;
+		touch( set, way );
+	}
+
+	if( ready > now + config.latency ) {
+		++pf->late;
+		cycles += ready - now - config.latency;
+	}
+	if( pf )
+		prefetch( addr, pc, missed, now );
+	return cycles;
+}
+
+void cacheLevel::printStats()
+{
+	uint64_t accesses = stats.reads + stats.writes;
+	uint64_t misses = stats.readMisses + stats.writeMisses;
+	printf( "%s: %llu reads %llu misses, %llu writes %llu misses (%.2f%%), %llu evictions %llu writebacks\n", name,
+		(unsigned long long) stats.reads, (unsigned long long) stats.readMisses,
+		(unsigned long long) stats.writes, (unsigned long long) stats.writeMisses,
+		accesses ? 100.0 * misses / accesses : 0.0,
+		(unsigned long long) stats.evictions, (unsigned long long) stats.writebacks );
+}
+
+
+cacheHierarchy::cacheHierarchy( const cacheConfig &l1i, const cacheConfig &l1d, const cacheConfig &l2, uint32_t memLatency )
+	: memory( memLatency ), l2( "L2", l2, &memory ), l1i( "L1I", l1i, &this->l2 ), l1d( "L1D", l1d, &this->l2 ),
+	below( &memory )
+{
+}
+
+cacheHierarchy::cacheHierarchy( const cacheConfig &l1i, const cacheConfig &l1d, const cacheConfig &l2, memoryLevel *below )
+	: memory( 0 ), l2( "L2", l2, below ), l1i( "L1I", l1i, &this->l2 ), l1d( "L1D", l1d, &this->l2 ), below( below )
+{
+}
+
+void cacheHierarchy::printStats()
+{
+	l1i.printStats();
+	l1d.printStats();
+	l2.printStats();
+	if( below == &memory )
+		printf( "memory: %llu reads, %llu writes\n", (unsigned long long) memory.reads, (unsigned long long) memory.writes );
+}
+
+
+nonBlockingCache::nonBlockingCache( cacheLevel *l1, unsigned mshrs, unsigned entries )
+	: l1( l1 ), mshrs( mshrs ), depth( entries )
+{
+	if( mshrs == 0 || mshrs > MAX_MSHRS || entries == 0 || entries > MAX_STORE_BUFFER )
+		throw "nonBlockingCache: bad number of MSHRs or store buffer entries";
+
+	lineBits = log2of( l1->getConfig().lineSize );
+	for( unsigned i=0; i<MAX_MSHRS; ++i ) {
+		file[i].line = 0;
+		file[i].done = 0;
+	}
+	head = count = 0;
+	drained = 0;
+
+	loads = hits = misses = merged = forwarded = stores = 0;
+	mshrFullCycles = bufferFullCycles = 0;
+	memset( mshrBusy, 0, sizeof( mshrBusy ) );
+	memset( bufferUsed, 0, sizeof( bufferUsed ) );
+}
+
+//the stores written by now leave the buffer, they were written in order
+void nonBlockingCache::drain( uint64_t now )
+{
+	while( count != 0 && buffer[ head ].done <= now ) {
+		head = ( head + 1 ) % depth;
+		--count;
+	}
+}
+
+uint32_t nonBlockingCache::load( uint32_t addr, uint32_t pc, uint64_t now, uint64_t &ready )
+{
+	drain( now );
+	++loads;
+
+	//the youngest store of the word
+	for( unsigned i=count; i-- > 0; )
+		if( buffer[ ( head + i ) % depth ].word == addr >> 2 ) {
+			++forwarded;
+			ready = now + 1;
+			return 0;
+		}
+
+	uint32_t line = addr >> lineBits;
+	int freeSlot = -1, first = 0;
+	for( unsigned i=0; i<mshrs; ++i ) {
+		if( file[i].done <= now )
+			freeSlot = i;
+		else if( file[i].line == line ) {
+			++merged;
+			ready = file[i].done;
+			return 0;
+		}
+		if( file[i].done < file[ first ].done )
+			first = i;
+	}
+
+	uint32_t lat = l1->access( addr, false, pc, now );
+	if( lat <= l1->getConfig().latency ) {
+		++hits;
+		ready = now + lat;
+		return 0;
+	}
+
+	//with every MSHR busy, wait for the first to be free
+	++misses;
+	uint32_t stall = 0;
+	if( freeSlot < 0 ) {
+		freeSlot = first;
+		stall = file[ first ].done - now;
+		mshrFullCycles += stall;
+	}
+	file[ freeSlot ].line = line;
+	file[ freeSlot ].done = ready = now + stall + lat;
+	return stall;
+}
+
+uint32_t nonBlockingCache::store( uint32_t addr, uint64_t now )
+{
+	drain( now );
+	++stores;
+
+	uint32_t stall = 0;
+	if( count == depth ) {
+		stall = buffer[ head ].done - now;
+		bufferFullCycles += stall;
+		drain( now + stall );
+	}
+
+	uint64_t start = ( drained > now + stall ) ? drained : now + stall;
+	drained = start + l1->access( addr, true, NO_PC, start );
+	bufferedStore &b = buffer[ ( head + count ) % depth ];
+	b.word = addr >> 2;
+	b.done = drained;
+	++count;
+	return stall;
+}
+
+void nonBlockingCache::sample( uint64_t now )
+{
+	unsigned busy = 0;
+	for( unsigned i=0; i<mshrs; ++i )
+		busy += ( file[i].done > now );
+	drain( now );
+	++mshrBusy[ busy ];
+	++bufferUsed[ count ];
+}
+
+static void printHistogram( const char *what, const uint64_t *h, unsigned n )
+{
+	uint64_t total = 0;
+	for( unsigned i=0; i<=n; ++i )
+		total += h[i];
+	printf( "%s", what );
+	for( unsigned i=0; i<=n; ++i )
+		if( h[i] != 0 )
+			printf( " %u:%.1f%%", i, 100.0 * h[i] / total );
+	printf( "\n" );
+}
+
+void nonBlockingCache::printStats()
+{
+	printf( "%llu loads: %llu hits, %llu misses, %llu merged, %llu forwarded from stores\n",
+		(unsigned long long) loads, (unsigned long long) hits, (unsigned long long) misses,
+		(unsigned long long) merged, (unsigned long long) forwarded );
+	printf( "%llu stores, cycles waited: %llu for an MSHR, %llu for the store buffer\n",
+		(unsigned long long) stores, (unsigned long long) mshrFullCycles, (unsigned long long) bufferFullCycles );
+	printHistogram( "MSHRs in use:", mshrBusy, mshrs );
+	printHistogram( "stores buffered:", bufferUsed, depth );
+}
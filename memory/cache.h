@@ -0,0 +1,245 @@
+/*
+ * cache.h
+ * Timing model of a cache hierarchy. The levels only
+ * keep tags, dirty bits and the replacement state, the
+ * data stays in the Memory backend. Every access returns
+ * the cycles it takes, a hit costs the latency of the
+ * level and a miss adds what the level below takes, which
+ * sees the access that latency later.
+ *
+ * The tags of a set are contiguous and sets are aligned,
+ * so with up to 16 ways a lookup reads one host cache line.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+#include "prefetcher.h"
+
+//no line has this tag, tags are at most 30 bits
+#define INVALID_TAG	0xffffffff
+#define HOST_LINE	64
+
+//for the geometry of caches and DRAM
+static inline bool powerOfTwo( uint32_t n )
+{
+	return n != 0 && ( n & ( n - 1 ) ) == 0;
+}
+
+//bits to index n entries, n a power of two
+static inline unsigned log2of( uint32_t n )
+{
+	unsigned bits = 0;
+	while( ( 1U << bits ) < n )
+		++bits;
+	return bits;
+}
+
+typedef enum {
+	REPLACE_LRU,
+	REPLACE_PLRU,		//tree of ways-1 bits per set
+	REPLACE_RANDOM
+} replacementPolicy;
+
+typedef enum {
+	WRITE_BACK,		//and write allocate
+	WRITE_THROUGH		//and no write allocate
+} writePolicy;
+
+//sizes in bytes, all powers of two. ways up to 32
+struct cacheConfig {
+	uint32_t size;
+	uint32_t ways;
+	uint32_t lineSize;
+	uint32_t latency;	//cycles of a hit
+	uint8_t replacement;	//replacementPolicy
+	uint8_t write;		//writePolicy
+};
+
+struct cacheStats {
+	uint64_t reads;
+	uint64_t readMisses;
+	uint64_t writes;
+	uint64_t writeMisses;
+	uint64_t evictions;	//valid lines replaced
+	uint64_t writebacks;	//dirty ones among them
+};
+
+
+//anything a cache can miss to
+class memoryLevel {
+
+public:
+	virtual ~memoryLevel() {};
+
+	//cycles until the access to addr is done
+	virtual uint32_t read( uint32_t addr ) = 0;
+	virtual uint32_t write( uint32_t addr ) = 0;
+
+	//the same with the pc of the load, or NO_PC, and the cycle it reaches the level
+	virtual uint32_t access( uint32_t addr, bool store, uint32_t, uint64_t ) { return store ? write( addr ) : read( addr ); }
+
+};
+
+//the same latency for every access
+class mainMemory : public memoryLevel {
+
+public:
+	mainMemory( uint32_t latency ) : latency( latency ), reads( 0 ), writes( 0 ) {};
+
+	uint32_t read( uint32_t ) { ++reads; return latency; }
+	uint32_t write( uint32_t ) { ++writes; return latency; }
+
+	uint32_t latency;
+	uint64_t reads;
+	uint64_t writes;
+
+};
+
+
+class cacheLevel : public memoryLevel {
+
+public:
+	cacheLevel( const char *name, const cacheConfig &config, memoryLevel *next );
+	~cacheLevel();
+
+	uint32_t read( uint32_t addr );
+	uint32_t write( uint32_t addr );
+	uint32_t access( uint32_t addr, bool store, uint32_t pc, uint64_t now );
+
+	//NULL for none, the level does not own it
+	void setPrefetcher( prefetcher *p );
+	prefetcher *getPrefetcher() { return pf; }
+
+	//drop every line, without writing back the dirty ones
+	void invalidate();
+
+	const cacheStats &getStats() const { return stats; }
+	const cacheConfig &getConfig() const { return config; }
+	void printStats();
+
+	const char *name;
+
+private:
+	cacheConfig config;
+	memoryLevel *next;
+	cacheStats stats;
+
+	uint32_t ways;
+	unsigned lineBits;
+	unsigned setBits;
+	uint32_t setMask;
+
+	uint32_t *tags;		//ways per set
+	uint32_t *dirty;	//a bit per way, per set
+	uint8_t *age;		//LRU, 0 for the most recently used way
+	uint32_t *tree;		//PLRU, a bit per inner node
+	uint32_t seed;		//random
+
+	prefetcher *pf;
+	uint32_t *prefetched;	//a bit per way not demanded since it was prefetched, per set
+	uint64_t *readyAt;	//per way, when its prefetch is in
+	uint64_t clock;		//of the last access, for read() and write()
+
+	uint32_t setOf( uint32_t addr ) const { return ( addr >> lineBits ) & setMask; }
+	uint32_t tagOf( uint32_t addr ) const { return addr >> ( lineBits + setBits ); }
+
+	int lookup( uint32_t set, uint32_t tag ) const;
+	void touch( uint32_t set, int way );
+	int victim( uint32_t set );
+	int replace( uint32_t set, uint32_t tag, uint32_t &cycles, uint64_t now );
+	int fill( uint32_t set, uint32_t tag, uint32_t &cycles, uint32_t pc, uint64_t now );
+	void prefetch( uint32_t addr, uint32_t pc, bool missed, uint64_t now );
+
+};
+
+
+/*
+ * Split L1 caches over a unified L2 over main memory,
+ * the I-side of the pipeline uses icache and the D-side
+ * dcache. Main memory is flat unless below is given, a
+ * dramMemory say, which the hierarchy does not own.
+ */
+class cacheHierarchy {
+
+public:
+	cacheHierarchy( const cacheConfig &l1i, const cacheConfig &l1d, const cacheConfig &l2, uint32_t memLatency );
+	cacheHierarchy( const cacheConfig &l1i, const cacheConfig &l1d, const cacheConfig &l2, memoryLevel *below );
+
+	memoryLevel *icache() { return &l1i; }
+	memoryLevel *dcache() { return &l1d; }
+	void printStats();
+
+	mainMemory memory;
+	cacheLevel l2;
+	cacheLevel l1i;
+	cacheLevel l1d;
+	memoryLevel *below;	//what l2 misses to
+
+};
+
+
+#define MAX_MSHRS		32
+#define MAX_STORE_BUFFER	64
+
+/*
+ * A data cache that does not block on misses. A load miss
+ * holds an MSHR until its line is in, later loads of that
+ * line wait for the same fill, and other loads go on, hits
+ * and misses alike while MSHRs are free. Stores wait in a
+ * buffer drained into the cache one at a time, and a load
+ * of a word still there gets it from the buffer. Times are
+ * cycles of the caller.
+ */
+class nonBlockingCache {
+
+public:
+	nonBlockingCache( cacheLevel *l1, unsigned mshrs, unsigned entries );
+
+	//cycles the caller waits before the access is taken, ready is when the data is there
+	uint32_t load( uint32_t addr, uint32_t pc, uint64_t now, uint64_t &ready );
+	uint32_t store( uint32_t addr, uint64_t now );
+
+	//once per cycle, for the occupancy histograms
+	void sample( uint64_t now );
+
+	void printStats();
+
+	uint64_t loads;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t merged;		//into the MSHR of an earlier miss
+	uint64_t forwarded;		//from the store buffer
+	uint64_t stores;
+	uint64_t mshrFullCycles;
+	uint64_t bufferFullCycles;
+	uint64_t mshrBusy[ MAX_MSHRS + 1 ];		//cycles with n MSHRs in use
+	uint64_t bufferUsed[ MAX_STORE_BUFFER + 1 ];	//and n stores buffered
+
+private:
+	struct mshr {
+		uint32_t line;
+		uint64_t done;		//free from then on
+	};
+
+	struct bufferedStore {
+		uint32_t word;
+		uint64_t done;		//written into the cache
+	};
+
+	cacheLevel *l1;
+	unsigned lineBits;
+	unsigned mshrs;
+	unsigned depth;
+	mshr file[ MAX_MSHRS ];
+	bufferedStore buffer[ MAX_STORE_BUFFER ];
+	unsigned head;
+	unsigned count;
+	uint64_t drained;		//when the youngest store is written
+
+	void drain( uint64_t now );
+
+};
+
+#endif /* __CACHE_H__ */
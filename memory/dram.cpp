@@ -0,0 +1,208 @@
+/*
+ * dram.cpp
+ * banks, row buffers and an FR-FCFS write queue, timed
+ * when accessed rather than every cycle.
+ */
+#include "dram.h"
+#include <stdio.h>
+#include <string.h>
+
+dramMemory::dramMemory( const dramConfig &config ) : config( config )
+{
+	if( !powerOfTwo( config.channels ) || !powerOfTwo( config.ranks ) || !powerOfTwo( config.banks )
+		|| !powerOfTwo( config.rowBytes ) || !powerOfTwo( config.lineBytes ) )
+		throw "dramMemory: channels, ranks, banks, row and line bytes must be powers of two";
+	if( config.lineBytes > config.rowBytes || config.writeQueue == 0 || config.writeQueue > MAX_WRITE_QUEUE )
+		throw "dramMemory: bad line size or write queue";
+
+	lineBits = log2of( config.lineBytes );
+	columnBits = log2of( config.rowBytes / config.lineBytes );
+	channelBits = log2of( config.channels );
+	bankBits = log2of( config.ranks * config.banks );
+
+	uint32_t n = config.channels * config.ranks * config.banks;
+	banks = new bank[n];
+	for( uint32_t i=0; i<n; ++i ) {
+		banks[i].openRow = NO_ROW;
+		banks[i].ready = 0;
+	}
+	channels = new channel[ config.channels ];
+	for( uint32_t i=0; i<config.channels; ++i ) {
+		channels[i].busFree = 0;
+		channels[i].count = 0;
+	}
+	clock = 0;
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+dramMemory::~dramMemory()
+{
+	delete[] banks;
+	delete[] channels;
+}
+
+/*
+ * One line from or to row of b, the earliest from at on.
+ * The column command waits until the data can have the
+ * bus. Returns when the data is through.
+ */
+uint64_t dramMemory::issue( channel &c, bank &b, uint32_t row, uint64_t at )
+{
+	uint64_t t = ( at > b.ready ) ? at : b.ready;
+	if( b.openRow == row )
+		++stats.rowHits;
+	else {
+		if( b.openRow == NO_ROW )
+			++stats.rowEmpty;
+		else {
+			++stats.rowConflicts;
+			t += config.tRP;
+		}
+		t += config.tRCD;
+	}
+
+	if( t + config.tCAS < c.busFree )
+		t = c.busFree - config.tCAS;
+	uint64_t done = t + config.tCAS + config.tBurst;
+	c.busFree = done;
+
+	if( config.policy == OPEN_ROW ) {
+		b.openRow = row;
+		b.ready = t + config.tBurst;
+	} else {
+		b.openRow = NO_ROW;
+		b.ready = t + config.tBurst + config.tRP;
+	}
+	return done;
+}
+
+/*
+ * The write FR-FCFS picks at cycle at: the oldest one to
+ * an open row among those whose bank is ready, else the
+ * oldest of them, else the one whose bank is ready first.
+ */
+uint64_t dramMemory::issueWrite( channel &c, uint64_t at )
+{
+	int hit = -1, oldest = -1, first = 0;
+	uint64_t soonest = UINT64_MAX;
+	for( unsigned i=0; i<c.count; ++i ) {
+		const queuedWrite &w = c.queue[i];
+		const bank &b = banks[ w.bank ];
+		uint64_t ready = ( b.ready > w.arrival ) ? b.ready : w.arrival;
+		if( ready <= at ) {
+			if( b.openRow == w.row ) {
+				hit = i;
+				break;
+			}
+			if( oldest < 0 )
+				oldest = i;
+		} else if( ready < soonest ) {
+			soonest = ready;
+			first = i;
+		}
+	}
+
+	int pick = ( hit >= 0 ) ? hit : ( oldest >= 0 ) ? oldest : first;
+	queuedWrite w = c.queue[ pick ];
+	--c.count;
+	for( unsigned i=pick; i<c.count; ++i )
+		c.queue[i] = c.queue[ i + 1 ];
+	return issue( c, banks[ w.bank ], w.row, ( at > w.arrival ) ? at : w.arrival );
+}
+
+/*
+ * Writes wait until half the queue is taken, then go out
+ * while the bus is free before now, reads arriving at now
+ * go first. Batching them keeps them from closing the rows
+ * the reads have open one at a time.
+ */
+void dramMemory::drain( channel &c, uint64_t now )
+{
+	while( 2 * c.count > config.writeQueue ) {
+		uint64_t at = c.busFree;
+		uint64_t arrival = c.queue[0].arrival;
+		for( unsigned i=1; i<c.count; ++i )
+			if( c.queue[i].arrival < arrival )
+				arrival = c.queue[i].arrival;
+		if( at < arrival )
+			at = arrival;
+		if( at >= now )
+			break;
+		issueWrite( c, at );
+	}
+}
+
+uint32_t dramMemory::read( uint32_t addr )
+{
+	return access( addr, false, NO_PC, clock );
+}
+
+uint32_t dramMemory::write( uint32_t addr )
+{
+	return access( addr, true, NO_PC, clock );
+}
+
+/*
+ * Lines are interleaved over channels above the columns
+ * of a row, so that a run of lines stays in one row, and
+ * then over the banks of the channel.
+ */
+uint32_t dramMemory::access( uint32_t addr, bool store, uint32_t, uint64_t now )
+{
+	uint32_t line = addr >> lineBits;
+	uint32_t ch = ( line >> columnBits ) & ( config.channels - 1 );
+	uint32_t b = ( ch << bankBits ) | ( ( line >> ( columnBits + channelBits ) ) & ( ( 1U << bankBits ) - 1 ) );
+	uint32_t row = line >> ( columnBits + channelBits + bankBits );
+	channel &c = channels[ ch ];
+	clock = now;
+	drain( c, now );
+
+	if( store ) {
+		++stats.writes;
+		for( unsigned i=0; i<c.count; ++i )
+			if( c.queue[i].line == line ) {
+				++stats.merged;
+				return 0;
+			}
+
+		//a full queue issues a write to make room, which may have to wait for the bus
+		uint32_t wait = 0;
+		if( c.count == config.writeQueue ) {
+			++stats.queueFull;
+			uint64_t issued = issueWrite( c, now ) - config.tCAS - config.tBurst;
+			if( issued > now )
+				wait = issued - now;
+		}
+		queuedWrite &w = c.queue[ c.count++ ];
+		w.line = line;
+		w.bank = b;
+		w.row = row;
+		w.arrival = now + wait;
+		return wait;
+	}
+
+	++stats.reads;
+	for( unsigned i=0; i<c.count; ++i )
+		if( c.queue[i].line == line ) {
+			++stats.forwarded;
+			stats.readCycles += config.tBurst;
+			return config.tBurst;
+		}
+
+	uint32_t cycles = issue( c, banks[b], row, now ) - now;
+	stats.readCycles += cycles;
+	return cycles;
+}
+
+void dramMemory::printStats()
+{
+	uint64_t accesses = stats.rowHits + stats.rowEmpty + stats.rowConflicts;
+	double total = accesses ? accesses : 1;
+	printf( "DRAM: %llu reads %llu writes, rows: %.1f%% hits %.1f%% empty %.1f%% conflicts, read latency %.1f\n",
+		(unsigned long long) stats.reads, (unsigned long long) stats.writes, 100.0 * stats.rowHits / total,
+		100.0 * stats.rowEmpty / total, 100.0 * stats.rowConflicts / total,
+		stats.reads ? (double) stats.readCycles / stats.reads : 0.0 );
+	printf( "DRAM: %llu reads forwarded from the write queue, %llu writes merged, %llu waited for room\n",
+		(unsigned long long) stats.forwarded, (unsigned long long) stats.merged,
+		(unsigned long long) stats.queueFull );
+}
@@ -0,0 +1,111 @@
+/*
+ * dram.h
+ * Timing model of DRAM below the caches, in place of a
+ * flat mainMemory. Lines map to channels, ranks and banks,
+ * each bank keeps its open row, and a line costs tCAS in
+ * the open row, tRCD+tCAS in a closed bank and tRP more
+ * in a bank with another row open, then tBurst on the
+ * data bus of its channel.
+ *
+ * Nothing is ticked: banks and buses keep the cycle they
+ * are free from, and queued writes are issued when an
+ * access comes along, so an idle DRAM costs nothing.
+ */
+
+#ifndef __DRAM_H__
+#define __DRAM_H__
+
+#include "cache.h"
+
+#define NO_ROW		0xffffffff
+#define MAX_WRITE_QUEUE	64
+
+typedef enum {
+	OPEN_ROW,		//left open for the next access
+	CLOSED_ROW		//precharged after every access
+} rowPolicy;
+
+//counts are powers of two, times in cycles of the pipeline
+struct dramConfig {
+	uint32_t channels;
+	uint32_t ranks;		//per channel
+	uint32_t banks;		//per rank
+	uint32_t rowBytes;
+	uint32_t lineBytes;	//one burst
+	uint32_t tRCD;		//activate to column command
+	uint32_t tCAS;		//column command to data
+	uint32_t tRP;		//precharge
+	uint32_t tBurst;	//data bus for a line
+	uint8_t policy;		//rowPolicy
+	uint32_t writeQueue;	//entries per channel, up to MAX_WRITE_QUEUE
+};
+
+struct dramStats {
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t rowHits;
+	uint64_t rowEmpty;	//bank precharged
+	uint64_t rowConflicts;	//another row open
+	uint64_t forwarded;	//reads of a queued write
+	uint64_t merged;	//writes of a queued line
+	uint64_t queueFull;	//writes that waited for the queue
+	uint64_t readCycles;	//from arrival to data, over every read
+};
+
+/*
+ * Reads are answered when they arrive, in arrival order,
+ * ahead of the writes still queued. Writes are posted and
+ * issued FR-FCFS: once the bus is free, a write to an open
+ * row first, else the oldest one whose bank is ready.
+ */
+class dramMemory : public memoryLevel {
+
+public:
+	dramMemory( const dramConfig &config );
+	~dramMemory();
+
+	uint32_t read( uint32_t addr );
+	uint32_t write( uint32_t addr );
+	uint32_t access( uint32_t addr, bool store, uint32_t pc, uint64_t now );
+
+	const dramStats &getStats() const { return stats; }
+	const dramConfig &getConfig() const { return config; }
+	void printStats();
+
+private:
+	struct bank {
+		uint32_t openRow;
+		uint64_t ready;		//for the next command
+	};
+
+	struct queuedWrite {
+		uint32_t line;
+		uint32_t bank;
+		uint32_t row;
+		uint64_t arrival;
+	};
+
+	struct channel {
+		uint64_t busFree;
+		queuedWrite queue[ MAX_WRITE_QUEUE ];	//oldest first
+		unsigned count;
+	};
+
+	dramConfig config;
+	dramStats stats;
+	bank *banks;
+	channel *channels;
+	uint64_t clock;		//of the last access, for read() and write()
+
+	unsigned lineBits;
+	unsigned columnBits;
+	unsigned channelBits;
+	unsigned bankBits;	//ranks and banks of a channel
+
+	uint64_t issue( channel &c, bank &b, uint32_t row, uint64_t at );
+	uint64_t issueWrite( channel &c, uint64_t at );
+	void drain( channel &c, uint64_t now );
+
+};
+
+#endif /* __DRAM_H__ */
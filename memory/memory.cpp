@@ -2,8 +2,8 @@
  * memory.cpp
  * Implementation of a simple memory.
  * Just handles setting and loading of locations 
- * in memory. Takes care of requests for unaligned 
- * memory addresses, and out of bounds addressing.
+ * in memory. Requests for unaligned memory addresses
+ * and out of bounds addressing leave a fault pending.
  * requesting areas of memory MIPS considers to be 
  * protected are leaved to the processor to be checked. 
  */
@@ -15,156 +15,117 @@ using namespace std;
 
 /*
  * Constructors. It allocates memory for the array 
- * representing the processor's memory. By default
- * byteOrder is set to BIG_END
+ * representing the processor's memory. The byte order
+ * is given by the template parameter.
  */
-simpleMemory::simpleMemory( uint32_t size ) : mem_size( size )
+template <endian order>
+simpleMemory<order>::simpleMemory( uint32_t size ) : mem_size( size )
 {
 	if( size == 0 ) 
 		throw "WTF??? zero memory??";
 
-	byteOrder = BIG_END;	
 	mem = new uint8_t[ size ];
 }
 
 
-/*
- * This constructor sets byteOrder too.
- */
-simpleMemory::simpleMemory( uint32_t size, endian order )
-{
-	if( size == 0 )
-		throw "WTF??? zero memory??";
-
-	mem = new uint8_t[ size ];
-	byteOrder = order;
-}
-
-
 /*
  * Free the area allocated for mem.
  */
-simpleMemory::~simpleMemory() 
+template <endian order>
+simpleMemory<order>::~simpleMemory() 
 {
 	delete [] mem;
 }
 
 /*
  * loads/stores of memory areas. Checks for proper alignment 
- * of memory areas requested and addresses in bound.
+ * of memory areas requested and addresses in bound. Bad
+ * loads return 0, bad stores are dropped.
  */
-uint32_t simpleMemory::loadWord( uint32_t addr )
+template <endian order>
+uint32_t simpleMemory<order>::loadWord( uint32_t addr )
 {
-	if( addr % 4 != 0 )
-		throw "Memory addresses should be word aligned";
-
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
-
-	uint32_t ret;
-	
-	if( big_endian() )
-		memcpy( &ret, &mem[addr], 4 );
-	else {
-		//little-endian
-		ret = mem[addr+3];
-		for( int i=2; i>=0; --i) {
-			ret = ret << 8;
-			ret = ret | mem[addr+i];
-		}
+	if( addr % 4 != 0 || addr >= mem_size ) {
+		fail( LOAD_FAULT, addr );
+		return 0;
 	}
 
-	return ret;
+	return guestWord<order>( &mem[addr] );
 }
 
-void simpleMemory::storeWord( uint32_t addr, uint32_t val )
+template <endian order>
+void simpleMemory<order>::storeWord( uint32_t addr, uint32_t val )
 {
-	if( addr % 4 != 0 )
-		throw "Memory addresses should be word aligned";
-
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
-	if( big_endian() )
-		memcpy( &mem[addr], &val, 4 );
-	else {
-		//little-endian
-		for( int i=0; i<4; ++i ) {
-			mem[addr+i] = val & 0x000000ff;
-			val = val >> 8;
-		}
-		
+	if( addr % 4 != 0 || addr >= mem_size ) {
+		fail( STORE_FAULT, addr );
+		return;
 	}
+
+	setGuestWord<order>( &mem[addr], val );
 }
 
-uint16_t simpleMemory::loadHalfWord( uint32_t addr )
+template <endian order>
+uint16_t simpleMemory<order>::loadHalfWord( uint32_t addr )
 {
 
 	/*
 	 * address requested must be either the first or the 
  	 * last two bytes of a word.
 	 */
-	if( addr % 2 != 0 )
-		throw "Memory addresses should be word aligned";
-
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
-
-	uint16_t ret;
-	if( big_endian() )
-		memcpy( &ret, &mem[addr], 2 );
-	else {
-		//little endian
-		ret = 0;
-		ret = ret | mem[addr+1];
-		ret = ret << 8;
-		ret = ret | mem[addr+2];
-		ret = ret << 8;
+	if( addr % 2 != 0 || addr >= mem_size ) {
+		fail( LOAD_FAULT, addr );
+		return 0;
 	}
-	return ret;
+
+	return guestHalfWord<order>( &mem[addr] );
 }
 
-void simpleMemory::storeHalfWord( uint32_t addr, uint16_t val )
+template <endian order>
+void simpleMemory<order>::storeHalfWord( uint32_t addr, uint16_t val )
 {
-	if( addr % 4 != 0 )
-		throw "Memory addresses should be word aligned";
-
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
-	if( big_endian() )	
-		memcpy( &mem[addr], &val, 2 );
-	else {
-		mem[addr] = val & 0x000000ff;
-		val = val >> 8;
-		mem[addr+1] = val & 0x000000ff;
+	if( addr % 2 != 0 || addr >= mem_size ) {
+		fail( STORE_FAULT, addr );
+		return;
 	}
+
+	setGuestHalfWord<order>( &mem[addr], val );
 }
 
 /*
  * Functions concerning byte don't have to check
  * for aligment restrictions.
  */
-uint8_t simpleMemory::loadByte( uint32_t addr )
+template <endian order>
+uint8_t simpleMemory<order>::loadByte( uint32_t addr )
 {
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
+	if( addr >= mem_size ) {
+		fail( LOAD_FAULT, addr );
+		return 0;
+	}
 
 	return mem[addr];
 }
 
-void simpleMemory::storeByte( uint32_t addr, uint8_t val )
+template <endian order>
+void simpleMemory<order>::storeByte( uint32_t addr, uint8_t val )
 {
-	if( addr >= mem_size )
-		throw "Address requested is out of bounds";
+	if( addr >= mem_size ) {
+		fail( STORE_FAULT, addr );
+		return;
+	}
 
 	mem[addr] = val;
 }
 
+template class simpleMemory<BIG_END>;
+template class simpleMemory<LITTLE_END>;
+
 
 /*
  * print an area of the memory. 
  * Useful for debugging.
  */
-void simpleMemory::showMemory( uint32_t startAddr, uint32_t endAddr )
+void Memory::showMemory( uint32_t startAddr, uint32_t endAddr )
 {
 	printf( "-------------MEMORY--------------\n" );
 	printf( "Address\t\tValue\n" );
@@ -1,6 +1,6 @@
 /*
  * memory.h
- * Memory model for MIPS. Implemented as 
+ * Memory model for MIPS. Implemented as
  * big array, byte addressable. Can be either Big-Endian
  * or Little-Endian
  */
@@ -10,12 +10,14 @@
 
 #include <stdint.h>
 #include <cstring>
+#include "byteOrder.h"
 
-
+//faults a backend may leave pending instead of throwing
 typedef enum {
-	BIG_END = 0, 
-	LITTLE_END = 1
-} endian;
+	NO_FAULT = 0,
+	LOAD_FAULT = 1,
+	STORE_FAULT = 2
+} memFault;
 
 
 class Memory {
@@ -24,30 +26,48 @@ class Memory {
 
 public:
 
-	Memory() : byteOrder( BIG_END ){};
-	~Memory() {};
-	
+	Memory() : pending( NO_FAULT ), badAddr( 0 ){};
+	virtual ~Memory() {};
+
 	/*
  	 * Functions for loading and setting memory areas.
 	 * Need to check for word alignment and bad address.
 	 */
-	uint32_t loadWord( uint32_t addr );
-	void storeWord( uint32_t addr, uint32_t val );
-	uint16_t loadHalfWord( uint32_t addr );
-	void storeHalfWord( uint32_t addr, uint16_t val );
-	uint8_t loadByte( uint32_t addr );
-	void storeByte( uint32_t addr, uint8_t val );
+	virtual uint32_t loadWord( uint32_t addr ) = 0;
+	virtual void storeWord( uint32_t addr, uint32_t val ) = 0;
+	virtual uint16_t loadHalfWord( uint32_t addr ) = 0;
+	virtual void storeHalfWord( uint32_t addr, uint16_t val ) = 0;
+	virtual uint8_t loadByte( uint32_t addr ) = 0;
+	virtual void storeByte( uint32_t addr, uint8_t val ) = 0;
+	void showMemory( uint32_t, uint32_t );
+
+	/*
+	 * Backends that can not throw from their accessors
+	 * leave the fault here. The processor checks it once
+	 * per instruction and raises AdEL/AdES.
+	 */
+	memFault fault() const { return pending; }
+	uint32_t faultAddr() const { return badAddr; }
+	virtual void clearFault() { pending = NO_FAULT; }
 
 protected:
-	endian byteOrder;
+	//leave a fault instead of throwing, the access does nothing
+	void fail( memFault f, uint32_t addr ) { pending = f; badAddr = addr; }
+
+	volatile memFault pending;
+	volatile uint32_t badAddr;
 
 };
 
-class simpleMemory : Memory {
+/*
+ * Flat memory. The guest byte order is a template 
+ * parameter, BIG_END or LITTLE_END.
+ */
+template <endian order>
+class simpleMemory : public Memory {
 
 public:
 	simpleMemory( uint32_t size );
-	simpleMemory( uint32_t size, endian order );
 	~simpleMemory();
 	uint32_t loadWord( uint32_t addr );
 	void storeWord( uint32_t addr, uint32_t val );
@@ -55,13 +75,10 @@ public:
 	void storeHalfWord( uint32_t addr, uint16_t val );
 	uint8_t loadByte( uint32_t addr );
 	void storeByte( uint32_t addr, uint8_t val );
-	void showMemory( uint32_t, uint32_t );
 
 private:
 	uint8_t *mem;
 	uint32_t mem_size;
-	bool big_endian() { return byteOrder == BIG_END; }
-	bool little_endian() { return byteOrder == LITTLE_END; }
 
 };
 
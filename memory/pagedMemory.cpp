@@ -0,0 +1,301 @@
+/*
+ * pagedMemory.cpp
+ * Implementation of the demand-paged memory.
+ * Alignment and bounds are checked exactly like
+ * simpleMemory does, so the two are interchangeable.
+ * Bounds are only checked on a TLB miss, since only 
+ * pages entirely within bounds make it into the TLB.
+ */
+#include "pagedMemory.h"
+#include <stdio.h>
+
+using namespace std;
+
+//untouched pages read as zeros
+static const uint8_t zeroPage[ PAGE_SIZE ] = { 0 };
+
+
+/*
+ * Constructor. Nothing but the first level of the 
+ * page table is allocated here.
+ */
+template <endian order>
+pagedMemory<order>::pagedMemory( uint32_t size )
+{
+	if( size == 0 )
+		throw "WTF??? zero memory??";
+
+	mem_size = size;
+	pages = 0;
+	ioRegions = 0;
+	memset( dir, 0, sizeof( dir ) );
+	memset( &stats, 0, sizeof( stats ) );
+	flushTLB();
+}
+
+
+/*
+ * Free every page and every second level table.
+ */
+template <endian order>
+pagedMemory<order>::~pagedMemory()
+{
+	for( uint32_t i=0; i<PT_ENTRIES; ++i ) {
+		if( dir[i] == NULL )
+			continue;
+
+		for( uint32_t j=0; j<PT_ENTRIES; ++j )
+			delete [] dir[i][j];
+
+		delete [] dir[i];
+	}
+}
+
+
+/*
+ * Page table walk.
+ */
+template <endian order>
+const uint8_t *pagedMemory<order>::readPage( uint32_t addr )
+{
+	uint8_t **table = dir[ addr >> ( PAGE_SHIFT + PT_SHIFT ) ];
+	if( table == NULL )
+		return zeroPage;
+
+	uint8_t *page = table[ ( addr >> PAGE_SHIFT ) & ( PT_ENTRIES - 1 ) ];
+	if( page == NULL )
+		return zeroPage;
+
+	return page;
+}
+
+template <endian order>
+uint8_t *pagedMemory<order>::writePage( uint32_t addr )
+{
+	uint8_t **&table = dir[ addr >> ( PAGE_SHIFT + PT_SHIFT ) ];
+	if( table == NULL )
+		table = new uint8_t*[ PT_ENTRIES ]();
+
+	uint8_t *&page = table[ ( addr >> PAGE_SHIFT ) & ( PT_ENTRIES - 1 ) ];
+	if( page == NULL ) {
+		page = new uint8_t[ PAGE_SIZE ]();
+		pages++;
+
+		//the read TLB may still point at the zero page
+		tlbEntry &e = readTLB[ ( addr >> PAGE_SHIFT ) % TLB_ENTRIES ];
+		if( e.tag == ( addr & ~PAGE_MASK ) )
+			e.tag = TLB_INVALID;
+	}
+
+	return page;
+}
+
+
+/*
+ * TLB slow path. Check bounds, look for a device, 
+ * walk the page table and refill the entry. Out of
+ * bounds accesses go to the sink and leave a fault.
+ */
+template <endian order>
+const uint8_t *pagedMemory<order>::readMiss( uint32_t addr )
+{
+	stats.readMisses++;
+
+	if( addr >= mem_size ) {
+		fail( LOAD_FAULT, addr );
+		return sink;
+	}
+
+	if( ioRegions > 0 && ioAt( addr ) != NULL )
+		return NULL;
+
+	const uint8_t *page = readPage( addr );
+	if( cacheable( addr ) ) {
+		tlbEntry &e = readTLB[ ( addr >> PAGE_SHIFT ) % TLB_ENTRIES ];
+		e.tag = addr & ~PAGE_MASK;
+		e.host = (uint8_t *) page;
+	}
+
+	return page + ( addr & PAGE_MASK );
+}
+
+template <endian order>
+uint8_t *pagedMemory<order>::writeMiss( uint32_t addr )
+{
+	stats.writeMisses++;
+
+	if( addr >= mem_size ) {
+		fail( STORE_FAULT, addr );
+		return sink;
+	}
+
+	if( ioRegions > 0 && ioAt( addr ) != NULL )
+		return NULL;
+
+	uint8_t *page = writePage( addr );
+	if( cacheable( addr ) ) {
+		tlbEntry &e = writeTLB[ ( addr >> PAGE_SHIFT ) % TLB_ENTRIES ];
+		e.tag = addr & ~PAGE_MASK;
+		e.host = page;
+	}
+
+	return page + ( addr & PAGE_MASK );
+}
+
+template <endian order>
+bool pagedMemory<order>::cacheable( uint32_t addr )
+{
+	if( ( addr | PAGE_MASK ) >= mem_size )
+		return false;
+
+	for( int i=0; i<ioRegions; ++i )
+		if( ( addr & ~PAGE_MASK ) <= io[i].end && ( addr | PAGE_MASK ) >= io[i].start )
+			return false;
+
+	return true;
+}
+
+template <endian order>
+ioDevice *pagedMemory<order>::ioAt( uint32_t addr )
+{
+	for( int i=0; i<ioRegions; ++i )
+		if( addr >= io[i].start && addr <= io[i].end )
+			return io[i].dev;
+
+	return NULL;
+}
+
+
+/*
+ * Devices. Pages overlapping the region are dropped
+ * from the TLB so that accesses take the slow path.
+ */
+template <endian order>
+void pagedMemory<order>::mapIO( uint32_t start, uint32_t len, ioDevice *dev )
+{
+	if( ioRegions == MAX_IO )
+		throw "Too many memory mapped regions";
+
+	if( len == 0 )
+		return;
+
+	io[ ioRegions ].start = start;
+	io[ ioRegions ].end = start + ( len - 1 );
+	io[ ioRegions ].dev = dev;
+	ioRegions++;
+
+	flushTLB();
+}
+
+template <endian order>
+void pagedMemory<order>::flushTLB()
+{
+	for( int i=0; i<TLB_ENTRIES; ++i ) {
+		readTLB[i].tag = TLB_INVALID;
+		writeTLB[i].tag = TLB_INVALID;
+	}
+}
+
+template <endian order>
+void pagedMemory<order>::printTLBStats()
+{
+	uint64_t reads = stats.readHits + stats.readMisses;
+	uint64_t writes = stats.writeHits + stats.writeMisses;
+
+	printf( "-------------TLB--------------\n" );
+	printf( "reads:\t%llu\thits: %llu\tmisses: %llu\thit rate: %.2f%%\n",
+			(unsigned long long) reads, (unsigned long long) stats.readHits,
+			(unsigned long long) stats.readMisses, reads ? 100.0 * stats.readHits / reads : 0.0 );
+	printf( "writes:\t%llu\thits: %llu\tmisses: %llu\thit rate: %.2f%%\n",
+			(unsigned long long) writes, (unsigned long long) stats.writeHits,
+			(unsigned long long) stats.writeMisses, writes ? 100.0 * stats.writeHits / writes : 0.0 );
+}
+
+
+/*
+ * loads/stores of memory areas. Checks for proper alignment 
+ * of memory areas requested, misaligned ones leave a fault.
+ * Aligned accesses never cross a page.
+ */
+template <endian order>
+uint32_t pagedMemory<order>::loadWord( uint32_t addr )
+{
+	if( addr % 4 != 0 ) {
+		fail( LOAD_FAULT, addr );
+		return 0;
+	}
+
+	const uint8_t *p = readHost( addr );
+	if( p == NULL )
+		return ioAt( addr )->ioRead( addr, 4 );
+
+	return guestWord<order>( p );
+}
+
+template <endian order>
+void pagedMemory<order>::storeWord( uint32_t addr, uint32_t val )
+{
+	if( addr % 4 != 0 ) {
+		fail( STORE_FAULT, addr );
+		return;
+	}
+
+	uint8_t *p = writeHost( addr );
+	if( p == NULL )
+		ioAt( addr )->ioWrite( addr, val, 4 );
+	else
+		setGuestWord<order>( p, val );
+}
+
+template <endian order>
+uint16_t pagedMemory<order>::loadHalfWord( uint32_t addr )
+{
+	if( addr % 2 != 0 ) {
+		fail( LOAD_FAULT, addr );
+		return 0;
+	}
+
+	const uint8_t *p = readHost( addr );
+	if( p == NULL )
+		return ioAt( addr )->ioRead( addr, 2 );
+
+	return guestHalfWord<order>( p );
+}
+
+template <endian order>
+void pagedMemory<order>::storeHalfWord( uint32_t addr, uint16_t val )
+{
+	if( addr % 2 != 0 ) {
+		fail( STORE_FAULT, addr );
+		return;
+	}
+
+	uint8_t *p = writeHost( addr );
+	if( p == NULL )
+		ioAt( addr )->ioWrite( addr, val, 2 );
+	else
+		setGuestHalfWord<order>( p, val );
+}
+
+template <endian order>
+uint8_t pagedMemory<order>::loadByte( uint32_t addr )
+{
+	const uint8_t *p = readHost( addr );
+	if( p == NULL )
+		return ioAt( addr )->ioRead( addr, 1 );
+
+	return *p;
+}
+
+template <endian order>
+void pagedMemory<order>::storeByte( uint32_t addr, uint8_t val )
+{
+	uint8_t *p = writeHost( addr );
+	if( p == NULL )
+		ioAt( addr )->ioWrite( addr, val, 1 );
+	else
+		*p = val;
+}
+
+template class pagedMemory<BIG_END>;
+template class pagedMemory<LITTLE_END>;
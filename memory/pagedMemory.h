@@ -0,0 +1,148 @@
+/*
+ * pagedMemory.h
+ * Demand-paged memory model for MIPS. The address 
+ * space is split in 4KB pages which are allocated 
+ * the first time they are written. Pages are found 
+ * through a two-level page table, so a sparse program
+ * (text, data and stack far apart) only pays for 
+ * the pages it actually uses.
+ *
+ * A small direct-mapped software TLB sits in front of
+ * the page table and maps guest pages straight to host
+ * pointers, with separate entries for reads and writes.
+ * Memory mapped devices are never entered in the TLB.
+ */
+
+#ifndef __PAGED_MEMORY_H__
+#define __PAGED_MEMORY_H__
+
+#include "memory.h"
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	( 1U << PAGE_SHIFT )
+#define PAGE_MASK	( PAGE_SIZE - 1 )
+
+//a 32bit address is split in 10 + 10 + 12 bits
+#define PT_SHIFT	10
+#define PT_ENTRIES	( 1U << PT_SHIFT )
+
+#define TLB_ENTRIES	256
+#define TLB_INVALID	1	//never a page address
+#define MAX_IO		8
+
+
+/*
+ * A memory mapped device. size is 1, 2 or 4 bytes.
+ */
+class ioDevice {
+
+public:
+	virtual ~ioDevice() {};
+	virtual uint32_t ioRead( uint32_t addr, int size ) = 0;
+	virtual void ioWrite( uint32_t addr, uint32_t val, int size ) = 0;
+
+};
+
+struct tlbStats {
+	uint64_t readHits;
+	uint64_t readMisses;
+	uint64_t writeHits;
+	uint64_t writeMisses;
+};
+
+
+template <endian order>
+class pagedMemory : public Memory {
+
+public:
+	pagedMemory( uint32_t size );
+	~pagedMemory();
+	uint32_t loadWord( uint32_t addr );
+	void storeWord( uint32_t addr, uint32_t val );
+	uint16_t loadHalfWord( uint32_t addr );
+	void storeHalfWord( uint32_t addr, uint16_t val );
+	uint8_t loadByte( uint32_t addr );
+	void storeByte( uint32_t addr, uint8_t val );
+
+	//number of pages allocated so far
+	uint32_t pagesAllocated() const { return pages; }
+
+	//route [start, start+len) to a device
+	void mapIO( uint32_t start, uint32_t len, ioDevice *dev );
+
+	const tlbStats &getTLBStats() const { return stats; }
+	void printTLBStats();
+	void flushTLB();
+
+private:
+	//first level of the page table. Second level tables 
+	//are allocated along with the first page they hold.
+	uint8_t **dir[ PT_ENTRIES ];
+	uint32_t mem_size;
+	uint32_t pages;
+
+	struct tlbEntry {
+		uint32_t tag;		//guest page address
+		uint8_t *host;		//host address of the page
+	};
+
+	tlbEntry readTLB[ TLB_ENTRIES ];
+	tlbEntry writeTLB[ TLB_ENTRIES ];
+	tlbStats stats;
+
+	struct ioRegion {
+		uint32_t start;
+		uint32_t end;
+		ioDevice *dev;
+	};
+
+	ioRegion io[ MAX_IO ];
+	int ioRegions;
+
+	//what an access out of bounds reads and writes, with a fault left pending
+	uint8_t sink[4];
+
+	/*
+	 * Translate a guest address to a host pointer.
+	 * readPage() never allocates and returns the shared 
+	 * zero page for untouched pages, writePage() allocates 
+	 * on first touch.
+	 */
+	const uint8_t *readPage( uint32_t addr );
+	uint8_t *writePage( uint32_t addr );
+
+	/*
+	 * TLB fast path, falling back to readMiss/writeMiss.
+	 * A NULL result means the address belongs to a device.
+	 */
+	const uint8_t *readHost( uint32_t addr )
+	{
+		tlbEntry &e = readTLB[ ( addr >> PAGE_SHIFT ) % TLB_ENTRIES ];
+		if( e.tag == ( addr & ~PAGE_MASK ) ) {
+			stats.readHits++;
+			return e.host + ( addr & PAGE_MASK );
+		}
+		return readMiss( addr );
+	}
+
+	uint8_t *writeHost( uint32_t addr )
+	{
+		tlbEntry &e = writeTLB[ ( addr >> PAGE_SHIFT ) % TLB_ENTRIES ];
+		if( e.tag == ( addr & ~PAGE_MASK ) ) {
+			stats.writeHits++;
+			return e.host + ( addr & PAGE_MASK );
+		}
+		return writeMiss( addr );
+	}
+
+	const uint8_t *readMiss( uint32_t addr );
+	uint8_t *writeMiss( uint32_t addr );
+	ioDevice *ioAt( uint32_t addr );
+
+	//only pages entirely within bounds are cached
+	bool cacheable( uint32_t addr );
+
+};
+
+
+#endif /* __PAGED_MEMORY_H__ */
@@ -0,0 +1,164 @@
+/*
+ * prefetcher.cpp
+ * next line, stride and stream buffer prefetchers.
+ */
+#include "prefetcher.h"
+#include <stdio.h>
+
+static double percent( uint64_t part, uint64_t whole )
+{
+	return whole ? 100.0 * part / whole : 0.0;
+}
+
+void prefetcher::printStats()
+{
+	printf( "%s: %llu issued, %llu useful, %llu late, %llu useless: accuracy %.1f%%, coverage %.1f%%, timely %.1f%%\n",
+		name(), (unsigned long long) issued, (unsigned long long) useful, (unsigned long long) late,
+		(unsigned long long) useless, percent( useful, issued ), percent( useful, useful + missed ),
+		percent( useful - late, useful ) );
+}
+
+
+unsigned nextLinePrefetcher::observe( uint32_t addr, uint32_t, bool missed, uint32_t *lines, unsigned max )
+{
+	if( !missed )
+		return 0;
+
+	uint32_t line = addr & ~( lineBytes - 1 );
+	unsigned n = ( degree < max ) ? degree : max;
+	for( unsigned i=0; i<n; ++i )
+		lines[i] = line + ( i + 1 ) * lineBytes;
+	return n;
+}
+
+
+stridePrefetcher::stridePrefetcher( unsigned bits, unsigned degree ) : degree( degree )
+{
+	mask = ( 1U << bits ) - 1;
+	table = new strideEntry[ 1U << bits ];
+	for( uint32_t i=0; i<=mask; ++i ) {
+		table[i].pc = NO_PC;
+		table[i].last = 0;
+		table[i].stride = 0;
+		table[i].confidence = 0;
+	}
+}
+
+stridePrefetcher::~stridePrefetcher()
+{
+	delete[] table;
+}
+
+/*
+ * A new stride only replaces the old one once the
+ * confidence is gone. Strides shorter than a line go
+ * a line at a time, so that degree lines are ahead.
+ */
+unsigned stridePrefetcher::observe( uint32_t addr, uint32_t pc, bool, uint32_t *lines, unsigned max )
+{
+	if( pc == NO_PC )
+		return 0;
+
+	strideEntry &e = table[ ( pc >> 2 ) & mask ];
+	if( e.pc != pc ) {
+		e.pc = pc;
+		e.last = addr;
+		e.stride = 0;
+		e.confidence = 0;
+		return 0;
+	}
+
+	int32_t stride = addr - e.last;
+	e.last = addr;
+	if( stride != 0 && stride == e.stride )
+		e.confidence += ( e.confidence < 3 );
+	else if( e.confidence > 0 )
+		--e.confidence;
+	else
+		e.stride = stride;
+
+	if( e.confidence < 2 )
+		return 0;
+
+	int32_t step = e.stride;
+	if( step < (int32_t) lineBytes && step > -(int32_t) lineBytes )
+		step = ( step > 0 ) ? lineBytes : -lineBytes;
+	unsigned n = ( degree < max ) ? degree : max;
+	for( unsigned i=0; i<n; ++i )
+		lines[i] = addr + ( i + 1 ) * step;
+	return n;
+}
+
+
+streamBuffers::streamBuffers( unsigned streams, unsigned depth ) : streams( streams ), depth( depth )
+{
+	if( streams == 0 || streams > MAX_STREAMS || depth == 0 || depth > MAX_STREAM_DEPTH )
+		throw "streamBuffers: bad number of streams or depth";
+
+	for( unsigned b=0; b<MAX_STREAMS; ++b ) {
+		buffers[b].count = 0;
+		buffers[b].next = 0;
+		buffers[b].lastUse = 0;
+	}
+	hit = filling = -1;
+	uses = 0;
+}
+
+//lines ahead of the one taken were skipped by the program, they go
+bool streamBuffers::take( uint32_t line, uint64_t &ready )
+{
+	for( unsigned b=0; b<streams; ++b ) {
+		stream &s = buffers[b];
+		for( unsigned i=0; i<s.count; ++i )
+			if( s.lines[i] == line ) {
+				ready = s.ready[i];
+				useless += i;
+				s.count -= i + 1;
+				for( unsigned j=0; j<s.count; ++j ) {
+					s.lines[j] = s.lines[ i + 1 + j ];
+					s.ready[j] = s.ready[ i + 1 + j ];
+				}
+				s.lastUse = ++uses;
+				hit = b;
+				return true;
+			}
+	}
+	return false;
+}
+
+unsigned streamBuffers::observe( uint32_t addr, uint32_t, bool missed, uint32_t *lines, unsigned max )
+{
+	if( !missed )
+		return 0;
+
+	if( hit < 0 ) {
+		unsigned oldest = 0;
+		for( unsigned b=1; b<streams; ++b )
+			if( buffers[b].lastUse < buffers[ oldest ].lastUse )
+				oldest = b;
+		stream &s = buffers[ oldest ];
+		useless += s.count;
+		s.count = 0;
+		s.next = ( addr & ~( lineBytes - 1 ) ) + lineBytes;
+		s.lastUse = ++uses;
+		hit = oldest;
+	}
+
+	stream &s = buffers[ hit ];
+	filling = hit;
+	hit = -1;
+	unsigned n = 0;
+	for( ; s.count + n < depth && n < max; ++n ) {
+		lines[n] = s.next;
+		s.next += lineBytes;
+	}
+	return n;
+}
+
+void streamBuffers::arrived( uint32_t line, uint64_t ready )
+{
+	stream &s = buffers[ filling ];
+	s.lines[ s.count ] = line;
+	s.ready[ s.count ] = ready;
+	++s.count;
+}
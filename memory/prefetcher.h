@@ -0,0 +1,138 @@
+/*
+ * prefetcher.h
+ * Hardware prefetchers for a cacheLevel. A prefetcher sees
+ * every demand access to its level, with the pc of the load
+ * when there is one, and names the lines to bring in. The
+ * level fills them, or hands them back for stream buffers,
+ * which keep their lines apart from the cache.
+ *
+ * The level keeps the counters: a prefetched line is useful
+ * once demanded, late if demanded before it was in, and
+ * useless if it went unused.
+ */
+
+#ifndef __PREFETCHER_H__
+#define __PREFETCHER_H__
+
+#include <stdint.h>
+
+//most lines a prefetcher asks for after one access
+#define MAX_PREFETCH	8
+
+//pc of an access that is not a load of the pipeline
+#define NO_PC	0xffffffff
+
+class prefetcher {
+
+public:
+	prefetcher() : lineBytes( 0 ), issued( 0 ), useful( 0 ), late( 0 ), useless( 0 ), missed( 0 ) {}
+	virtual ~prefetcher() {}
+
+	/*
+	 * After an access to addr, missed if it would have missed
+	 * without prefetching. Puts the addresses to prefetch in
+	 * lines, up to max of them, and returns how many.
+	 */
+	virtual unsigned observe( uint32_t addr, uint32_t pc, bool missed, uint32_t *lines, unsigned max ) = 0;
+
+	virtual const char *name() const = 0;
+
+	//true if the lines are kept here rather than in the cache
+	virtual bool buffered() const { return false; }
+
+	//for those, a miss asks for line, which is gone once taken, and ready is when it is in
+	virtual bool take( uint32_t, uint64_t & ) { return false; }
+	virtual void arrived( uint32_t, uint64_t ) {}
+
+	//accuracy, coverage and timeliness
+	void printStats();
+
+	uint32_t lineBytes;	//set by the level
+	uint64_t issued;
+	uint64_t useful;
+	uint64_t late;		//of the useful ones
+	uint64_t useless;
+	uint64_t missed;	//demand misses it did not cover
+
+};
+
+//on a miss, or the first use of a prefetched line, the next degree lines
+class nextLinePrefetcher : public prefetcher {
+
+public:
+	nextLinePrefetcher( unsigned degree ) : degree( degree ) {}
+	unsigned observe( uint32_t addr, uint32_t pc, bool missed, uint32_t *lines, unsigned max );
+	const char *name() const { return "next line"; }
+
+private:
+	unsigned degree;
+
+};
+
+/*
+ * A table indexed by the pc of the load keeps its last
+ * address and stride. Once the same stride was seen twice
+ * the next degree addresses along it are prefetched.
+ */
+class stridePrefetcher : public prefetcher {
+
+public:
+	//2^bits entries
+	stridePrefetcher( unsigned bits, unsigned degree );
+	~stridePrefetcher();
+	unsigned observe( uint32_t addr, uint32_t pc, bool missed, uint32_t *lines, unsigned max );
+	const char *name() const { return "stride"; }
+
+private:
+	struct strideEntry {
+		uint32_t pc;
+		uint32_t last;
+		int32_t stride;
+		uint8_t confidence;	//0..3, prefetch from 2
+	};
+
+	strideEntry *table;
+	uint32_t mask;
+	unsigned degree;
+
+};
+
+#define MAX_STREAMS		8
+#define MAX_STREAM_DEPTH	8
+
+/*
+ * Stream buffers as Jouppi has them: a miss in the cache
+ * and in every buffer restarts the least recently used one
+ * with the lines after it. A miss found in a buffer moves
+ * the line to the cache, drops the ones before it and
+ * tops the buffer up.
+ */
+class streamBuffers : public prefetcher {
+
+public:
+	streamBuffers( unsigned streams, unsigned depth );
+	unsigned observe( uint32_t addr, uint32_t pc, bool missed, uint32_t *lines, unsigned max );
+	const char *name() const { return "stream buffers"; }
+	bool buffered() const { return true; }
+	bool take( uint32_t line, uint64_t &ready );
+	void arrived( uint32_t line, uint64_t ready );
+
+private:
+	struct stream {
+		uint32_t lines[ MAX_STREAM_DEPTH ];
+		uint64_t ready[ MAX_STREAM_DEPTH ];
+		unsigned count;		//oldest first
+		uint32_t next;		//line to ask for next
+		uint64_t lastUse;
+	};
+
+	stream buffers[ MAX_STREAMS ];
+	unsigned streams;
+	unsigned depth;
+	int hit;		//buffer take() found the line in, or -1
+	int filling;		//buffer arrived() appends to
+	uint64_t uses;
+
+};
+
+#endif /* __PREFETCHER_H__ */
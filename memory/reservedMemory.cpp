@@ -0,0 +1,158 @@
+/*
+ * reservedMemory.cpp
+ * Implementation of the reserved address space memory.
+ * The SIGSEGV handler recognizes accesses falling in a
+ * reservation, records the fault and opens the faulting 
+ * page so the host instruction can complete. The page 
+ * is closed again once the processor has consumed the 
+ * fault.
+ */
+#include "reservedMemory.h"
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define HOST_PAGE	4096UL
+#define MAX_RESERVATIONS	16
+
+//every live reservation, scanned by the signal handler
+static reservedSpace *reservations[ MAX_RESERVATIONS ];
+static struct sigaction oldAction;
+static bool handlerInstalled = false;
+
+
+void reservedMemoryHandler( int sig, siginfo_t *info, void *context )
+{
+	bool write = false;
+
+#if defined( __x86_64__ ) && defined( __linux__ )
+	//bit 1 of the page fault error code is set on writes, elsewhere all faults read as loads
+	ucontext_t *uc = (ucontext_t *) context;
+	write = ( uc->uc_mcontext.gregs[ REG_ERR ] & 2 ) != 0;
+#endif
+
+	if( reservedSpace::trap( (uint8_t *) info->si_addr, write ) )
+		return;
+
+	//not ours, or too many faults left pending: let the fault take its default course
+	sigaction( SIGSEGV, &oldAction, NULL );
+}
+
+
+/*
+ * Constructor. Reserve the whole guest space without
+ * committing any of it.
+ */
+reservedSpace::reservedSpace()
+{
+	void *p = mmap( NULL, GUEST_SPACE, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if( p == MAP_FAILED )
+		throw "Could not reserve guest address space";
+
+	base = (uint8_t *) p;
+	opened = 0;
+
+	int i;
+	for( i=0; i<MAX_RESERVATIONS; ++i )
+		if( reservations[i] == NULL ) {
+			reservations[i] = this;
+			break;
+		}
+
+	if( i == MAX_RESERVATIONS ) {
+		munmap( base, GUEST_SPACE );
+		throw "Too many reserved memories";
+	}
+
+	if( !handlerInstalled ) {
+		struct sigaction sa;
+		sa.sa_sigaction = reservedMemoryHandler;
+		sa.sa_flags = SA_SIGINFO;
+		sigemptyset( &sa.sa_mask );
+		sigaction( SIGSEGV, &sa, &oldAction );
+		handlerInstalled = true;
+	}
+}
+
+reservedSpace::~reservedSpace()
+{
+	for( int i=0; i<MAX_RESERVATIONS; ++i )
+		if( reservations[i] == this )
+			reservations[i] = NULL;
+
+	munmap( base, GUEST_SPACE );
+}
+
+
+/*
+ * Open a region for the guest. Rounded out to host pages.
+ * Physical memory is only used once the guest touches it.
+ */
+void reservedSpace::commit( uint32_t start, uint32_t len )
+{
+	uint64_t first = start & ~( HOST_PAGE - 1 );
+	uint64_t last = ( (uint64_t) start + len + HOST_PAGE - 1 ) & ~( HOST_PAGE - 1 );
+
+	if( last > GUEST_SPACE )
+		last = GUEST_SPACE;
+
+	if( mprotect( base + first, last - first, PROT_READ | PROT_WRITE ) != 0 )
+		throw "Could not commit memory region";
+}
+
+
+/*
+ * Called from the signal handler. If the host address falls
+ * in one of the reservations record the fault and open a 
+ * zeroed page under it, so the load reads 0 and the store 
+ * goes nowhere. A fault while another is pending, as when
+ * the fetch and the MEM stage fault in the same cycle, is
+ * only given its page. Once MAX_SCRATCH pages are open the
+ * fault is refused.
+ */
+bool reservedSpace::trap( uint8_t *host, bool write )
+{
+	for( int i=0; i<MAX_RESERVATIONS; ++i ) {
+		reservedSpace *m = reservations[i];
+		if( m == NULL || host < m->base || host >= m->base + GUEST_SPACE )
+			continue;
+
+		uint8_t *page = (uint8_t *) ( (uintptr_t) host & ~( HOST_PAGE - 1 ) );
+		if( m->opened == MAX_SCRATCH ) {
+			static const char msg[] = "reservedMemory: too many faults pending\n";
+			ssize_t n = ::write( 2, msg, sizeof( msg ) - 1 );
+			(void) n;
+			return false;
+		}
+		if( mprotect( page, HOST_PAGE, PROT_READ | PROT_WRITE ) != 0 )
+			return false;
+
+		m->scratch[ m->opened++ ] = page;
+		if( m->pending == NO_FAULT ) {
+			m->badAddr = host - m->base;
+			m->pending = write ? STORE_FAULT : LOAD_FAULT;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+/*
+ * The processor has taken the fault. Drop whatever was
+ * written in the scratch pages and close them again.
+ */
+void reservedSpace::clearFault()
+{
+	for( unsigned i=0; i<opened; ++i ) {
+		madvise( scratch[i], HOST_PAGE, MADV_DONTNEED );
+		mprotect( scratch[i], HOST_PAGE, PROT_NONE );
+	}
+	opened = 0;
+
+	pending = NO_FAULT;
+}
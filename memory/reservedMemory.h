@@ -0,0 +1,116 @@
+/*
+ * reservedMemory.h
+ * Memory model reserving the whole 4GB guest address
+ * space up front with PROT_NONE. Only the regions the 
+ * program needs are committed, and the host kernel 
+ * backs them with physical pages on first touch. 
+ * Any guest address maps to base + addr, so accessors 
+ * need no bounds check: touching a region that is not
+ * committed traps, and the SIGSEGV handler leaves an
+ * AdEL/AdES fault pending for the processor.
+ *
+ * Stores are told from loads by the page fault error
+ * code, which is only read on x86-64 Linux. On any other
+ * host every fault, stores too, is reported as AdEL.
+ */
+
+#ifndef __RESERVED_MEMORY_H__
+#define __RESERVED_MEMORY_H__
+
+#include "memory.h"
+#include <signal.h>
+
+#define GUEST_SPACE	( 1ULL << 32 )
+
+//faults that can be taken before the processor clears them
+#define MAX_SCRATCH	4
+
+
+/*
+ * Reservation and fault handling, common to both
+ * byte orders.
+ */
+class reservedSpace : public Memory {
+
+public:
+	reservedSpace();
+	~reservedSpace();
+
+	//make [start, start+len) accessible to the guest
+	void commit( uint32_t start, uint32_t len );
+
+	void clearFault();
+
+protected:
+	uint8_t *base;
+
+	uint32_t misaligned( uint32_t addr, memFault f )
+	{
+		pending = f;
+		badAddr = addr;
+		return 0;
+	}
+
+private:
+	//pages temporarily opened by the signal handler so 
+	//that the faulting accesses could complete. Faults
+	//after the first, until it is cleared, only open
+	//their page: the first one is the one reported
+	uint8_t *scratch[ MAX_SCRATCH ];
+	unsigned opened;
+
+	static bool trap( uint8_t *host, bool write );
+	friend void reservedMemoryHandler( int, siginfo_t *, void * );
+
+};
+
+
+template <endian order>
+class reservedMemory : public reservedSpace {
+
+public:
+
+	/*
+	 * Accessors are defined here so that a caller holding
+	 * a reservedMemory reduces them to the alignment test 
+	 * and a single host load or store.
+	 */
+	uint32_t loadWord( uint32_t addr )
+	{
+		if( addr % 4 != 0 )
+			return misaligned( addr, LOAD_FAULT );
+		return guestWord<order>( base + addr );
+	}
+
+	void storeWord( uint32_t addr, uint32_t val )
+	{
+		if( addr % 4 != 0 ) {
+			misaligned( addr, STORE_FAULT );
+			return;
+		}
+		setGuestWord<order>( base + addr, val );
+	}
+
+	uint16_t loadHalfWord( uint32_t addr )
+	{
+		if( addr % 2 != 0 )
+			return misaligned( addr, LOAD_FAULT );
+		return guestHalfWord<order>( base + addr );
+	}
+
+	void storeHalfWord( uint32_t addr, uint16_t val )
+	{
+		if( addr % 2 != 0 ) {
+			misaligned( addr, STORE_FAULT );
+			return;
+		}
+		setGuestHalfWord<order>( base + addr, val );
+	}
+
+	uint8_t loadByte( uint32_t addr ) { return base[addr]; }
+	void storeByte( uint32_t addr, uint8_t val ) { base[addr] = val; }
+
+};
+
+
+#endif /* __RESERVED_MEMORY_H__ */
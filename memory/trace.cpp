@@ -0,0 +1,217 @@
+/*
+ * trace.cpp
+ * the trace ring, its writer thread and the record coding.
+ */
+#include "trace.h"
+#include <string.h>
+#include <chrono>
+
+//longest record: the byte, two 5 byte varints and a 10 byte one
+#define MAX_RECORD	21
+
+static const uint8_t magic[8] = { 'M', 'T', 'R', 'C', TRACE_VERSION, 0, 0, 0 };
+
+static inline uint32_t zigzag( uint32_t to, uint32_t from )
+{
+	int32_t d = (int32_t)( to - from );
+	return ( (uint32_t) d << 1 ) ^ (uint32_t)( d >> 31 );
+}
+
+static inline uint32_t unzigzag( uint32_t z, uint32_t from )
+{
+	return from + ( ( z >> 1 ) ^ -( z & 1 ) );
+}
+
+static inline uint8_t *putVarint( uint8_t *p, uint64_t v )
+{
+	while( v >= 0x80 ) {
+		*p++ = (uint8_t) v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t) v;
+	return p;
+}
+
+static uint8_t *encode( uint8_t *p, const traceRecord &r, traceState &s )
+{
+	uint64_t cycles = r.cycle - s.cycle;
+	uint32_t &pc = ( r.kind == TRACE_FETCH ) ? s.fetchPc : s.dataPc;
+	bool sequential = r.pc == pc + 4;
+
+	*p++ = r.kind | ( r.size - 1 ) << 2 | sequential << 5 | ( cycles < 3 ? cycles : 3 ) << 6;
+	if( !sequential )
+		p = putVarint( p, zigzag( r.pc, pc ) );
+	if( r.kind != TRACE_FETCH ) {
+		p = putVarint( p, zigzag( r.addr, s.dataAddr ) );
+		s.dataAddr = r.addr;
+	}
+	if( cycles >= 3 )
+		p = putVarint( p, cycles - 3 );
+
+	pc = r.pc;
+	s.cycle = r.cycle;
+	return p;
+}
+
+
+traceRecorder::traceRecorder( const char *file )
+	: head( 0 ), tailSeen( 0 ), waited( 0 ), published( 0 ), consumed( 0 ), done( false ), written( 0 ), closed( false )
+{
+	f = fopen( file, "wb" );
+	if( f == NULL )
+		throw "traceRecorder: can not open the trace file";
+	if( fwrite( magic, 1, sizeof( magic ), f ) != sizeof( magic ) ) {
+		fclose( f );
+		throw "traceRecorder: can not write the trace file";
+	}
+	ring = new traceRecord[ TRACE_RING ];
+	writer = std::thread( &traceRecorder::run, this );
+}
+
+traceRecorder::~traceRecorder()
+{
+	close();
+	delete[] ring;
+}
+
+void traceRecorder::close()
+{
+	if( closed )
+		return;
+	closed = true;
+	published.store( head, std::memory_order_release );
+	done.store( true, std::memory_order_release );
+	writer.join();
+	fclose( f );
+}
+
+//hand over what there is and wait for the writer to take some
+void traceRecorder::waitForRoom()
+{
+	++waited;
+	published.store( head, std::memory_order_release );
+	while( head - ( tailSeen = consumed.load( std::memory_order_acquire ) ) == TRACE_RING )
+		std::this_thread::yield();
+}
+
+/*
+ * The writer encodes whatever was handed over into its
+ * buffer and writes the buffer once full, freeing ring
+ * entries as it goes. With nothing to do it yields a few
+ * times, then sleeps twice as long every time up to
+ * TRACE_SLEEP_MAX, and once done it takes the last
+ * records and stops.
+ */
+void traceRecorder::run()
+{
+	uint8_t *out = new uint8_t[ TRACE_BUFFER ];
+	traceState state;
+	memset( &state, 0, sizeof( state ) );
+	uint8_t *p = out;
+	uint64_t tail = 0;
+	unsigned idle = 0, sleep = 1;
+
+	for( ;; ) {
+		bool last = done.load( std::memory_order_acquire );
+		uint64_t avail = published.load( std::memory_order_acquire );
+		if( avail == tail ) {
+			if( last )
+				break;
+			if( idle < TRACE_SPINS ) {
+				std::this_thread::yield();
+				++idle;
+			} else {
+				std::this_thread::sleep_for( std::chrono::microseconds( sleep ) );
+				sleep = ( sleep < TRACE_SLEEP_MAX / 2 ) ? sleep * 2 : TRACE_SLEEP_MAX;
+			}
+			continue;
+		}
+		idle = 0;
+		sleep = 1;
+
+		while( tail != avail ) {
+			if( p > out + TRACE_BUFFER - MAX_RECORD ) {
+				written += fwrite( out, 1, p - out, f );
+				p = out;
+			}
+			p = encode( p, ring[ tail & ( TRACE_RING - 1 ) ], state );
+			if( ( ++tail & ( TRACE_PUBLISH - 1 ) ) == 0 )
+				consumed.store( tail, std::memory_order_release );
+		}
+		consumed.store( tail, std::memory_order_release );
+	}
+	written += fwrite( out, 1, p - out, f );
+	written += sizeof( magic );
+	delete[] out;
+}
+
+
+traceReader::traceReader( const char *file ) : pos( 0 ), len( 0 )
+{
+	f = fopen( file, "rb" );
+	if( f == NULL )
+		throw "traceReader: can not open the trace file";
+	uint8_t header[ sizeof( magic ) ];
+	if( fread( header, 1, sizeof( header ), f ) != sizeof( header ) || memcmp( header, magic, sizeof( magic ) ) != 0 ) {
+		fclose( f );
+		throw "traceReader: not a trace, or of another version";
+	}
+	memset( &state, 0, sizeof( state ) );
+}
+
+traceReader::~traceReader()
+{
+	fclose( f );
+}
+
+//at least want bytes in the buffer, unless the file ends first
+bool traceReader::refill( unsigned want )
+{
+	if( len - pos >= want )
+		return true;
+	memmove( buffer, buffer + pos, len - pos );
+	len -= pos;
+	pos = 0;
+	len += fread( buffer + len, 1, sizeof( buffer ) - len, f );
+	return len >= want;
+}
+
+uint64_t traceReader::varint()
+{
+	uint64_t v = 0;
+	for( unsigned shift=0; ; shift += 7 ) {
+		if( pos == len || shift > 63 )
+			throw "traceReader: truncated record";
+		uint8_t b = buffer[ pos++ ];
+		v |= (uint64_t)( b & 0x7f ) << shift;
+		if( !( b & 0x80 ) )
+			return v;
+	}
+}
+
+bool traceReader::next( traceRecord &r )
+{
+	refill( MAX_RECORD );
+	if( pos == len )
+		return false;
+
+	uint8_t b = buffer[ pos++ ];
+	r.kind = b & 3;
+	r.size = ( ( b >> 2 ) & 7 ) + 1;
+	if( r.kind > TRACE_WRITE )
+		throw "traceReader: bad record";
+
+	uint32_t &pc = ( r.kind == TRACE_FETCH ) ? state.fetchPc : state.dataPc;
+	pc = ( b & 0x20 ) ? pc + 4 : unzigzag( varint(), pc );
+	r.pc = pc;
+	if( r.kind == TRACE_FETCH )
+		r.addr = pc;
+	else
+		r.addr = state.dataAddr = unzigzag( varint(), state.dataAddr );
+
+	uint64_t cycles = b >> 6;
+	if( cycles == 3 )
+		cycles += varint();
+	r.cycle = state.cycle += cycles;
+	return true;
+}
@@ -0,0 +1,135 @@
+/*
+ * trace.h
+ * Binary trace of the instruction fetches and data accesses
+ * of a run. The simulator hands records to a traceRecorder,
+ * which passes them through a ring to a writer thread that
+ * encodes and writes them, and a traceReader gives them
+ * back. One producer and one consumer share the ring, each
+ * owning one index, so neither takes a lock.
+ *
+ * The file is "MTRC", a version byte and three zero bytes,
+ * then a record after another. A record is a byte
+ *
+ *	bits 0-1	kind
+ *	bits 2-4	size - 1
+ *	bit 5		pc is 4 past the last of its side
+ *	bits 6-7	cycles since the last record, 3 for more
+ *
+ * then, as varints, the pc as a zigzag delta from the last
+ * one of its side unless bit 5 is set, for data the address
+ * as a zigzag delta from the last data address, and the
+ * cycles less 3 if bits 6-7 are 3. A fetch is at its pc.
+ * Fetches and data accesses are the two sides.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#define TRACE_VERSION	1
+#define TRACE_RING	( 1 << 16 )	//records
+#define TRACE_PUBLISH	256		//records the producer hands over at a time
+#define TRACE_BUFFER	( 1 << 16 )	//bytes written at a time
+#define TRACE_SPINS	64		//yields of an idle writer before it sleeps
+#define TRACE_SLEEP_MAX	256		//microseconds, well under the time to fill the ring
+
+typedef enum {
+	TRACE_FETCH,
+	TRACE_READ,
+	TRACE_WRITE
+} traceKind;
+
+struct traceRecord {
+	uint64_t cycle;
+	uint32_t pc;
+	uint32_t addr;
+	uint8_t kind;		//traceKind
+	uint8_t size;		//bytes, 1 to 8
+};
+
+//what the encoder and the decoder keep between records
+struct traceState {
+	uint64_t cycle;
+	uint32_t fetchPc;
+	uint32_t dataPc;
+	uint32_t dataAddr;
+};
+
+class traceRecorder {
+
+public:
+	//starts the writer, throws if file can not be written
+	traceRecorder( const char *file );
+	~traceRecorder();
+
+	//cycles are not to go backwards
+	void record( uint8_t kind, uint32_t pc, uint32_t addr, uint8_t size, uint64_t cycle )
+	{
+		if( __builtin_expect( head - tailSeen == TRACE_RING, 0 ) )
+			waitForRoom();
+		traceRecord &r = ring[ head & ( TRACE_RING - 1 ) ];
+		r.cycle = cycle;
+		r.pc = pc;
+		r.addr = addr;
+		r.kind = kind;
+		r.size = size;
+		if( ( ++head & ( TRACE_PUBLISH - 1 ) ) == 0 )
+			published.store( head, std::memory_order_release );
+	}
+
+	//writes what is left and closes the file, once
+	void close();
+
+	uint64_t records() const { return head; }
+	uint64_t bytes() const { return written; }	//once closed
+	uint64_t waits() const { return waited; }	//times the ring was full
+
+private:
+	traceRecord *ring;
+
+	//the producer's, the first written by it alone
+	uint64_t head;
+	uint64_t tailSeen;
+	uint64_t waited;
+
+	alignas( 64 ) std::atomic<uint64_t> published;
+	alignas( 64 ) std::atomic<uint64_t> consumed;
+	std::atomic<bool> done;
+
+	alignas( 64 ) FILE *f;
+	std::thread writer;
+	uint64_t written;
+	bool closed;
+
+	void waitForRoom();
+	void run();
+
+};
+
+class traceReader {
+
+public:
+	//throws if file is not a trace
+	traceReader( const char *file );
+	~traceReader();
+
+	//false at the end of the trace
+	bool next( traceRecord &r );
+
+private:
+	FILE *f;
+	uint8_t buffer[ TRACE_BUFFER ];
+	unsigned pos;
+	unsigned len;
+	traceState state;
+
+	bool refill( unsigned want );
+	uint64_t varint();
+
+};
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,582 @@
+/*
+ * blockProcessor.cpp
+ * Block translation and the loop running blocks.
+ * A block ends at a branch or jump, at MAX_BLOCK
+ * instructions, or before anything it can not hold
+ * (unknown ops, BREAK, the end of the text area). J and
+ * JAL with a target in the text area do not end the
+ * block, translation goes on at the target. Whatever no
+ * block covers runs through simpleProcessor::execute().
+ */
+
+#include "blockProcessor.h"
+#include "safeops.h"
+
+using namespace std;
+
+/*
+ * Same checks as RegisterFile::setReg. Loads into r0 go to 
+ * r[REG_NR]. ADD/SUB wrap inline as in threadedProcessor.
+ */
+#define SET( n, v ) do {						\
+		int32_t val_ = ( v );					\
+		if( ( n ) == 29 && val_ > STACK_MAX )			\
+			throw "Not valid address for stack pointer";	\
+		r[ n ] = val_;						\
+	} while( 0 )
+
+#define NEXT()		do { ++u; goto *labels[ u->op ]; } while( 0 )
+#define CHECK_FAULT()	do { if( mem->fault() != NO_FAULT ) goto fault; } while( 0 )
+
+/*
+ * After a store into the text area, leave the block if it 
+ * dropped translations. u may be gone by then.
+ */
+#define CHECK_TEXT()	do {							\
+		if( addr - startAddr <= span ) {				\
+			uint32_t rest = u->after;				\
+			uint32_t next = u->pc + 4;				\
+			textWritten( addr );					\
+			if( invalidated ) {					\
+				left += rest;					\
+				pc_ = next;					\
+				goto leave;					\
+			}							\
+		}								\
+	} while( 0 )
+
+void blockProcessor::run()
+{
+	while( true )
+		run( ~(uint64_t)0 );
+}
+
+uint64_t blockProcessor::run( uint64_t budget )
+{
+	//in decodedOp order, then the micro-ops
+	static void *const labels[ MICRO_OP_COUNT ] = {
+		&&Unknown, &&ADD, &&AND, &&BREAK, &&DIV, &&DIVU, &&JALR, &&JR, &&MFHI,
+		&&MFLO, &&MTHI, &&MTLO, &&MULT, &&MULTU, &&NOR, &&OR, &&XOR, &&SLL,
+		&&SLLV, &&SRL, &&SRLV, &&SLT, &&SLTU, &&SRA, &&SUB, &&J, &&JAL,
+		&&ADDI, &&ANDI, &&BEQ, &&NOP, &&BNE, &&LB, &&LBU, &&LH, &&LHU, &&LUI,
+		&&LW, &&ORI, &&SB, &&SLTI, &&SLTIU, &&SH, &&SW, &&XORI,
+		&&END, &&LINK
+	};
+
+	int32_t r[ REG_NR + 1 ];
+	int32_t hi, lo;
+	uint32_t pc_ = pc;
+	uint64_t left = budget;
+	const uint32_t span = endAddr - startAddr;
+	block *b = NULL, *prev = NULL;
+	const microOp *u = NULL;
+	uint32_t addr;
+	uint64_t wide;		//product of MULT and MULTU
+
+	//true while the register file and pc hold the state, not the locals
+	bool synced = false;
+
+	loadRegisters( r, hi, lo );
+
+	try {
+
+find:
+		if( left == 0 )
+			goto done;
+		b = lookup( pc_ );
+		if( b == NULL )
+			goto slow;
+
+		//remember where the previous block went
+		if( prev != NULL ) {
+			if( pc_ == prev->fallPC )
+				prev->fall = b;
+			else if( prev->indirect || pc_ == prev->takenPC ) {
+				prev->takenPC = pc_;
+				prev->taken = b;
+			}
+		}
+
+enter:
+		if( left < b->length )
+			goto slow;
+		left -= b->length;
+		u = &b->ops[0];
+		goto *labels[ u->op ];
+
+chain:
+		u = NULL;
+		if( left == 0 )
+			goto done;
+		if( pc_ == b->takenPC && b->taken != NULL ) {
+			b = b->taken;
+			goto enter;
+		}
+		if( pc_ == b->fallPC && b->fall != NULL ) {
+			b = b->fall;
+			goto enter;
+		}
+		prev = b;
+		goto find;
+
+leave:
+		u = NULL;
+		prev = NULL;
+		invalidated = false;
+		goto find;
+
+slow:
+		storeRegisters( r, hi, lo );
+		pc = pc_;
+		synced = true;
+		execute();
+		synced = false;
+		--left;
+		invalidated = false;
+		loadRegisters( r, hi, lo );
+		pc_ = pc;
+		prev = NULL;
+		goto find;
+
+fault:
+		storeRegisters( r, hi, lo );
+		pc = u->pc;
+		synced = true;
+		memoryFault();
+
+	//never part of a block
+Unknown:
+BREAK:
+		throw "blockProcessor: untranslatable operation in a block";
+
+	//R-TYPE
+ADD:
+		SET( u->rd, (uint32_t) r[ u->rs ] + r[ u->rt ] );
+		NEXT();
+AND:
+		SET( u->rd, r[ u->rs ] & r[ u->rt ] );
+		NEXT();
+DIV:
+		if( DIVIDES( r[ u->rs ], r[ u->rt ] ) ) {
+			lo = r[ u->rs ] / r[ u->rt ];
+			hi = r[ u->rs ] % r[ u->rt ];
+		}
+		NEXT();
+DIVU:
+		if( r[ u->rt ] != 0 ) {
+			lo = (uint32_t) r[ u->rs ] / r[ u->rt ];
+			hi = (uint32_t) r[ u->rs ] % r[ u->rt ];
+		}
+		NEXT();
+JALR:
+		addr = r[ u->rs ];
+		r[31] = u->pc + 4;
+		pc_ = addr;
+		goto chain;
+JR:
+		pc_ = r[ u->rs ];
+		goto chain;
+MFHI:
+		SET( u->rd, hi );
+		NEXT();
+MFLO:
+		SET( u->rd, lo );
+		NEXT();
+MTHI:
+		hi = u->rd;
+		NEXT();
+MTLO:
+		lo = u->rd;
+		NEXT();
+MULT:
+		wide = (int64_t) r[ u->rs ] * r[ u->rt ];
+		lo = (uint32_t) wide;
+		hi = (uint32_t)( wide >> 32 );
+		NEXT();
+MULTU:
+		wide = (uint64_t)(uint32_t) r[ u->rs ] * (uint32_t) r[ u->rt ];
+		lo = (uint32_t) wide;
+		hi = (uint32_t)( wide >> 32 );
+		NEXT();
+NOR:
+		SET( u->rd, ~( r[ u->rs ] | r[ u->rt ] ) );
+		NEXT();
+OR:
+		SET( u->rd, r[ u->rs ] | r[ u->rt ] );
+		NEXT();
+XOR:
+		SET( u->rd, r[ u->rs ] ^ r[ u->rt ] );
+		NEXT();
+SLL:
+		SET( u->rd, (uint32_t) r[ u->rs ] << u->shamt );
+		NEXT();
+SLLV:
+		SET( u->rd, (uint32_t) r[ u->rs ] << r[ u->rt ] );
+		NEXT();
+SRL:
+		SET( u->rd, (uint32_t) r[ u->rs ] >> u->shamt );
+		NEXT();
+SRLV:
+		SET( u->rd, (uint32_t) r[ u->rs ] >> r[ u->rt ] );
+		NEXT();
+SLT:
+		SET( u->rd, ( r[ u->rs ] < r[ u->rt ] ) ? 1 : 0 );
+		NEXT();
+SLTU:
+		SET( u->rd, ( (uint32_t) r[ u->rs ] < (uint32_t) r[ u->rt ] ) ? 1 : 0 );
+		NEXT();
+SRA:
+		SET( u->rd, r[ u->rs ] >> u->shamt );
+		NEXT();
+SUB:
+		SET( u->rd, (uint32_t) r[ u->rs ] - r[ u->rt ] );
+		NEXT();
+
+	//J-TYPE, with the target in immed
+J:
+		pc_ = u->immed;
+		goto chain;
+JAL:
+		r[31] = u->pc + 8;
+		pc_ = u->immed;
+		goto chain;
+
+	//I-TYPE
+ADDI:
+		SET( u->rt, (uint32_t) r[ u->rs ] + u->immed );
+		NEXT();
+ANDI:
+		SET( u->rt, r[ u->rs ] & u->immed );
+		NEXT();
+BEQ:
+		pc_ = ( r[ u->rt ] == r[ u->rs ] ) ? u->immed : u->pc + 4;
+		goto chain;
+NOP:
+		NEXT();
+BNE:
+		pc_ = ( r[ u->rt ] != r[ u->rs ] ) ? u->immed : u->pc + 4;
+		goto chain;
+LB:
+		SET( u->rt, (int8_t) mem->loadByte( r[ u->rs ] + u->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LBU:
+		SET( u->rt, mem->loadByte( r[ u->rs ] + u->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LH:
+		SET( u->rt, (int16_t) mem->loadHalfWord( r[ u->rs ] + u->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LHU:
+		SET( u->rt, mem->loadHalfWord( r[ u->rs ] + u->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LUI:
+		SET( u->rt, u->immed << 16 );
+		NEXT();
+LW:
+		SET( u->rt, mem->loadWord( r[ u->rs ] + u->immed ) );
+		CHECK_FAULT();
+		NEXT();
+ORI:
+		SET( u->rt, r[ u->rs ] | u->immed );
+		NEXT();
+SB:
+		addr = r[ u->rs ] + u->immed;
+		mem->storeByte( addr, r[ u->rt ] );
+		CHECK_FAULT();
+		addr &= ~3;
+		CHECK_TEXT();
+		NEXT();
+SLTI:
+		SET( u->rt, ( r[ u->rs ] < u->immed ) ? 1 : 0 );
+		NEXT();
+SLTIU:
+		SET( u->rt, ( (uint32_t) r[ u->rs ] < (uint32_t) u->immed ) ? 1 : 0 );
+		NEXT();
+SH:
+		addr = r[ u->rs ] + u->immed;
+		mem->storeHalfWord( addr, r[ u->rt ] );
+		CHECK_FAULT();
+		addr &= ~3;
+		CHECK_TEXT();
+		NEXT();
+SW:
+		addr = r[ u->rs ] + u->immed;
+		mem->storeWord( addr, r[ u->rt ] );
+		CHECK_FAULT();
+		CHECK_TEXT();
+		NEXT();
+XORI:
+		SET( u->rt, r[ u->rs ] ^ u->immed );
+		NEXT();
+
+	//micro-ops
+END:
+		pc_ = u->immed;
+		goto chain;
+LINK:
+		r[31] = u->immed;
+		NEXT();
+
+	} catch( ... ) {
+		if( !synced ) {
+			storeRegisters( r, hi, lo );
+			pc = ( u != NULL ) ? u->pc : pc_;
+		}
+		throw;
+	}
+
+done:
+	storeRegisters( r, hi, lo );
+	pc = pc_;
+	return budget - left;
+}
+
+block *blockProcessor::lookup( uint32_t pc )
+{
+	if( pc < startAddr || pc > endAddr || pc % 4 != 0 )
+		return NULL;
+
+	if( entries == NULL ) {
+		uint32_t words = ( endAddr - startAddr ) / 4 + 1;
+		entries = new block*[ words ];
+		for( uint32_t i=0; i<words; ++i )
+			entries[i] = NULL;
+		codePages.assign( ( endAddr >> PAGE_SHIFT ) - ( startAddr >> PAGE_SHIFT ) + 1, 0 );
+	}
+
+	block *&b = entries[ ( pc - startAddr ) >> 2 ];
+	if( b == NULL )
+		b = translate( pc );
+	return b;
+}
+
+block *blockProcessor::translatedAt( uint32_t pc ) const
+{
+	if( entries == NULL || pc < startAddr || pc > endAddr || pc % 4 != 0 )
+		return NULL;
+	return entries[ ( pc - startAddr ) >> 2 ];
+}
+
+/*
+ * Build the block starting at pc. Instructions whose
+ * result goes to r0 are left out, loads excepted, since
+ * they can still fault.
+ */
+block *blockProcessor::translate( uint32_t pc )
+{
+	block *b = new block;
+	b->start = pc;
+	b->length = 0;
+	b->firstPage = b->lastPage = pc >> PAGE_SHIFT;
+	b->fallPC = b->takenPC = 0;
+	b->indirect = false;
+	b->fall = b->taken = NULL;
+	b->hits = 0;
+	b->native = NULL;
+
+	uint32_t addr = pc;
+	bool ended = false;
+
+	while( !ended && b->length < maxBlock ) {
+
+		if( addr < startAddr || addr > endAddr || addr % 4 != 0 )
+			break;
+
+		//leave bad words to execute(), it raises the exception
+		uint32_t cmd;
+		try {
+			cmd = mem->loadWord( addr );
+		} catch( ... ) {
+			break;
+		}
+		if( mem->fault() != NO_FAULT ) {
+			mem->clearFault();
+			break;
+		}
+
+		decodedCmd d;
+		decode( cmd, d );
+		if( d.op == opUnknown || d.op == opBREAK )
+			break;
+
+		microOp u;
+		u.op = d.op;
+		u.rs = d.rs;
+		u.rt = d.rt;
+		u.rd = d.rd;
+		u.shamt = d.shamt;
+		u.immed = d.immed;
+		u.pc = addr;
+
+		++b->length;
+		u.after = b->length;		//instructions so far, turned around below
+		if( ( addr >> PAGE_SHIFT ) < b->firstPage )
+			b->firstPage = addr >> PAGE_SHIFT;
+		if( ( addr >> PAGE_SHIFT ) > b->lastPage )
+			b->lastPage = addr >> PAGE_SHIFT;
+
+		bool keep = true;
+		uint32_t target;
+
+		switch( d.op ) {
+			case( opBEQ ):
+			case( opBNE ):
+				u.immed = addr + ( d.immed << 2 );
+				b->takenPC = u.immed;
+				b->fallPC = addr + 4;
+				ended = true;
+				break;
+
+			case( opJ ):
+			case( opJAL ):
+				target = ( addr & 0xf0000000 ) | ( d.immed << 2 );
+				if( target >= startAddr && target <= endAddr && target != pc ) {
+					//keep translating at the target
+					if( d.op == opJAL ) {
+						u.op = opLINK;
+						u.immed = addr + 8;
+						b->ops.push_back( u );
+					}
+					addr = target;
+					continue;
+				}
+				u.immed = target;
+				b->takenPC = target;
+				ended = true;
+				break;
+
+			case( opJR ):
+			case( opJALR ):
+				b->indirect = true;
+				ended = true;
+				break;
+
+			case( opNOP ):
+				//the branches we treat as no-ops still end the block
+				u.op = opEND;
+				u.immed = addr + 4;
+				b->fallPC = addr + 4;
+				ended = true;
+				break;
+
+			case( opLB ): case( opLBU ): case( opLH ): case( opLHU ): case( opLW ):
+				if( u.rt == 0 )
+					u.rt = REG_NR;
+				break;
+
+			case( opADDI ): case( opANDI ): case( opORI ): case( opXORI ):
+			case( opSLTI ): case( opSLTIU ): case( opLUI ):
+				keep = ( u.rt != 0 );
+				break;
+
+			case( opADD ): case( opAND ): case( opNOR ): case( opOR ): case( opXOR ):
+			case( opSLL ): case( opSLLV ): case( opSRL ): case( opSRLV ): case( opSLT ):
+			case( opSLTU ): case( opSRA ): case( opSUB ): case( opMFHI ): case( opMFLO ):
+				keep = ( u.rd != 0 );
+				break;
+
+			default:
+				break;
+		}
+
+		if( keep )
+			b->ops.push_back( u );
+		addr += 4;
+	}
+
+	if( b->length == 0 ) {
+		delete b;
+		return NULL;
+	}
+
+	if( !ended ) {
+		microOp end;
+		end.op = opEND;
+		end.rs = end.rt = end.rd = end.shamt = 0;
+		end.immed = addr;
+		end.pc = addr;
+		end.after = b->length;
+		b->ops.push_back( end );
+		b->fallPC = addr;
+	}
+
+	for( uint32_t i=0; i<b->ops.size(); ++i )
+		b->ops[i].after = b->length - b->ops[i].after;
+
+	translated.push_back( b );
+	for( uint32_t p=b->firstPage; p<=b->lastPage; ++p )
+		++codePages[ p - ( startAddr >> PAGE_SHIFT ) ];
+
+	return b;
+}
+
+void blockProcessor::textWritten( uint32_t addr )
+{
+	simpleProcessor::textWritten( addr );
+	if( entries != NULL && addr >= startAddr && addr <= endAddr )
+		invalidatePage( addr >> PAGE_SHIFT );
+}
+
+/*
+ * Drop the blocks overlapping page. The links of the
+ * others are cleared too, they may point to dropped
+ * blocks, and get rebuilt as the blocks run.
+ */
+void blockProcessor::invalidatePage( uint32_t page )
+{
+	uint32_t first = startAddr >> PAGE_SHIFT;
+	if( codePages[ page - first ] == 0 )
+		return;
+
+	uint32_t kept = 0;
+	for( uint32_t i=0; i<translated.size(); ++i ) {
+		block *b = translated[i];
+		if( page >= b->firstPage && page <= b->lastPage ) {
+			for( uint32_t p=b->firstPage; p<=b->lastPage; ++p )
+				--codePages[ p - first ];
+			entries[ ( b->start - startAddr ) >> 2 ] = NULL;
+			delete b;
+		} else {
+			b->fall = b->taken = NULL;
+			translated[ kept++ ] = b;
+		}
+	}
+	translated.resize( kept );
+	invalidated = true;
+}
+
+void blockProcessor::flushBlocks()
+{
+	for( uint32_t i=0; i<translated.size(); ++i )
+		delete translated[i];
+	translated.clear();
+	codePages.clear();
+	delete[] entries;
+	entries = NULL;
+}
+
+void blockProcessor::setTextArea( uint32_t startAddr, uint32_t endAddr )
+{
+	flushBlocks();
+	simpleProcessor::setTextArea( startAddr, endAddr );
+}
+
+void blockProcessor::loadRegisters( int32_t *r, int32_t &hi, int32_t &lo ) const
+{
+	for( int i=0; i<REG_NR; ++i )
+		r[i] = reg->getReg( i );
+	r[ REG_NR ] = 0;
+	hi = reg->getHI();
+	lo = reg->getLO();
+}
+
+void blockProcessor::storeRegisters( const int32_t *r, int32_t hi, int32_t lo )
+{
+	for( int i=1; i<REG_NR; ++i )
+		reg->setReg( i, r[i] );
+	reg->setHI( hi );
+	reg->setLO( lo );
+}
@@ -0,0 +1,103 @@
+/*
+ * blockProcessor.h
+ * Functional MIPS model working on translated blocks.
+ * Straight line code up to a branch or jump is translated
+ * once into micro-ops. Blocks point to the blocks that
+ * followed them last time, so loops run from block to
+ * block without looking anything up.
+ */
+#ifndef __BLOCK_PROCESSOR_H__
+#define __BLOCK_PROCESSOR_H__
+
+#include <vector>
+#include "processor.h"
+
+//longest block, in instructions
+#define MAX_BLOCK	64
+
+//micro-ops past the decoded operations
+enum {
+	opEND = OP_COUNT,	//leave the block at immed
+	opLINK,			//JAL folded into a block, r31 = immed
+	MICRO_OP_COUNT
+};
+
+/*
+ * One instruction of a block. Branches and jumps keep
+ * their target in immed.
+ */
+struct microOp {
+	uint8_t op;
+	uint8_t rs, rt, rd, shamt;
+	uint8_t after;		//instructions of the block after this one
+	int32_t immed;
+	uint32_t pc;		//of the instruction, for exceptions
+};
+
+struct block {
+	uint32_t start;
+	uint32_t length;	//instructions, for the budget
+	uint32_t firstPage, lastPage;
+	std::vector<microOp> ops;
+
+	//chaining. fallPC is fixed, takenPC is the last target of an indirect jump
+	uint32_t fallPC, takenPC;
+	bool indirect;
+	block *fall, *taken;
+
+	//for the translator: times entered while cold, and the native code
+	uint32_t hits;
+	void *native;
+};
+
+class blockProcessor : public simpleProcessor {
+
+public:
+	//run until an exception
+	virtual void run();
+
+	//run at most budget instructions and return how many were executed
+	uint64_t run( uint64_t budget );
+
+	virtual void setTextArea( uint32_t startAddr, uint32_t endAddr );
+
+	//drop every translation
+	void flushBlocks();
+	uint32_t blocksTranslated() const { return translated.size(); }
+
+	blockProcessor() : simpleProcessor(), maxBlock( MAX_BLOCK ), invalidated( false ), entries( NULL ) {}
+	blockProcessor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) : simpleProcessor( mem, reg, startAddr, endAddr ), maxBlock( MAX_BLOCK ), invalidated( false ), entries( NULL ) {}
+	virtual ~blockProcessor() { flushBlocks(); }
+
+protected:
+	//block starting at pc, translated on first use. NULL if pc can not start one
+	block *lookup( uint32_t pc );
+	block *translate( uint32_t pc );
+
+	//block already translated at pc, or NULL
+	block *translatedAt( uint32_t pc ) const;
+
+	//stores into pages holding translated code drop the blocks there
+	virtual void textWritten( uint32_t addr );
+	virtual void invalidatePage( uint32_t page );
+
+	//longest block translate() builds, at most MAX_BLOCK
+	uint32_t maxBlock;
+	std::vector<block *> translated;
+
+	//set when a store dropped blocks
+	bool invalidated;
+
+private:
+	//block starting at every word of the text area
+	block **entries;
+
+	//blocks overlapping each page of the text area
+	std::vector<uint32_t> codePages;
+
+	void loadRegisters( int32_t *r, int32_t &hi, int32_t &lo ) const;
+	void storeRegisters( const int32_t *r, int32_t hi, int32_t lo );
+
+};
+
+#endif /* __BLOCK_PROCESSOR_H__ */
@@ -0,0 +1,272 @@
+/*
+ * branchPredictor.cpp
+ * the direction predictors, the branch target buffer
+ * and the return address stack.
+ */
+#include "branchPredictor.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+//no tag is that wide, so an empty entry never hits
+#define TAGE_EMPTY	0xffff
+
+static const unsigned tageHistory[ TAGE_TABLES ] = { 5, 11, 23, 47 };
+
+static inline void train( uint8_t &counter, bool taken )
+{
+	if( taken )
+		counter += ( counter < 3 );
+	else
+		counter -= ( counter > 0 );
+}
+
+static bool worse( const branchRecord &a, const branchRecord &b )
+{
+	return a.mispredicted > b.mispredicted;
+}
+
+void branchPredictor::printStats( unsigned worst )
+{
+	printf( "%s: %llu of %llu branches mispredicted (%.2f%%)\n", name(),
+		(unsigned long long) mispredicted, (unsigned long long) executed,
+		executed ? 100.0 * mispredicted / executed : 0.0 );
+
+	if( unrecorded != 0 )
+		printf( "  %llu resolutions aliased in the per branch table\n", (unsigned long long) unrecorded );
+
+	vector<branchRecord> sorted;
+	for( unsigned i=0; i<( 1U << BRANCH_RECORD_BITS ); ++i )
+		if( branches[i].mispredicted != 0 )
+			sorted.push_back( branches[i] );
+	worst = min( worst, (unsigned) sorted.size() );
+	partial_sort( sorted.begin(), sorted.begin() + worst, sorted.end(), worse );
+	for( unsigned i=0; i<worst; ++i )
+		printf( "  %08x: %llu of %llu\n", sorted[i].pc,
+			(unsigned long long) sorted[i].mispredicted, (unsigned long long) sorted[i].executed );
+}
+
+
+/***********
+ * bimodal *
+ ***********/
+
+bimodalPredictor::bimodalPredictor( unsigned bits )
+{
+	mask = ( 1U << bits ) - 1;
+	counters = new uint8_t[ 1U << bits ];
+	memset( counters, 1, 1U << bits );	//weakly not taken
+}
+
+bimodalPredictor::~bimodalPredictor()
+{
+	delete[] counters;
+}
+
+bool bimodalPredictor::predict( uint32_t pc, uint32_t )
+{
+	return counters[ ( pc >> 2 ) & mask ] >= 2;
+}
+
+void bimodalPredictor::update( uint32_t pc, bool taken, uint32_t )
+{
+	train( counters[ ( pc >> 2 ) & mask ], taken );
+}
+
+
+/**********
+ * gshare *
+ **********/
+
+gsharePredictor::gsharePredictor( unsigned bits )
+{
+	mask = ( 1U << bits ) - 1;
+	history = 0;
+	counters = new uint8_t[ 1U << bits ];
+	memset( counters, 1, 1U << bits );
+}
+
+gsharePredictor::~gsharePredictor()
+{
+	delete[] counters;
+}
+
+bool gsharePredictor::predict( uint32_t pc, uint32_t )
+{
+	return counters[ index( pc ) ] >= 2;
+}
+
+void gsharePredictor::update( uint32_t pc, bool taken, uint32_t )
+{
+	train( counters[ index( pc ) ], taken );
+	history = ( history << 1 ) | taken;
+}
+
+
+/********
+ * TAGE *
+ ********/
+
+tagePredictor::tagePredictor( unsigned baseBits, unsigned bits ) : bits( bits )
+{
+	baseMask = ( 1U << baseBits ) - 1;
+	base = new uint8_t[ 1U << baseBits ];
+	memset( base, 1, 1U << baseBits );
+
+	mask = ( 1U << bits ) - 1;
+	for( int t=0; t<TAGE_TABLES; ++t ) {
+		tables[t] = new tageEntry[ 1U << bits ];
+		for( uint32_t i=0; i<=mask; ++i ) {
+			tables[t][i].tag = TAGE_EMPTY;
+			tables[t][i].ctr = 0;
+			tables[t][i].u = 0;
+		}
+	}
+
+	history = 0;
+	updates = 0;
+}
+
+tagePredictor::~tagePredictor()
+{
+	delete[] base;
+	for( int t=0; t<TAGE_TABLES; ++t )
+		delete[] tables[t];
+}
+
+//the last len outcomes xored together width bits at a time
+uint32_t tagePredictor::fold( unsigned len, unsigned width ) const
+{
+	uint64_t h = history & ( ( 1ULL << len ) - 1 );
+	uint32_t folded = 0;
+	for( ; h != 0; h >>= width )
+		folded ^= h & ( ( 1U << width ) - 1 );
+	return folded;
+}
+
+void tagePredictor::lookup( uint32_t pc, uint32_t *idx, uint16_t *tag ) const
+{
+	uint32_t p = pc >> 2;
+	for( int t=0; t<TAGE_TABLES; ++t ) {
+		idx[t] = ( p ^ ( p >> bits ) ^ fold( tageHistory[t], bits ) ) & mask;
+		tag[t] = ( p ^ fold( tageHistory[t], TAGE_TAG_BITS ) ^ ( fold( tageHistory[t], TAGE_TAG_BITS - 1 ) << 1 ) )
+			& ( ( 1U << TAGE_TAG_BITS ) - 1 );
+	}
+}
+
+bool tagePredictor::predict( uint32_t pc, uint32_t )
+{
+	uint32_t idx[ TAGE_TABLES ];
+	uint16_t tag[ TAGE_TABLES ];
+	lookup( pc, idx, tag );
+
+	for( int t=TAGE_TABLES-1; t>=0; --t )
+		if( tables[t][ idx[t] ].tag == tag[t] )
+			return tables[t][ idx[t] ].ctr >= 0;
+	return base[ ( pc >> 2 ) & baseMask ] >= 2;
+}
+
+/*
+ * The provider is trained, and its useful bits when it
+ * and the alternate prediction disagree. A misprediction
+ * takes a free entry in a longer table, or makes those
+ * entries look less useful.
+ */
+void tagePredictor::update( uint32_t pc, bool taken, uint32_t )
+{
+	uint32_t idx[ TAGE_TABLES ];
+	uint16_t tag[ TAGE_TABLES ];
+	lookup( pc, idx, tag );
+
+	int provider = -1, alt = -1;
+	for( int t=TAGE_TABLES-1; t>=0 && alt < 0; --t )
+		if( tables[t][ idx[t] ].tag == tag[t] ) {
+			if( provider < 0 )
+				provider = t;
+			else
+				alt = t;
+		}
+
+	uint8_t &b = base[ ( pc >> 2 ) & baseMask ];
+	bool altPred = ( alt >= 0 ) ? tables[ alt ][ idx[ alt ] ].ctr >= 0 : b >= 2;
+	bool pred = altPred;
+
+	if( provider >= 0 ) {
+		tageEntry &e = tables[ provider ][ idx[ provider ] ];
+		pred = e.ctr >= 0;
+		if( pred != altPred ) {
+			if( pred == taken )
+				e.u += ( e.u < 3 );
+			else
+				e.u -= ( e.u > 0 );
+		}
+		if( taken )
+			e.ctr += ( e.ctr < 3 );
+		else
+			e.ctr -= ( e.ctr > -4 );
+	} else
+		train( b, taken );
+
+	if( pred != taken ) {
+		bool allocated = false;
+		for( int t=provider+1; t<TAGE_TABLES && !allocated; ++t ) {
+			tageEntry &e = tables[t][ idx[t] ];
+			if( e.u == 0 ) {
+				e.tag = tag[t];
+				e.ctr = taken ? 0 : -1;
+				allocated = true;
+			}
+		}
+		for( int t=provider+1; t<TAGE_TABLES && !allocated; ++t ) {
+			tageEntry &e = tables[t][ idx[t] ];
+			e.u -= ( e.u > 0 );
+		}
+	}
+
+	//age the useful bits now and then, so that old entries can go
+	if( ++updates == TAGE_U_RESET ) {
+		updates = 0;
+		for( int t=0; t<TAGE_TABLES; ++t )
+			for( uint32_t i=0; i<=mask; ++i )
+				tables[t][i].u >>= 1;
+	}
+
+	history = ( history << 1 ) | taken;
+}
+
+
+/*********************************
+ * targets, and return addresses *
+ *********************************/
+
+branchTargetBuffer::branchTargetBuffer( unsigned bits )
+{
+	mask = ( 1U << bits ) - 1;
+	entries = new btbEntry[ 1U << bits ];
+	for( uint32_t i=0; i<=mask; ++i ) {
+		entries[i].pc = 1;	//never the pc of an instruction
+		entries[i].target = 0;
+	}
+	hits = misses = 0;
+}
+
+branchTargetBuffer::~branchTargetBuffer()
+{
+	delete[] entries;
+}
+
+returnStack::returnStack( unsigned bits )
+{
+	mask = ( 1U << bits ) - 1;
+	stack = new uint32_t[ 1U << bits ];
+	memset( stack, 0, sizeof( uint32_t ) << bits );
+	head = 0;
+}
+
+returnStack::~returnStack()
+{
+	delete[] stack;
+}
@@ -0,0 +1,251 @@
+/*
+ * branchPredictor.h
+ * Branch prediction for the fetch stage of mipsPipelined.
+ * A direction predictor guesses whether a conditional
+ * branch is taken, a branch target buffer where taken
+ * branches and jumps go, and a return address stack where
+ * JR $31 goes. All tables are flat arrays with a power of
+ * two entries, indexed by masking.
+ *
+ * Predictors are trained when a branch is resolved. The
+ * global history is only shifted then too, which in a five
+ * stage pipe is before the next branch is predicted.
+ */
+
+#ifndef __BRANCH_PREDICTOR_H__
+#define __BRANCH_PREDICTOR_H__
+
+#include <stdint.h>
+#include <string.h>
+
+//entries of the per branch statistics, direct mapped by pc
+#define BRANCH_RECORD_BITS	12
+
+//how often one branch was resolved and mispredicted
+struct branchRecord {
+	uint32_t pc;
+	uint64_t executed;
+	uint64_t mispredicted;
+};
+
+
+class branchPredictor {
+
+public:
+	branchPredictor() : executed( 0 ), mispredicted( 0 ), unrecorded( 0 ) {
+		branches = new branchRecord[ 1U << BRANCH_RECORD_BITS ];
+		memset( branches, 0, sizeof( branchRecord ) << BRANCH_RECORD_BITS );
+	}
+	virtual ~branchPredictor() { delete[] branches; }
+
+	//direction of the branch at pc, whose target is given for BTFN
+	virtual bool predict( uint32_t pc, uint32_t target ) = 0;
+
+	//train with the outcome of the branch at pc
+	virtual void update( uint32_t pc, bool taken, uint32_t target ) = 0;
+
+	virtual const char *name() const = 0;
+
+	/*
+	 * Kept by the pipeline at resolution, for every branch
+	 * predicted. The first branch to use an entry keeps it,
+	 * the totals still count the ones aliasing it.
+	 */
+	void record( uint32_t pc, bool wrong ) {
+		branchRecord &r = branches[ ( pc >> 2 ) & ( ( 1U << BRANCH_RECORD_BITS ) - 1 ) ];
+		if( r.executed == 0 )
+			r.pc = pc;
+		if( r.pc == pc ) {
+			++r.executed;
+			r.mispredicted += wrong;
+		} else
+			++unrecorded;
+		++executed;
+		mispredicted += wrong;
+	}
+
+	uint64_t predictions() const { return executed; }
+	uint64_t mispredictions() const { return mispredicted; }
+
+	//the totals and the worst branches
+	void printStats( unsigned worst );
+
+private:
+	branchRecord *branches;
+	uint64_t executed;
+	uint64_t mispredicted;
+	uint64_t unrecorded;	//resolutions of branches aliasing a recorded one
+
+};
+
+//never taken, as fetch does without a predictor
+class staticPredictor : public branchPredictor {
+
+public:
+	bool predict( uint32_t, uint32_t ) { return false; }
+	void update( uint32_t, bool, uint32_t ) {}
+	const char *name() const { return "not taken"; }
+
+};
+
+//backward taken, forward not taken
+class btfnPredictor : public branchPredictor {
+
+public:
+	bool predict( uint32_t pc, uint32_t target ) { return target <= pc; }
+	void update( uint32_t, bool, uint32_t ) {}
+	const char *name() const { return "BTFN"; }
+
+};
+
+//two bit saturating counters indexed by the pc
+class bimodalPredictor : public branchPredictor {
+
+public:
+	bimodalPredictor( unsigned bits );
+	~bimodalPredictor();
+	bool predict( uint32_t pc, uint32_t target );
+	void update( uint32_t pc, bool taken, uint32_t target );
+	const char *name() const { return "bimodal"; }
+
+private:
+	uint8_t *counters;
+	uint32_t mask;
+
+};
+
+//two bit counters indexed by the pc xor the global history
+class gsharePredictor : public branchPredictor {
+
+public:
+	gsharePredictor( unsigned bits );
+	~gsharePredictor();
+	bool predict( uint32_t pc, uint32_t target );
+	void update( uint32_t pc, bool taken, uint32_t target );
+	const char *name() const { return "gshare"; }
+
+private:
+	uint8_t *counters;
+	uint32_t mask;
+	uint32_t history;
+
+	uint32_t index( uint32_t pc ) const { return ( ( pc >> 2 ) ^ history ) & mask; }
+
+};
+
+#define TAGE_TABLES	4
+#define TAGE_TAG_BITS	8
+#define TAGE_U_RESET	( 1U << 18 )	//updates between two agings of the useful bits
+
+struct tageEntry {
+	uint16_t tag;
+	int8_t ctr;		//-4..3, taken if not negative
+	uint8_t u;		//0..3, useful
+};
+
+/*
+ * A small TAGE: a bimodal base and TAGE_TABLES tagged tables
+ * looked up with geometrically longer global histories. The
+ * longest that hits predicts. On a misprediction an entry is
+ * allocated in a longer table.
+ */
+class tagePredictor : public branchPredictor {
+
+public:
+	//2^baseBits base counters and 2^bits entries in every tagged table
+	tagePredictor( unsigned baseBits, unsigned bits );
+	~tagePredictor();
+	bool predict( uint32_t pc, uint32_t target );
+	void update( uint32_t pc, bool taken, uint32_t target );
+	const char *name() const { return "TAGE"; }
+
+private:
+	uint8_t *base;
+	uint32_t baseMask;
+	tageEntry *tables[ TAGE_TABLES ];
+	unsigned bits;
+	uint32_t mask;
+	uint64_t history;
+	uint32_t updates;
+
+	//where pc is in every table, with the current history
+	void lookup( uint32_t pc, uint32_t *idx, uint16_t *tag ) const;
+	uint32_t fold( unsigned len, unsigned width ) const;
+
+};
+
+
+/*
+ * Direct mapped, tagged with the whole pc. Taken branches
+ * and jumps are entered when they are resolved.
+ */
+class branchTargetBuffer {
+
+public:
+	branchTargetBuffer( unsigned bits );
+	~branchTargetBuffer();
+
+	bool lookup( uint32_t pc, uint32_t &target ) {
+		btbEntry &e = entries[ ( pc >> 2 ) & mask ];
+		if( e.pc != pc ) {
+			++misses;
+			return false;
+		}
+		++hits;
+		target = e.target;
+		return true;
+	}
+
+	void update( uint32_t pc, uint32_t target ) {
+		btbEntry &e = entries[ ( pc >> 2 ) & mask ];
+		e.pc = pc;
+		e.target = target;
+	}
+
+	uint64_t hits;
+	uint64_t misses;
+
+private:
+	struct btbEntry {
+		uint32_t pc;
+		uint32_t target;
+	};
+
+	btbEntry *entries;
+	uint32_t mask;
+
+};
+
+/*
+ * Return addresses of JAL and JALR, popped by JR $31. A
+ * circular buffer, so too many calls lose the oldest ones.
+ * The pipeline puts back the top after a misprediction.
+ */
+class returnStack {
+
+public:
+	returnStack( unsigned bits );
+	~returnStack();
+
+	void push( uint32_t addr ) {
+		head = ( head + 1 ) & mask;
+		stack[ head ] = addr;
+	}
+
+	uint32_t pop() {
+		uint32_t addr = stack[ head ];
+		head = ( head - 1 ) & mask;
+		return addr;
+	}
+
+	uint32_t top() const { return head; }
+	void restore( uint32_t t ) { head = t; }
+
+private:
+	uint32_t *stack;
+	uint32_t mask;
+	uint32_t head;
+
+};
+
+#endif /* __BRANCH_PREDICTOR_H__ */
@@ -0,0 +1,879 @@
+/*
+ * jitProcessor.cpp
+ * x86-64 code generation for blocks. Each block starts
+ * with the budget check, then every micro-op works on
+ * the jitContext through rbx with eax, ecx and edx as
+ * scratch. Loads and stores call the static helpers,
+ * which catch what the Memory throws and leave it in
+ * ctx.status. Direct exits jump through a slot, which
+ * holds the epilogue until run() links it to the block
+ * at the target.
+ */
+
+#include <sys/mman.h>
+#include <x86intrin.h>
+#include <stddef.h>
+#include <sstream>
+#include "jitProcessor.h"
+
+using namespace std;
+
+//x86 registers
+#define EAX	0
+#define ECX	1
+#define EDX	2
+#define EBX	3
+#define ESI	6
+#define EDI	7
+
+//condition codes, second byte of the near jcc
+#define JB	0x82
+#define JE	0x84
+#define JNE	0x85
+#define JG	0x8f
+
+//offsets in jitContext
+#define R( n )		( (int32_t) ( offsetof( jitContext, r ) + 4 * ( n ) ) )
+#define HI_OFF		( (int32_t) offsetof( jitContext, hi ) )
+#define LO_OFF		( (int32_t) offsetof( jitContext, lo ) )
+#define PC_OFF		( (int32_t) offsetof( jitContext, pc ) )
+#define STATUS_OFF	( (int32_t) offsetof( jitContext, status ) )
+#define AFTER_OFF	( (int32_t) offsetof( jitContext, after ) )
+#define LEFT_OFF	( (int32_t) offsetof( jitContext, left ) )
+#define EXIT_OFF	( (int32_t) offsetof( jitContext, exit ) )
+
+typedef int (*trampoline)( jitContext *, void * );
+
+
+/*
+ * Writes x86-64 instructions at p. Memory operands
+ * are always [rbx+disp32].
+ */
+struct emitter {
+	uint8_t *p;
+
+	emitter( uint8_t *p ) : p( p ) {}
+
+	void b( uint8_t x ) { *p++ = x; }
+	void d( uint32_t x ) { memcpy( p, &x, 4 ); p += 4; }
+	void q( uint64_t x ) { memcpy( p, &x, 8 ); p += 8; }
+
+	//mov reg, [rbx+off]
+	void load( int reg, int32_t off ) { b( 0x8b ); b( 0x80 | ( reg << 3 ) | EBX ); d( off ); }
+	//mov [rbx+off], reg
+	void store( int32_t off, int reg ) { b( 0x89 ); b( 0x80 | ( reg << 3 ) | EBX ); d( off ); }
+	//mov dword [rbx+off], imm
+	void storeImm( int32_t off, uint32_t imm ) { b( 0xc7 ); b( 0x83 ); d( off ); d( imm ); }
+	//mov qword [rbx+off], 0
+	void clear64( int32_t off ) { b( 0x48 ); b( 0xc7 ); b( 0x83 ); d( off ); d( 0 ); }
+	//cmp reg, [rbx+off]
+	void cmpMem( int reg, int32_t off ) { b( 0x3b ); b( 0x80 | ( reg << 3 ) | EBX ); d( off ); }
+	//cmp dword [rbx+off], imm8
+	void cmpMemImm8( int32_t off, uint8_t imm ) { b( 0x83 ); b( 0xbb ); d( off ); b( imm ); }
+
+	//op dst, src, for add/sub/and/or/xor
+	void alu( uint8_t op, int dst, int src ) { b( op ); b( 0xc0 | ( src << 3 ) | dst ); }
+	//group 1 with imm32: 0 add, 1 or, 4 and, 6 xor, 7 cmp
+	void aluImm( int digit, int reg, uint32_t imm ) { b( 0x81 ); b( 0xc0 | ( digit << 3 ) | reg ); d( imm ); }
+	//group 2: 4 shl, 5 shr, 7 sar
+	void shiftImm( int digit, int reg, uint8_t n ) { b( 0xc1 ); b( 0xc0 | ( digit << 3 ) | reg ); b( n ); }
+	void shiftCl( int digit, int reg ) { b( 0xd3 ); b( 0xc0 | ( digit << 3 ) | reg ); }
+	//setcc al, movzx eax, al
+	void setcc( uint8_t cc ) { b( 0x0f ); b( cc ); b( 0xc0 ); b( 0x0f ); b( 0xb6 ); b( 0xc0 ); }
+
+	//mov rax, fn; call rax
+	void call( const void *fn ) { b( 0x48 ); b( 0xb8 ); q( (uint64_t) fn ); b( 0xff ); b( 0xd0 ); }
+
+	//jumps. The ones without a target return the rel32 to patch
+	uint8_t *jcc( uint8_t cc ) { b( 0x0f ); b( cc ); d( 0 ); return p - 4; }
+	void jccTo( uint8_t cc, uint8_t *to ) { patch( jcc( cc ), to ); }
+	void jmpTo( uint8_t *to ) { b( 0xe9 ); d( 0 ); patch( p - 4, to ); }
+
+	static void patch( uint8_t *rel, uint8_t *to )
+	{
+		int32_t off = to - ( rel + 4 );
+		memcpy( rel, &off, 4 );
+	}
+};
+
+
+jitProcessor::jitProcessor() : blockProcessor()
+{
+	init();
+}
+
+jitProcessor::jitProcessor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) : blockProcessor( mem, reg, startAddr, endAddr )
+{
+	init();
+}
+
+jitProcessor::~jitProcessor()
+{
+	munmap( cache, CODE_CACHE_SIZE );
+}
+
+/*
+ * Map the code cache and write the trampoline every
+ * entry goes through: save rbx, point it to the context,
+ * jump to the block. The three pushes keep the stack
+ * aligned for the helper calls.
+ */
+void jitProcessor::init()
+{
+	void *area = mmap( NULL, CODE_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( area == MAP_FAILED )
+		throw "jitProcessor: can not map the code cache";
+
+	cache = (uint8_t *) area;
+	cacheEnd = cache + CODE_CACHE_SIZE;
+
+	emitter e( cache );
+	e.b( 0x53 );					//push rbx
+	e.b( 0x55 );					//push rbp
+	e.b( 0x41 ); e.b( 0x54 );			//push r12
+	e.b( 0x48 ); e.b( 0x89 ); e.b( 0xfb );		//mov rbx, rdi
+	e.b( 0xff ); e.b( 0xe6 );			//jmp rsi
+
+	epilogue = e.p;
+	e.b( 0x41 ); e.b( 0x5c );			//pop r12
+	e.b( 0x5d );					//pop rbp
+	e.b( 0x5b );					//pop rbx
+	e.b( 0xc3 );					//ret
+
+	statusExit = e.p;
+	e.load( EAX, STATUS_OFF );
+	e.jmpTo( epilogue );
+
+	stackExit = e.p;
+	e.b( 0xb8 ); e.d( EXIT_STACK );			//mov eax, EXIT_STACK
+	e.jmpTo( epilogue );
+
+	codeStart = cacheTop = e.p;
+
+	ctx.exit = NULL;
+	ctx.self = this;
+	warmThreshold = WARM_THRESHOLD;
+	threshold = JIT_THRESHOLD;
+	clearStats();
+	verifying = false;
+	compiled = 0;
+	flushes = 0;
+}
+
+void jitProcessor::run()
+{
+	while( true )
+		run( ~(uint64_t)0 );
+}
+
+/*
+ * Cold code is interpreted, blocks below the threshold
+ * run in blockProcessor with the state moved back to
+ * the register file. Everything else runs natively.
+ */
+uint64_t jitProcessor::run( uint64_t budget )
+{
+	uint64_t left = budget;
+	uint64_t t;
+
+	loadContext();
+	ctx.exit = NULL;
+
+	while( left > 0 ) {
+
+		block *b = NULL;
+		if( warm( ctx.pc ) ) {
+			b = translatedAt( ctx.pc );
+			if( b == NULL ) {
+				t = __rdtsc();
+				b = lookup( ctx.pc );
+				tiers.translateCycles += __rdtsc() - t;
+			}
+		}
+
+		if( b == NULL || left < b->length ) {
+			left -= interpret( left );
+			ctx.exit = NULL;
+			continue;
+		}
+
+		if( b->native == NULL && ( verifying || ++b->hits >= threshold ) ) {
+			t = __rdtsc();
+			compile( b );
+			tiers.translateCycles += __rdtsc() - t;
+		}
+
+		t = __rdtsc();
+
+		if( b->native == NULL ) {
+			storeContext();
+			uint64_t n = blockProcessor::run( b->length );
+			loadContext();
+			ctx.exit = NULL;
+			left -= n;
+			tiers.cycles[ TIER_BLOCK ] += __rdtsc() - t;
+			tiers.instructions[ TIER_BLOCK ] += n;
+			continue;
+		}
+
+		//the previous block jumped here through a slot, link it. Verification runs one block at a time
+		if( ctx.exit != NULL && !verifying )
+			*ctx.exit = b->native;
+
+		ctx.left = left;
+		int status = verifying ? verify( b ) : enter( b->native );
+
+		if( status == EXIT_TEXT ) {
+			ctx.left += ctx.after;
+			ctx.pc += 4;
+			ctx.exit = NULL;
+		}
+		tiers.cycles[ TIER_NATIVE ] += __rdtsc() - t;
+		tiers.instructions[ TIER_NATIVE ] += left - ctx.left;
+		left = ctx.left;
+
+		if( status != EXIT_NORMAL && status != EXIT_TEXT )
+			raise( status );
+	}
+
+	storeContext();
+	return budget - left;
+}
+
+bool jitProcessor::warm( uint32_t pc )
+{
+	if( pc < startAddr || pc > endAddr || pc % 4 != 0 )
+		return false;
+	if( heat.empty() )
+		heat.assign( ( endAddr - startAddr ) / 4 + 1, 0 );
+
+	uint32_t &h = heat[ ( pc - startAddr ) >> 2 ];
+	if( h >= warmThreshold )
+		return true;
+	return ++h >= warmThreshold;
+}
+
+/*
+ * Only the targets of branches and jumps are counted,
+ * they are where blocks start.
+ */
+uint64_t jitProcessor::interpret( uint64_t budget )
+{
+	uint64_t n = 0;
+	uint64_t t = __rdtsc();
+
+	storeContext();
+	do {
+		uint32_t from = pc;
+		execute();
+		++n;
+		if( pc != from + 4 && warm( pc ) )
+			break;
+	} while( n < budget );
+	loadContext();
+
+	tiers.cycles[ TIER_INTERPRETER ] += __rdtsc() - t;
+	tiers.instructions[ TIER_INTERPRETER ] += n;
+	return n;
+}
+
+void jitProcessor::clearStats()
+{
+	for( int i=0; i<TIER_COUNT; ++i )
+		tiers.cycles[i] = tiers.instructions[i] = 0;
+	tiers.translateCycles = 0;
+}
+
+int jitProcessor::enter( void *native )
+{
+	ctx.status = EXIT_NORMAL;
+	return ( (trampoline) cache )( &ctx, native );
+}
+
+//leave the state where simpleProcessor would have, and throw
+void jitProcessor::raise( int status )
+{
+	ctx.exit = NULL;
+	storeContext();
+
+	switch( status ) {
+		case( EXIT_EXCEPTION ):
+			rethrow_exception( error );
+		case( EXIT_FAULT ):
+			memoryFault();
+		case( EXIT_STACK ):
+			throw "Not valid address for stack pointer";
+	}
+}
+
+void jitProcessor::loadContext()
+{
+	for( int i=0; i<REG_NR; ++i )
+		ctx.r[i] = reg->getReg( i );
+	ctx.r[ REG_NR ] = 0;
+	ctx.hi = reg->getHI();
+	ctx.lo = reg->getLO();
+	ctx.pc = pc;
+}
+
+void jitProcessor::storeContext()
+{
+	for( int i=1; i<REG_NR; ++i )
+		reg->setReg( i, ctx.r[i] );
+	reg->setHI( ctx.hi );
+	reg->setLO( ctx.lo );
+	pc = ctx.pc;
+}
+
+
+/*
+ * Code generation
+ */
+
+//set the register dst from eax, with the check RegisterFile does for sp
+static void setFromEAX( emitter &e, int dst, uint32_t pc, uint8_t *stackExit )
+{
+	if( dst == 29 ) {
+		e.storeImm( PC_OFF, pc );
+		e.aluImm( 7, EAX, STACK_MAX );
+		e.jccTo( JG, stackExit );
+	}
+	e.store( R( dst ), EAX );
+}
+
+void jitProcessor::compile( block *b )
+{
+	if( cacheEnd - cacheTop < (ptrdiff_t) MAX_NATIVE_BLOCK )
+		flushCode();
+
+	emitter e( cacheTop );
+
+	//rel32 fields pointing at exit slots, and the slot each wants
+	vector<uint8_t *> slotRefs;
+	vector<uint32_t> slotOf;
+	uint32_t exits = 0;
+
+	//direct exit to target through a new slot
+	#define DIRECT_EXIT( target ) do {					\
+		e.storeImm( PC_OFF, ( target ) );				\
+		e.b( 0x48 ); e.b( 0x8d ); e.b( 0x05 ); e.d( 0 );	/* lea rax, [rip+slot] */	\
+		slotRefs.push_back( e.p - 4 ); slotOf.push_back( exits );	\
+		e.b( 0x48 ); e.b( 0x89 ); e.b( 0x83 ); e.d( EXIT_OFF );	/* mov [rbx+exit], rax */	\
+		e.alu( 0x31, EAX, EAX );					\
+		e.b( 0xff ); e.b( 0x25 ); e.d( 0 );			/* jmp [rip+slot] */	\
+		slotRefs.push_back( e.p - 4 ); slotOf.push_back( exits );	\
+		++exits;							\
+	} while( 0 )
+
+	//indirect exit, pc from eax, never linked
+	#define INDIRECT_EXIT() do {						\
+		e.store( PC_OFF, EAX );						\
+		e.clear64( EXIT_OFF );						\
+		e.alu( 0x31, EAX, EAX );					\
+		e.jmpTo( epilogue );						\
+	} while( 0 )
+
+	//budget
+	e.b( 0x48 ); e.b( 0x81 ); e.b( 0xbb ); e.d( LEFT_OFF ); e.d( b->length );	//cmp qword [rbx+left], length
+	uint8_t *noBudget = e.jcc( JB );
+	e.b( 0x48 ); e.b( 0x81 ); e.b( 0xab ); e.d( LEFT_OFF ); e.d( b->length );	//sub qword [rbx+left], length
+
+	for( uint32_t i=0; i<b->ops.size(); ++i ) {
+		const microOp &u = b->ops[i];
+		uint8_t *rel;
+		const void *helper = NULL;
+
+		switch( u.op ) {
+
+			//R-TYPE
+			case( opADD ): case( opSUB ): case( opAND ): case( opOR ): case( opXOR ): case( opNOR ):
+				e.load( EAX, R( u.rs ) );
+				e.load( ECX, R( u.rt ) );
+				e.alu( u.op == opADD ? 0x01 : u.op == opSUB ? 0x29 : u.op == opAND ? 0x21 : u.op == opXOR ? 0x31 : 0x09, EAX, ECX );
+				if( u.op == opNOR ) {
+					e.b( 0xf7 ); e.b( 0xd0 );		//not eax
+				}
+				setFromEAX( e, u.rd, u.pc, stackExit );
+				break;
+
+			case( opSLL ): case( opSRL ): case( opSRA ):
+				e.load( EAX, R( u.rs ) );
+				e.shiftImm( u.op == opSLL ? 4 : u.op == opSRL ? 5 : 7, EAX, u.shamt );
+				setFromEAX( e, u.rd, u.pc, stackExit );
+				break;
+
+			case( opSLLV ): case( opSRLV ):
+				e.load( EAX, R( u.rs ) );
+				e.load( ECX, R( u.rt ) );
+				e.shiftCl( u.op == opSLLV ? 4 : 5, EAX );
+				setFromEAX( e, u.rd, u.pc, stackExit );
+				break;
+
+			case( opSLT ): case( opSLTU ):
+				e.load( EAX, R( u.rs ) );
+				e.cmpMem( EAX, R( u.rt ) );
+				e.setcc( u.op == opSLT ? 0x9c : 0x92 );	//setl / setb
+				setFromEAX( e, u.rd, u.pc, stackExit );
+				break;
+
+			case( opMFHI ): case( opMFLO ):
+				e.load( EAX, u.op == opMFHI ? HI_OFF : LO_OFF );
+				setFromEAX( e, u.rd, u.pc, stackExit );
+				break;
+
+			case( opMTHI ):
+				e.storeImm( HI_OFF, u.rd );
+				break;
+			case( opMTLO ):
+				e.storeImm( LO_OFF, u.rd );
+				break;
+
+			case( opMULT ): case( opMULTU ):
+				e.load( EAX, R( u.rs ) );
+				e.load( ECX, R( u.rt ) );
+				e.b( 0xf7 ); e.b( u.op == opMULT ? 0xe9 : 0xe1 );	//imul ecx / mul ecx, into edx:eax
+				e.store( LO_OFF, EAX );
+				e.store( HI_OFF, EDX );
+				break;
+
+			//by 0 and INT_MIN / -1 leave HI and LO alone, as in simpleProcessor
+			case( opDIV ): case( opDIVU ): {
+				e.load( EAX, R( u.rs ) );
+				e.load( ECX, R( u.rt ) );
+				e.alu( 0x85, ECX, ECX );			//test ecx, ecx
+				uint8_t *byZero = e.jcc( JE ), *overflows = NULL;
+				if( u.op == opDIV ) {
+					e.aluImm( 7, ECX, 0xffffffff );
+					uint8_t *divides = e.jcc( JNE );
+					e.aluImm( 7, EAX, 0x80000000 );
+					overflows = e.jcc( JE );
+					emitter::patch( divides, e.p );
+					e.b( 0x99 );				//cdq
+					e.b( 0xf7 ); e.b( 0xf9 );		//idiv ecx
+				} else {
+					e.alu( 0x31, EDX, EDX );
+					e.b( 0xf7 ); e.b( 0xf1 );		//div ecx
+				}
+				e.store( LO_OFF, EAX );
+				e.store( HI_OFF, EDX );
+				emitter::patch( byZero, e.p );
+				if( overflows != NULL )
+					emitter::patch( overflows, e.p );
+				break;
+			}
+
+			case( opJR ):
+				e.load( EAX, R( u.rs ) );
+				INDIRECT_EXIT();
+				break;
+			case( opJALR ):
+				e.load( EAX, R( u.rs ) );
+				e.storeImm( R( 31 ), u.pc + 4 );
+				INDIRECT_EXIT();
+				break;
+
+			//J-TYPE and block ends
+			case( opJ ): case( opEND ):
+				DIRECT_EXIT( u.immed );
+				break;
+			case( opJAL ):
+				e.storeImm( R( 31 ), u.pc + 8 );
+				DIRECT_EXIT( u.immed );
+				break;
+			case( opLINK ):
+				e.storeImm( R( 31 ), u.immed );
+				break;
+
+			//I-TYPE
+			case( opADDI ): case( opANDI ): case( opORI ): case( opXORI ):
+				e.load( EAX, R( u.rs ) );
+				e.aluImm( u.op == opADDI ? 0 : u.op == opANDI ? 4 : u.op == opORI ? 1 : 6, EAX, u.immed );
+				setFromEAX( e, u.rt, u.pc, stackExit );
+				break;
+
+			case( opSLTI ): case( opSLTIU ):
+				e.load( EAX, R( u.rs ) );
+				e.aluImm( 7, EAX, u.immed );
+				e.setcc( u.op == opSLTI ? 0x9c : 0x92 );
+				setFromEAX( e, u.rt, u.pc, stackExit );
+				break;
+
+			case( opLUI ):
+				e.b( 0xb8 ); e.d( u.immed << 16 );		//mov eax, imm
+				setFromEAX( e, u.rt, u.pc, stackExit );
+				break;
+
+			case( opBEQ ): case( opBNE ):
+				e.load( EAX, R( u.rs ) );
+				e.cmpMem( EAX, R( u.rt ) );
+				rel = e.jcc( u.op == opBEQ ? JNE : JE );
+				DIRECT_EXIT( u.immed );
+				emitter::patch( rel, e.p );
+				DIRECT_EXIT( u.pc + 4 );
+				break;
+
+			case( opNOP ):
+				break;
+
+			/*
+			 * Loads write the register even when the Memory
+			 * left a fault, like simpleProcessor, but not when
+			 * it threw.
+			 */
+			case( opLW ): case( opLH ): case( opLHU ): case( opLB ): case( opLBU ):
+				if( u.op == opLW )
+					helper = (const void *) &jitProcessor::loadWord;
+				else if( u.op == opLH || u.op == opLHU )
+					helper = (const void *) &jitProcessor::loadHalfWord;
+				else
+					helper = (const void *) &jitProcessor::loadByte;
+
+				e.storeImm( PC_OFF, u.pc );
+				e.b( 0x48 ); e.b( 0x89 ); e.b( 0xdf );		//mov rdi, rbx
+				e.load( ESI, R( u.rs ) );
+				e.aluImm( 0, ESI, u.immed );
+				e.call( helper );
+				e.cmpMemImm8( STATUS_OFF, EXIT_EXCEPTION );
+				e.jccTo( JE, statusExit );
+				if( u.op == opLB ) {
+					e.b( 0x0f ); e.b( 0xbe ); e.b( 0xc0 );	//movsx eax, al
+				} else if( u.op == opLH ) {
+					e.b( 0x0f ); e.b( 0xbf ); e.b( 0xc0 );	//movsx eax, ax
+				}
+				setFromEAX( e, u.rt, u.pc, stackExit );
+				e.cmpMemImm8( STATUS_OFF, 0 );
+				e.jccTo( JNE, statusExit );
+				break;
+
+			case( opSW ): case( opSH ): case( opSB ):
+				if( u.op == opSW )
+					helper = (const void *) &jitProcessor::storeWord;
+				else if( u.op == opSH )
+					helper = (const void *) &jitProcessor::storeHalfWord;
+				else
+					helper = (const void *) &jitProcessor::storeByte;
+
+				e.storeImm( PC_OFF, u.pc );
+				e.storeImm( AFTER_OFF, u.after );
+				e.b( 0x48 ); e.b( 0x89 ); e.b( 0xdf );		//mov rdi, rbx
+				e.load( ESI, R( u.rs ) );
+				e.aluImm( 0, ESI, u.immed );
+				e.load( EDX, R( u.rt ) );
+				e.call( helper );
+				e.cmpMemImm8( STATUS_OFF, 0 );
+				e.jccTo( JNE, statusExit );
+				break;
+
+			default:
+				throw "jitProcessor: micro-op without translation";
+		}
+	}
+
+	//not enough budget for the block, run() takes it from the start
+	emitter::patch( noBudget, e.p );
+	e.storeImm( PC_OFF, b->start );
+	e.clear64( EXIT_OFF );
+	e.alu( 0x31, EAX, EAX );
+	e.jmpTo( epilogue );
+
+	#undef DIRECT_EXIT
+	#undef INDIRECT_EXIT
+
+	//the slots, all going to the epilogue
+	while( (uintptr_t) e.p % 8 != 0 )
+		e.b( 0xcc );
+	void **slot = (void **) e.p;
+	for( uint32_t i=0; i<exits; ++i ) {
+		slot[i] = epilogue;
+		slots.push_back( &slot[i] );
+	}
+	for( uint32_t i=0; i<slotRefs.size(); ++i )
+		emitter::patch( slotRefs[i], (uint8_t *) &slot[ slotOf[i] ] );
+	e.p = (uint8_t *) ( slot + exits );
+
+	b->native = cacheTop;
+	cacheTop = e.p;
+	++compiled;
+}
+
+/*
+ * Start over with an empty cache. Blocks stay, they go
+ * native again once they are hot.
+ */
+void jitProcessor::flushCode()
+{
+	for( uint32_t i=0; i<translated.size(); ++i ) {
+		translated[i]->native = NULL;
+		translated[i]->hits = 0;
+	}
+	slots.clear();
+	cacheTop = codeStart;
+	ctx.exit = NULL;
+	++flushes;
+}
+
+//dropped blocks may be the target of a slot, unlink everything
+void jitProcessor::invalidatePage( uint32_t page )
+{
+	blockProcessor::invalidatePage( page );
+	if( invalidated ) {
+		for( uint32_t i=0; i<slots.size(); ++i )
+			*slots[i] = epilogue;
+		ctx.exit = NULL;
+	}
+}
+
+void jitProcessor::setTextArea( uint32_t startAddr, uint32_t endAddr )
+{
+	flushCode();
+	heat.clear();
+	blockProcessor::setTextArea( startAddr, endAddr );
+}
+
+void jitProcessor::setVerify( bool on )
+{
+	verifying = on;
+	maxBlock = on ? 1 : MAX_BLOCK;
+	flushCode();
+	flushBlocks();
+}
+
+
+/*
+ * Helpers called by native code. What the Memory throws
+ * is kept for raise(), a pending fault is only reported.
+ */
+uint32_t jitProcessor::loadWord( jitContext *ctx, uint32_t addr )
+{
+	jitProcessor *self = ctx->self;
+	try {
+		uint32_t val = self->mem->loadWord( addr );
+		if( self->mem->fault() != NO_FAULT )
+			ctx->status = EXIT_FAULT;
+		return val;
+	} catch( ... ) {
+		self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return 0;
+	}
+}
+
+uint32_t jitProcessor::loadHalfWord( jitContext *ctx, uint32_t addr )
+{
+	jitProcessor *self = ctx->self;
+	try {
+		uint32_t val = self->mem->loadHalfWord( addr );
+		if( self->mem->fault() != NO_FAULT )
+			ctx->status = EXIT_FAULT;
+		return val;
+	} catch( ... ) {
+		self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return 0;
+	}
+}
+
+uint32_t jitProcessor::loadByte( jitContext *ctx, uint32_t addr )
+{
+	jitProcessor *self = ctx->self;
+	try {
+		uint32_t val = self->mem->loadByte( addr );
+		if( self->mem->fault() != NO_FAULT )
+			ctx->status = EXIT_FAULT;
+		return val;
+	} catch( ... ) {
+		self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return 0;
+	}
+}
+
+void jitProcessor::storeWord( jitContext *ctx, uint32_t addr, uint32_t val )
+{
+	try {
+		ctx->self->mem->storeWord( addr, val );
+	} catch( ... ) {
+		ctx->self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return;
+	}
+	stored( ctx, addr );
+}
+
+void jitProcessor::storeHalfWord( jitContext *ctx, uint32_t addr, uint32_t val )
+{
+	try {
+		ctx->self->mem->storeHalfWord( addr, val );
+	} catch( ... ) {
+		ctx->self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return;
+	}
+	stored( ctx, addr & ~3 );
+}
+
+void jitProcessor::storeByte( jitContext *ctx, uint32_t addr, uint32_t val )
+{
+	try {
+		ctx->self->mem->storeByte( addr, val );
+	} catch( ... ) {
+		ctx->self->error = current_exception();
+		ctx->status = EXIT_EXCEPTION;
+		return;
+	}
+	stored( ctx, addr & ~3 );
+}
+
+//after a store: drop code it overwrote, then report faults before that
+void jitProcessor::stored( jitContext *ctx, uint32_t addr )
+{
+	jitProcessor *self = ctx->self;
+
+	if( addr >= self->startAddr && addr <= self->endAddr )
+		self->textWritten( addr );
+
+	if( self->mem->fault() != NO_FAULT )
+		ctx->status = EXIT_FAULT;
+	else if( self->invalidated )
+		ctx->status = EXIT_TEXT;
+	self->invalidated = false;
+}
+
+
+/*
+ * Verification
+ */
+
+/*
+ * Memory in front of the real one while verifying.
+ * Stores are logged with the value they replaced, so
+ * that the interpreter's can be undone before the
+ * native code runs, and the two logs compared.
+ */
+class journalMemory : public Memory {
+
+public:
+	struct entry {
+		uint32_t addr;
+		uint32_t size;
+		uint32_t old, val;
+
+		bool operator==( const entry &o ) const { return addr == o.addr && size == o.size && val == o.val; }
+	};
+
+	vector<entry> log;
+
+	journalMemory( Memory *inner ) : inner( inner ) {}
+
+	uint32_t loadWord( uint32_t addr ) { uint32_t v = inner->loadWord( addr ); mirror(); return v; }
+	uint16_t loadHalfWord( uint32_t addr ) { uint16_t v = inner->loadHalfWord( addr ); mirror(); return v; }
+	uint8_t loadByte( uint32_t addr ) { uint8_t v = inner->loadByte( addr ); mirror(); return v; }
+
+	void storeWord( uint32_t addr, uint32_t val ) { record( addr, 4, val ); inner->storeWord( addr, val ); mirror(); }
+	void storeHalfWord( uint32_t addr, uint16_t val ) { record( addr, 2, val ); inner->storeHalfWord( addr, val ); mirror(); }
+	void storeByte( uint32_t addr, uint8_t val ) { record( addr, 1, val ); inner->storeByte( addr, val ); mirror(); }
+
+	void clearFault() { inner->clearFault(); mirror(); }
+
+	void undo()
+	{
+		for( int i=log.size()-1; i>=0; --i ) {
+			if( log[i].size == 4 )
+				inner->storeWord( log[i].addr, log[i].old );
+			else if( log[i].size == 2 )
+				inner->storeHalfWord( log[i].addr, log[i].old );
+			else
+				inner->storeByte( log[i].addr, log[i].old );
+		}
+		log.clear();
+	}
+
+private:
+	Memory *inner;
+
+	void mirror() { pending = inner->fault(); badAddr = inner->faultAddr(); }
+
+	//stores the old value can not be read for fail themselves, and change nothing
+	void record( uint32_t addr, uint32_t size, uint32_t val )
+	{
+		entry en = { addr, size, 0, val };
+		try {
+			en.old = ( size == 4 ) ? inner->loadWord( addr ) : ( size == 2 ) ? inner->loadHalfWord( addr ) : inner->loadByte( addr );
+		} catch( ... ) {
+			return;
+		}
+		if( inner->fault() != NO_FAULT ) {
+			inner->clearFault();
+			return;
+		}
+		log.push_back( en );
+	}
+};
+
+/*
+ * Run the one instruction of b in simpleProcessor, undo
+ * it, run it natively from the same state and compare.
+ * Returns the native exit status.
+ */
+int jitProcessor::verify( block *b )
+{
+	void *native = b->native;	//the interpreter may drop b
+	jitContext before = ctx;
+	journalMemory journal( mem );
+	Memory *real = mem;
+
+	storeContext();
+	mem = &journal;
+	bool threw = false;
+	try {
+		execute();
+	} catch( ... ) {
+		threw = true;
+	}
+	invalidated = false;
+
+	jitContext expect = before;
+	for( int i=0; i<REG_NR; ++i )
+		expect.r[i] = reg->getReg( i );
+	expect.hi = reg->getHI();
+	expect.lo = reg->getLO();
+	expect.pc = pc;
+	vector<journalMemory::entry> stores = journal.log;
+	journal.undo();
+
+	ctx = before;
+	int status = enter( native );
+	mem = real;
+
+	bool nativeThrew = ( status != EXIT_NORMAL && status != EXIT_TEXT );
+	uint32_t nextPC = ( status == EXIT_TEXT ) ? ctx.pc + 4 : ctx.pc;
+
+	stringstream ex;
+	ex.setf( ios::hex, ios::basefield );
+	ex.setf( ios::showbase );
+
+	if( threw != nativeThrew )
+		ex << "exception " << ( threw ? "only in the interpreter" : "only in native code" );
+	else if( nextPC != expect.pc )
+		ex << "pc " << nextPC << ", expected " << expect.pc;
+	else if( ctx.hi != expect.hi || ctx.lo != expect.lo )
+		ex << "HI/LO " << ctx.hi << "/" << ctx.lo << ", expected " << expect.hi << "/" << expect.lo;
+	else if( journal.log != stores )
+		ex << "stores differ";
+	else {
+		for( int i=1; i<REG_NR; ++i )
+			if( ctx.r[i] != expect.r[i] ) {
+				ex << "r" << dec << i << hex << " = " << ctx.r[i] << ", expected " << expect.r[i];
+				break;
+			}
+	}
+
+	if( !ex.str().empty() ) {
+		ctx = expect;
+		storeContext();
+		ex << " (jit verification at pc " << before.pc << ")";
+		throw ex.str();
+	}
+
+	return status;
+}
@@ -0,0 +1,161 @@
+/*
+ * jitProcessor.h
+ * Translates hot blocks of blockProcessor to x86-64
+ * code. The guest registers live in a jitContext, which
+ * the generated code reaches through rbx. Loads and
+ * stores call back into the Memory.
+ * Code moves up three tiers: it is interpreted until
+ * its entry point is warm, runs as a translated block
+ * until the block is hot, then natively.
+ */
+#ifndef __JIT_PROCESSOR_H__
+#define __JIT_PROCESSOR_H__
+
+#include <exception>
+#include "blockProcessor.h"
+
+//size of the executable code cache
+#define CODE_CACHE_SIZE	( 16U << 20 )
+
+//room a block may take at most, the cache is flushed below it
+#define MAX_NATIVE_BLOCK	( 16U << 10 )
+
+//entries into a pc, while interpreted, before a block is translated there
+#define WARM_THRESHOLD	4
+
+//times a block runs in blockProcessor before it is compiled
+#define JIT_THRESHOLD	16
+
+class jitProcessor;
+
+//how native code returned
+typedef enum {
+	EXIT_NORMAL = 0,	//at pc, through the exit slot in exit
+	EXIT_EXCEPTION = 1,	//the Memory threw, error holds it
+	EXIT_FAULT = 2,		//the Memory left a fault pending
+	EXIT_STACK = 3,		//bad value for the stack pointer
+	EXIT_TEXT = 4		//a store dropped translated code
+} jitExit;
+
+typedef enum {
+	TIER_INTERPRETER = 0,	//simpleProcessor::execute()
+	TIER_BLOCK,		//blockProcessor
+	TIER_NATIVE,		//compiled blocks
+	TIER_COUNT
+} tier;
+
+//where the time went, in rdtsc ticks
+struct tierStats {
+	uint64_t cycles[ TIER_COUNT ];
+	uint64_t instructions[ TIER_COUNT ];
+	uint64_t translateCycles;	//building blocks and native code
+};
+
+/*
+ * State of the guest while native code runs.
+ * r[REG_NR] takes the loads into r0.
+ */
+struct jitContext {
+	int32_t r[ REG_NR + 1 ];
+	int32_t hi, lo;
+	uint32_t pc;		//next pc, or pc of the instruction that failed
+	uint32_t status;	//jitExit, set by the memory helpers
+	uint32_t after;		//instructions left in the block after the current store
+	uint64_t left;		//budget
+	void **exit;		//slot of the exit taken, so it can be linked
+	jitProcessor *self;
+};
+
+class jitProcessor : public blockProcessor {
+
+public:
+	//run until an exception
+	virtual void run();
+
+	//run at most budget instructions and return how many were executed
+	uint64_t run( uint64_t budget );
+
+	virtual void setTextArea( uint32_t startAddr, uint32_t endAddr );
+
+	/*
+	 * Verification: every instruction is translated on its
+	 * own and run both by simpleProcessor and natively from
+	 * the same state. Registers, pc and the stores made
+	 * must agree, or run() throws.
+	 */
+	void setVerify( bool on );
+
+	//entries needed to leave the interpreter, 0 translates everything at once
+	void setWarmThreshold( uint32_t entries ) { warmThreshold = entries; }
+	void setThreshold( uint32_t hits ) { threshold = hits; }
+
+	const tierStats &stats() const { return tiers; }
+	void clearStats();
+	uint32_t blocksCompiled() const { return compiled; }
+	uint32_t cacheFlushes() const { return flushes; }
+
+	jitProcessor();
+	jitProcessor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr );
+	virtual ~jitProcessor();
+
+protected:
+	virtual void invalidatePage( uint32_t page );
+
+	//translate b, flushing the code cache if it is full
+	void compile( block *b );
+	void flushCode();
+
+	//run native code for b, from ctx
+	int enter( void *native );
+	void raise( int status );
+
+	//count an entry into pc, true once it should run in a block
+	bool warm( uint32_t pc );
+
+	//run execute() until control reaches a warm pc, at most budget instructions
+	uint64_t interpret( uint64_t budget );
+
+private:
+	jitContext ctx;
+
+	//what the Memory threw, for EXIT_EXCEPTION
+	std::exception_ptr error;
+
+	uint8_t *cache;		//code cache, the entry trampoline first
+	uint8_t *cacheEnd;
+	uint8_t *codeStart;	//first byte after the trampoline
+	uint8_t *cacheTop;	//next free byte
+	uint8_t *epilogue;	//returns eax to the caller of the trampoline
+	uint8_t *statusExit;	//returns ctx.status
+	uint8_t *stackExit;	//returns EXIT_STACK
+
+	//every exit slot in the cache, reset to the epilogue to unlink
+	std::vector<void **> slots;
+
+	//entries into every word of the text area, while interpreted
+	std::vector<uint32_t> heat;
+
+	uint32_t warmThreshold;
+	uint32_t threshold;
+	tierStats tiers;
+	bool verifying;
+	uint32_t compiled;
+	uint32_t flushes;
+
+	void init();
+	void loadContext();
+	void storeContext();
+	int verify( block *b );
+
+	//called from native code
+	static uint32_t loadWord( jitContext *ctx, uint32_t addr );
+	static uint32_t loadHalfWord( jitContext *ctx, uint32_t addr );
+	static uint32_t loadByte( jitContext *ctx, uint32_t addr );
+	static void storeWord( jitContext *ctx, uint32_t addr, uint32_t val );
+	static void storeHalfWord( jitContext *ctx, uint32_t addr, uint32_t val );
+	static void storeByte( jitContext *ctx, uint32_t addr, uint32_t val );
+	static void stored( jitContext *ctx, uint32_t addr );
+
+};
+
+#endif /* __JIT_PROCESSOR_H__ */
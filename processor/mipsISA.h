@@ -11,7 +11,8 @@ typedef enum {
 	RTYPE1 = 0x00,
 	RTYPE2 = 0x1C,
 
-	//I-TYPE
+	//I-TYPE, the branch of REGIMM is in the rt field
+	REGIMM = 0x01,
 	BGEZ = 0x01,
 	BGEZAL = 0x01,
 	BLTZAL = 0x01,
@@ -45,7 +46,10 @@ typedef enum {
 
 	//J-TYPE
 	J = 0x02,
-	JAL = 0x03
+	JAL = 0x03,
+
+	//coprocessor 0, the kind of operation is in the rs field
+	COP0 = 0x10
 
 } opcode;
 
@@ -64,6 +68,7 @@ typedef enum {
 	SRAV = 0x07,
 	JR = 0x08,
 	JALR = 0x09,
+	SYSCALL = 0x0C,
 	BREAK = 0x0D,
 	MFHI = 0x10,
 	MTHI = 0x11,
@@ -93,8 +98,33 @@ typedef enum {
 	CLZ = 0x20,
 	CLO = 0x21,
 	MOVZ = 0x0a,
-	MOVN = 0x0b
+	MOVN = 0x0b,
+
+	//opcode 0x10 with the CO bit set
+	ERET = 0x18
 } function;
 
+//rt field of the REGIMM branches
+typedef enum {
+	REGIMM_BLTZ = 0x00,
+	REGIMM_BGEZ = 0x01,
+	REGIMM_LINK = 0x10	//bit set for BLTZAL and BGEZAL
+} regimmFormat;
+
+//rs field of the COP0 instructions
+typedef enum {
+	COP0_MF = 0x00,
+	COP0_MT = 0x04,
+	COP0_CO = 0x10		//bit set for ERET and the TLB operations
+} cop0Format;
+
+//coprocessor 0 registers, the rd field of MFC0/MTC0
+typedef enum {
+	CP0_BADVADDR = 8,
+	CP0_STATUS = 12,
+	CP0_CAUSE = 13,
+	CP0_EPC = 14
+} cp0Register;
+
 
 #endif /* __MIPS_ISA_H__ */
@@ -13,16 +13,162 @@
 
 using namespace std;
 
-#define EMPTY_PIPELINE(valid) !( valid[IF] || valid[ID] || valid[EX] || valid[MEM] || valid[WB] )
+#define EMPTY_PIPELINE ( !( stage( IF ).valid || stage( ID ).valid || stage( EX ).valid || stage( MEM ).valid || stage( WB ).valid ) )
 
-#define DEP_ID_EX ( ( srcRegs[ID][0] != INVAL_REG && ( srcRegs[ID][0] == dstRegs[EX][0] || srcRegs[ID][0] == dstRegs[EX][1] ) ) \
-				 || ( srcRegs[ID][1] != INVAL_REG && ( srcRegs[ID][1] == dstRegs[EX][0] || srcRegs[ID][1] == dstRegs[EX][1] ) ) )
+//scoreboard bit of a register, r0 is never written
+#define REG_BIT( r ) ( ( (r) == (uint32_t) INVAL_REG || (r) == 0 ) ? 0 : 1ULL << (r) )
 
-#define DEP_ID_MEM ( ( srcRegs[ID][0] != INVAL_REG && ( srcRegs[ID][0] == dstRegs[MEM][0] || srcRegs[ID][0] == dstRegs[MEM][1] ) ) \
-				 || ( srcRegs[ID][1] != INVAL_REG && ( srcRegs[ID][1] == dstRegs[MEM][0] || srcRegs[ID][1] == dstRegs[MEM][1] ) ) )
+//the handlers of an instruction in EX, MEM and WB
+#define HANDLERS( name ) &mipsPipelined::execute##name, &mipsPipelined::memory##name, &mipsPipelined::writeback##name
 
-#define DEP_ID_WB ( ( srcRegs[ID][0] != INVAL_REG && ( srcRegs[ID][0] == dstRegs[WB][0] || srcRegs[ID][0] == dstRegs[WB][1] ) ) \
-				 || ( srcRegs[ID][1] != INVAL_REG && ( srcRegs[ID][1] == dstRegs[WB][0] || srcRegs[ID][1] == dstRegs[WB][1] ) ) )
+//branches and jumps, those that link write pc+8 (pc+4 without delay slots) to a register
+#define BRANCH &mipsPipelined::executeBranch, NULL, NULL
+#define LINK &mipsPipelined::executeBranch, &mipsPipelined::memoryLink, &mipsPipelined::writebackLink
+
+#define HILO_BITS ( ( 1ULL << LO_REG ) | ( 1ULL << HI_REG ) )
+
+#define NO_REGS { ROLE_NONE, ROLE_NONE }
+
+//fetch only inside the text area
+#define OUTSIDE_TEXT ( pc < startAddr || pc > endAddr )
+
+/*
+ * Built by the compiler, nothing runs at startup.
+ * Unknown functs read rs and rt and write rd, unknown
+ * opcodes read rs and write rt, and both raise RI in EX.
+ */
+constexpr mipsPipelined::descTable::descTable() : itype(), rtype1(), rtype2(), regimmLink(), mfc0(), mtc0(), eret(), excepted()
+{
+	for( int i=0; i<64; ++i ) {
+		rtype1[i] = rtype2[i] = { &mipsPipelined::executeReserved, NULL, NULL,
+			{ ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+		itype[i] = { &mipsPipelined::executeReserved, NULL, NULL,
+			{ ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	}
+
+	//RTYPE1
+	rtype1[ SLL ] = { HANDLERS( SLL ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SRL ] = { HANDLERS( SRL ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SRA ] = { HANDLERS( SRA ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SLLV ] = { HANDLERS( SLLV ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SRLV ] = { HANDLERS( SRLV ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SRAV ] = { HANDLERS( SRAV ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ JR ] = { BRANCH, { ROLE_RS, ROLE_NONE }, NO_REGS, RESULT_NONE, 0, CTRL_JUMP_REG };
+	rtype1[ JALR ] = { LINK, { ROLE_RS, ROLE_NONE }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0, CTRL_JUMP_REG };
+	rtype1[ SYSCALL ] = { &mipsPipelined::executeSYSCALL, NULL, NULL, NO_REGS, NO_REGS, RESULT_NONE, 0 };
+	rtype1[ BREAK ] = { &mipsPipelined::executeBREAK, NULL, NULL, NO_REGS, NO_REGS, RESULT_NONE, 0 };
+	rtype1[ MFHI ] = { HANDLERS( MFHI ), { ROLE_HI, ROLE_NONE }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ MTHI ] = { HANDLERS( MTHI ), { ROLE_RS, ROLE_NONE }, { ROLE_HI, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ MFLO ] = { HANDLERS( MFLO ), { ROLE_LO, ROLE_NONE }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ MTLO ] = { HANDLERS( MTLO ), { ROLE_RS, ROLE_NONE }, { ROLE_LO, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ MULT ] = { HANDLERS( MULT ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, 0 };
+	rtype1[ MULTU ] = { HANDLERS( MULTU ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, 0 };
+	rtype1[ DIV ] = { HANDLERS( DIV ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype1[ DIVU ] = { HANDLERS( DIVU ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype1[ ADD ] = { HANDLERS( ADD ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ ADDU ] = { HANDLERS( ADDU ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SUB ] = { HANDLERS( SUB ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SUBU ] = { HANDLERS( SUBU ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ AND ] = { HANDLERS( AND ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ OR ] = { HANDLERS( OR ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ XOR ] = { HANDLERS( XOR ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ NOR ] = { HANDLERS( NOR ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SLT ] = { HANDLERS( SLT ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype1[ SLTU ] = { HANDLERS( SLTU ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+
+	//RTYPE2, the accumulating multiplies read LO and HI too
+	rtype2[ MADD ] = { HANDLERS( MADD ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype2[ MADDU ] = { HANDLERS( MADDU ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype2[ MSUB ] = { HANDLERS( MSUB ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype2[ MSUBU ] = { HANDLERS( MSUBU ), { ROLE_RS, ROLE_RT }, { ROLE_LO, ROLE_HI }, RESULT_ALU, HILO_BITS };
+	rtype2[ MUL ] = { HANDLERS( MUL ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype2[ CLZ ] = { HANDLERS( CLZ ), { ROLE_RS, ROLE_NONE }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype2[ CLO ] = { HANDLERS( CLO ), { ROLE_RS, ROLE_NONE }, { ROLE_RD, ROLE_NONE }, RESULT_ALU, 0 };
+	rtype2[ MOVZ ] = { HANDLERS( MOVZ ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_NONE, 0 };
+	rtype2[ MOVN ] = { HANDLERS( MOVN ), { ROLE_RS, ROLE_RT }, { ROLE_RD, ROLE_NONE }, RESULT_NONE, 0 };
+
+	/*
+	 * COP0. MTC0 writes CP0 in WB and is never forwarded, the
+	 * CP0 bit makes MFC0 wait for it. ERET and the instructions
+	 * that raised an exception act in WB, when all older ones
+	 * are done.
+	 */
+	mfc0 = { HANDLERS( MFC0 ), { ROLE_CP0, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	mtc0 = { HANDLERS( MTC0 ), { ROLE_RT, ROLE_NONE }, { ROLE_CP0, ROLE_NONE }, RESULT_NONE, 0 };
+	eret = { NULL, NULL, &mipsPipelined::writebackERET, NO_REGS, NO_REGS, RESULT_NONE, 0 };
+	excepted = { NULL, NULL, &mipsPipelined::takeException, NO_REGS, NO_REGS, RESULT_NONE, 0 };
+
+	//JTYPE
+	itype[ J ] = { BRANCH, NO_REGS, NO_REGS, RESULT_NONE, 0, CTRL_JUMP };
+	itype[ JAL ] = { LINK, NO_REGS, { ROLE_RA, ROLE_NONE }, RESULT_ALU, 0, CTRL_JUMP };
+
+	//ITYPE. BLTZ and BGEZ here, BLTZAL and BGEZAL link
+	itype[ REGIMM ] = { BRANCH, { ROLE_RS, ROLE_NONE }, NO_REGS, RESULT_NONE, 0, CTRL_BRANCH };
+	regimmLink = { LINK, { ROLE_RS, ROLE_NONE }, { ROLE_RA, ROLE_NONE }, RESULT_ALU, 0, CTRL_BRANCH };
+	itype[ BEQ ] = { BRANCH, { ROLE_RS, ROLE_RT }, NO_REGS, RESULT_NONE, 0, CTRL_BRANCH };
+	itype[ BNE ] = { BRANCH, { ROLE_RS, ROLE_RT }, NO_REGS, RESULT_NONE, 0, CTRL_BRANCH };
+	itype[ BLEZ ] = { BRANCH, { ROLE_RS, ROLE_NONE }, NO_REGS, RESULT_NONE, 0, CTRL_BRANCH };
+	itype[ BGTZ ] = { BRANCH, { ROLE_RS, ROLE_NONE }, NO_REGS, RESULT_NONE, 0, CTRL_BRANCH };
+	itype[ ADDI ] = { HANDLERS( ADDI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ ADDIU ] = { HANDLERS( ADDIU ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ SLTI ] = { HANDLERS( SLTI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ SLTIU ] = { HANDLERS( SLTIU ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ ANDI ] = { HANDLERS( ANDI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ ORI ] = { HANDLERS( ORI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ XORI ] = { HANDLERS( XORI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ LUI ] = { HANDLERS( LUI ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_ALU, 0 };
+	itype[ LB ] = { HANDLERS( LB ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_BYTE };
+	itype[ LH ] = { HANDLERS( LH ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_HALF };
+	itype[ LWL ] = { HANDLERS( LWL ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_LEFT };
+	itype[ LW ] = { HANDLERS( LW ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_WORD };
+	itype[ LBU ] = { HANDLERS( LBU ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_BYTE };
+	itype[ LHU ] = { HANDLERS( LHU ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_HALF };
+	itype[ LWR ] = { HANDLERS( LWR ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_RIGHT };
+	itype[ SB ] = { HANDLERS( SB ), { ROLE_RS, ROLE_RT }, { ROLE_NONE, ROLE_NONE }, RESULT_ALU, 0, CTRL_NONE, ACCESS_WRITE, SIZE_BYTE };
+	itype[ SH ] = { HANDLERS( SH ), { ROLE_RS, ROLE_RT }, { ROLE_NONE, ROLE_NONE }, RESULT_ALU, 0, CTRL_NONE, ACCESS_WRITE, SIZE_HALF };
+	itype[ SWL ] = { HANDLERS( SWL ), { ROLE_RS, ROLE_RT }, { ROLE_NONE, ROLE_NONE }, RESULT_ALU, 0, CTRL_NONE, ACCESS_WRITE, SIZE_LEFT };
+	itype[ SW ] = { HANDLERS( SW ), { ROLE_RS, ROLE_RT }, { ROLE_NONE, ROLE_NONE }, RESULT_ALU, 0, CTRL_NONE, ACCESS_WRITE, SIZE_WORD };
+	itype[ SWR ] = { HANDLERS( SWR ), { ROLE_RS, ROLE_RT }, { ROLE_NONE, ROLE_NONE }, RESULT_ALU, 0, CTRL_NONE, ACCESS_WRITE, SIZE_RIGHT };
+	itype[ LL ] = { HANDLERS( LL ), { ROLE_RS, ROLE_NONE }, { ROLE_RT, ROLE_NONE }, RESULT_LOAD, 0, CTRL_NONE, ACCESS_READ, SIZE_WORD };
+	itype[ SC ] = { HANDLERS( SC ), { ROLE_RS, ROLE_RT }, { ROLE_RT, ROLE_NONE }, RESULT_MEM, 0, CTRL_NONE, ACCESS_WRITE, SIZE_COND };
+}
+
+constexpr mipsPipelined::descTable mipsPipelined::descriptors;
+
+const instrDesc &mipsPipelined::describe( uint32_t cmd ) const
+{
+	switch( OP( cmd ) ) {
+		case( RTYPE1 ): return descriptors.rtype1[ FUNCT( cmd ) ];
+		case( RTYPE2 ): return descriptors.rtype2[ FUNCT( cmd ) ];
+		case( REGIMM ):
+			if( RT( cmd ) & REGIMM_LINK )
+				return descriptors.regimmLink;
+			return descriptors.itype[ REGIMM ];
+		case( COP0 ):
+			if( RS( cmd ) == COP0_MF )
+				return descriptors.mfc0;
+			if( RS( cmd ) == COP0_MT )
+				return descriptors.mtc0;
+			if( ( RS( cmd ) & COP0_CO ) && FUNCT( cmd ) == ERET )
+				return descriptors.eret;
+			return descriptors.itype[ COP0 ];
+		default: return descriptors.itype[ OP( cmd ) ];
+	}
+}
+
+uint32_t mipsPipelined::roleReg( uint8_t role, uint32_t cmd ) const
+{
+	switch( role ) {
+		case( ROLE_RS ): return RS( cmd );
+		case( ROLE_RT ): return RT( cmd );
+		case( ROLE_RD ): return RD( cmd );
+		case( ROLE_LO ): return LO_REG;
+		case( ROLE_HI ): return HI_REG;
+		case( ROLE_CP0 ): return CP0_REG;
+		case( ROLE_RA ): return 31;
+		default: return INVAL_REG;
+	}
+}
 
 
 void mipsPipelined::run()
@@ -33,260 +179,673 @@ void mipsPipelined::run()
 
 }
 
+runResult mipsPipelined::run( uint64_t maxCycles )
+{
+	return runCycles( 0, false, maxCycles );
+}
+
+runResult mipsPipelined::runUntil( uint32_t stopPc, uint64_t maxCycles )
+{
+	return runCycles( stopPc, true, maxCycles );
+}
+
+runResult mipsPipelined::runCycles( uint32_t stopPc, bool atPc, uint64_t maxCycles )
+{
+	runResult res;
+	uint64_t firstCycle = cycles;
+	uint64_t firstRetired = retired;
+	res.status = RUN_LIMIT;
+	stopping = atPc;
+	this->stopPc = stopPc;
+	stopped = false;
+
+	while( cycles - firstCycle < maxCycles ) {
+		if( EMPTY_PIPELINE && OUTSIDE_TEXT ) {
+			res.status = RUN_DONE;
+			break;
+		}
+		if( !cycle() ) {
+			res.status = RUN_ERROR;
+			break;
+		}
+		if( stopped ) {
+			res.status = RUN_PC;
+			break;
+		}
+	}
+	stopping = false;
+
+	res.cycles = cycles - firstCycle;
+	res.instructions = retired - firstRetired;
+	return res;
+}
+
 void mipsPipelined::step()
 {
-	//print numbers as hexademical with 0x prefix
-	stringstream ex;
-	ex.setf( ios::hex, ios::basefield );
-	ex.setf( ios::showbase );
+	if( !cycle() )
+		throw error;
+}
+
+void mipsPipelined::init()
+{
+	memset( &cur, 0, sizeof( cur ) );
+	next = cur;
+	memset( &stalls, 0, sizeof( stalls ) );
+	bypass = BYPASS_ALL;
+	dependence = branchWait = false;
+	branchStage = EX;
+	delaySlots = true;
+	fetchedControl = redirect = false;
+	redirectPc = 0;
+	squash = 0;
+	rasTop = 0;
+	slotPending = false;
+	slotTarget = 0;
+	memset( &branches, 0, sizeof( branches ) );
+	predictor = NULL;
+	btb = NULL;
+	ras = NULL;
+	l1i = l1d = NULL;
+	fetchWait = memWait = 0;
+	lsu = NULL;
+	tracer = NULL;
+	missRegs = 0;
+	memset( missReady, 0, sizeof( missReady ) );
+	head = 0;
+	cycles = retired = 0;
+	excVector = EXC_VECTOR;
+	irqReady = false;
+	halted = false;
+	stopping = stopped = false;
+	stopPc = 0;
+
+	for( int i=0; i<RING_SIZE; ++i ) {
+		ring[i].cmd = 0;
+		ring[i].pc = 0;
+		ring[i].desc = NULL;
+		ring[i].srcRegs[0] = ring[i].srcRegs[1] = INVAL_REG;
+		ring[i].dstRegs[0] = ring[i].dstRegs[1] = INVAL_REG;
+		ring[i].reads = ring[i].writes = 0;
+		ring[i].result = RESULT_NONE;
+		ring[i].valid = false;
+		ring[i].delaySlot = false;
+		ring[i].predTaken = false;
+		ring[i].predPc = 0;
+		ring[i].rasTop = 0;
+		ring[i].exc = NO_EXCEPTION;
+		ring[i].badAddr = 0;
+	}
+}
 
-	if( pc < startAddr ) {
-		ex << "Error: pc out of range" << pc << endl;
-		throw ex.str();
+/*
+ * One clock. The memory, the registers and the stage
+ * handlers leave their faults pending and they are looked
+ * at once the cycle is over, a single branch when there
+ * are none. false if the pipeline is stopped, error says why.
+ */
+bool mipsPipelined::cycle()
+{
+	if( halted )
+		return false;
+
+	if( EMPTY_PIPELINE && OUTSIDE_TEXT ) {
+		error = "Error: empty pipeline";
+		return false;
 	}
 
-	if( EMPTY_PIPELINE( valid ) && pc > endAddr ) {
-		ex << "Error: empty pipeline" << endl;
-		throw ex.str();
+	if( lsu != NULL ) {
+		lsu->sample( cycles );
+		if( missRegs != 0 )
+			retireMisses();
 	}
 
-	for (int i = WB; i > EX; --i) { 
-		cmd[i]   = cmd[i-1];
-		valid[i] = valid[i-1];
-		srcRegs[i][0] = srcRegs[i-1][0];
-		srcRegs[i][1] = srcRegs[i-1][1];
-		dstRegs[i][0] = dstRegs[i-1][0];
-		dstRegs[i][1] = dstRegs[i-1][1];
+	//nothing moves while the data cache answers, a miss in IF goes on
+	if( __builtin_expect( memWait != 0, 0 ) ) {
+		--memWait;
+		++stalls.memoryCycles;
+		fetchWait -= ( fetchWait > 1 );
+		++cycles;
+		return true;
 	}
 
+	//checked before the pipe advances, against what goes to MEM and WB
 	dependence = checkDependence();
-	
-	if( !dependence )
-		for (int i = EX; i > IF; --i) { 
-			cmd[i]   = cmd[i-1];
-			valid[i] = valid[i-1];
-			srcRegs[i][0] = srcRegs[i-1][0];
-			srcRegs[i][1] = srcRegs[i-1][1];
-			dstRegs[i][0] = dstRegs[i-1][0];
-			dstRegs[i][1] = dstRegs[i-1][1];
-		}
-	
+	branchWait = !dependence && checkBranchOperands();
+	if( dependence || branchWait ) {
+		++stalls.cycles;
+		++stalls.byStage[ stallStage ];
+		++stalls.byReg[ stallReg ];
+		branches.operandStalls += branchWait;
+	}
 
-  //if dependance exists EX stage is always invalid
-  //that is, operation located at ID stage does not progress
-	if( dependence )
-		valid[EX] = false;
+	//every instruction moves one stage down
+	++head;
 
-	//execute each stage of the pipeline	
-	if( valid[WB] )
+	//if dependance exists EX stage is always invalid
+	//that is, operation located at ID stage does not progress
+	if( dependence ) {
+		stage( IF ) = stage( ID );
+		stage( ID ) = stage( EX );
+		stage( EX ).valid = false;
+	} else {
+		//a branch waiting for its operands stays in IF
+		if( branchWait ) {
+			stage( IF ) = stage( ID );
+			stage( ID ).valid = false;
+		}
+		if( stage( EX ).valid )
+			forward();
+	}
+
+	//execute each stage of the pipeline. Stages read cur and write
+	//next, only the register file written in WB is seen by ID.
+	//An exception taken in WB flushes the other stages
+	if( stage( WB ).valid ) {
+		retired += ( stage( WB ).exc == NO_EXCEPTION );
 		writeback();
-	if( valid[MEM] )
+	}
+	memFault inMem = NO_FAULT;
+	if( stage( MEM ).valid ) {
 		memory();
-	if( valid[EX] )
+		inMem = mem->fault();
+	}
+	if( stage( EX ).valid )
 		execute();
-	if( valid[ID] )
+	if( stage( ID ).valid )
 		decode();
 	fetch();
 
-}
+	//commit the cycle
+	cur = next;
+	++cycles;
 
-void mipsPipelined::fetch() {
+	if( __builtin_expect( irqReady | halted | faultPending(), 0 ) )
+		return attend( inMem );
+	return true;
+}
 
-	if( dependence ) 
+void mipsPipelined::raise( stageEntry &e, exception code, uint32_t addr )
+{
+	if( e.exc != NO_EXCEPTION )
 		return;
 
-	if ( pc > endAddr ) { // TODO : Add J-type case later...
-		valid[IF] = false;
-		return;
+	e.exc = code;
+	e.badAddr = addr;
+	e.desc = &descriptors.excepted;
+	e.reads = e.writes = 0;
+	e.result = RESULT_NONE;
+}
+
+/*
+ * A memory fault belongs to the instruction in MEM if it
+ * was there already after memory(), else to the fetch. An
+ * interrupt is taken by the oldest instruction that has
+ * not reached MEM yet, so nothing it did is visible.
+ */
+bool mipsPipelined::attend( memFault inMem )
+{
+	if( reg->fault() ) {
+		reg->clearFault();
+		error = "Not valid address for stack pointer";
+		halted = true;
 	}
 
-	//set IFID intermediate register fields
+	if( mem->fault() != NO_FAULT ) {
+		exception code = ( mem->fault() == STORE_FAULT ) ? AdEs : AdEl;
+		if( inMem != NO_FAULT )
+			raise( stage( MEM ), code, mem->faultAddr() );
+		else
+			raise( stage( IF ), code, stage( IF ).pc );
+		mem->clearFault();
+	}
 
-	uint32_t temp = mem->loadWord( pc );
-	innerRegs->IFID_setPC( temp );
-	innerRegs->IFID_setNextPC( mem->loadWord( pc + 4 ) );
+	if( irqReady )
+		for( int s=EX; s>=IF; --s )
+			if( stage( s ).valid ) {
+				raise( stage( s ), Int, 0 );
+				break;
+			}
 
-	//set status registers of IF stage.
-	cmd[IF] = temp;
-	valid[IF] = true;
+	return !halted;
+}
+
+static const char *excName( int code )
+{
+	switch( code ) {
+		case( 0 ): return "Interrupt";
+		case( 4 ): return "AdEL";
+		case( 5 ): return "AdES";
+		case( 8 ): return "SYSCALL";
+		case( 9 ): return "BREAK";
+		case( 10 ): return "RI";
+		default: return "Unknown";
+	}
+}
+
+/*
+ * WB of an instruction that raised an exception. Older
+ * instructions are all done, younger ones are dropped.
+ * EPC is kept while in the handler already.
+ */
+void mipsPipelined::takeException()
+{
+	stageEntry &e = stage( WB );
 
-	//set source and destination registers for each instruction
-	//used for checking dependences
-	if( OP( temp ) == RTYPE1 ) {
+	cause = ( cause & ~EC ) | ( e.exc << 2 );
+	if( e.exc == AdEl || e.exc == AdEs )
+		badVAddr = e.badAddr;
+	//in a delay slot the branch runs again, BD says so
+	if( !( status & EL ) ) {
+		epc = e.delaySlot ? e.pc - 4 : e.pc;
+		cause = e.delaySlot ? ( cause | BD ) : ( cause & ~BD );
+	}
+	status |= EL;
+	updateInterrupts();
+	flushYounger();
+	pc = excVector;
+
+	if( excVector < startAddr || excVector > endAddr ) {
+		stringstream ex;
+		ex.setf( ios::hex, ios::basefield );
+		ex.setf( ios::showbase );
+		ex << excName( e.exc ) << " exception at pc " << e.pc;
+		if( e.exc == AdEl || e.exc == AdEs )
+			ex << ", address " << e.badAddr;
+		error = ex.str();
+		halted = true;
+	}
+}
 
-		switch( FUNCT( temp ) ) {
+void mipsPipelined::flushYounger()
+{
+	stage( MEM ).valid = false;
+	stage( EX ).valid = false;
+	stage( ID ).valid = false;
+	stage( IF ).valid = false;
 
-			case( MFHI ):
-				srcRegs[IF][0] = HI_REG;
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
-			
-			case( MFLO ):
-				srcRegs[IF][0] = LO_REG;
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+	//fetch from the new pc in this cycle
+	dependence = branchWait = false;
+	fetchWait = 0;
+	redirect = fetchedControl = slotPending = false;
+}
 
-			case( MTHI ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = HI_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+void mipsPipelined::updateInterrupts()
+{
+	irqReady = ( status & IE ) && !( status & EL ) && ( cause & status & IP );
+}
 
-			case( MTLO ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = LO_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+void mipsPipelined::setInterrupt( int line, bool on )
+{
+	uint32_t bit = 1 << ( 8 + line );
+	cause = on ? ( cause | bit ) : ( cause & ~bit );
+	updateInterrupts();
+}
 
-			case( DIV ):
-			case( DIVU ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp );
-				dstRegs[IF][0] = LO_REG;
-				dstRegs[IF][1] = HI_REG;;
-				break;				
-			
-			case( JALR ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+uint32_t mipsPipelined::readCP0( uint32_t r ) const
+{
+	switch( r ) {
+		case( CP0_BADVADDR ): return badVAddr;
+		case( CP0_STATUS ): return status;
+		case( CP0_CAUSE ): return cause;
+		case( CP0_EPC ): return epc;
+		default: return 0;
+	}
+}
 
-			case( SLL ):
-			case( SRA ):
-			case( SRL ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp );
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
-			case( JR ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = INVAL_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
-	
-			default:
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp ); 
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
-		}
+//only the two software interrupts of cause can be written
+void mipsPipelined::writeCP0( uint32_t r, uint32_t val )
+{
+	switch( r ) {
+		case( CP0_STATUS ): status = val; break;
+		case( CP0_CAUSE ): cause = ( cause & ~0x300 ) | ( val & 0x300 ); break;
+		case( CP0_EPC ): epc = val; break;
+		default: break;
+	}
+	updateInterrupts();
+}
 
-	} else if ( OP( temp ) == RTYPE2 ) {
-		switch( FUNCT( temp ) ) {
-			case( MADD ):
-			case( MADDU ):
-			case( MSUB ):
-			case( MSUBU ):
-			case( MUL ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp );
-				dstRegs[IF][0] = LO_REG;
-				dstRegs[IF][1] = HI_REG;;
-				break;	
-
-			case( CLZ ):
-			case( CLO ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG;
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+void mipsPipelined::fetch() {
 
-			default:
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp ); 
-				dstRegs[IF][0] = RD( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
-		}
+	//IF holds its instruction, a miss goes on but is not over until fetch is
+	if( dependence || branchWait ) {
+		fetchWait -= ( fetchWait > 1 );
+		return;
+	}
 
-	} else if ( OP( temp ) == J ) {
-		//do nothing
-	} else if ( OP( temp ) == JAL ) {
-		//do nothing	
+	stageEntry &f = stage( IF );
+	if( !OUTSIDE_TEXT ) {
+		if( l1i == NULL || fetchReady() )
+			fetchWord( f );
+		else {
+			f.valid = false;
+			++stalls.fetchCycles;
+		}
 	} else {
-		switch( OP( temp ) ) {
-			case( BEQ ):
-			case( BNE ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp ); 
-				dstRegs[IF][0] = INVAL_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+		//no delay slot past the end of the text
+		f.valid = false;
+		fetchedControl = false;
+		if( slotPending ) {
+			pc = slotTarget;
+			slotPending = false;
+		}
+	}
 
-			case( BGEZ ): 	//also BGEZAL, BLTZ, BLTZAL
-			case( BLEZ ):
-			case( BGTZ ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG; 
-				dstRegs[IF][0] = INVAL_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+	/*
+	 * A branch taken this cycle drops what was fetched after
+	 * it, youngest first. The delay slot is the oldest of those,
+	 * with misses in IF not always right behind the branch, and
+	 * if it is still to be fetched fetch goes on after it.
+	 */
+	if( __builtin_expect( redirect, 0 ) ) {
+		int oldest = IF + squash - 1;
+		while( oldest >= IF && !stage( oldest ).valid )
+			--oldest;
+		if( delaySlots && fetchedControl && oldest < IF ) {
+			slotPending = true;
+			slotTarget = redirectPc;
+		} else {
+			for( int s=IF; s<=oldest-delaySlots; ++s ) {
+				branches.flushed += stage( s ).valid;
+				stage( s ).valid = false;
+			}
+			pc = redirectPc;
+			fetchWait = 0;
+			fetchedControl = slotPending = false;
+		}
+		redirect = false;
+		if( ras != NULL )
+			ras->restore( rasTop );
+	}
+}
 
-			case( SB ):
-			case( SH ):
-			case( SW ):
-			case( SWL ):
-			case( SWR ):
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = RT( temp ); 
-				dstRegs[IF][0] = INVAL_REG;
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+/*
+ * The I-cache is asked once for every pc fetched, true
+ * when the word is there. A miss of n cycles leaves IF
+ * empty for n-1 of them.
+ */
+bool mipsPipelined::fetchReady()
+{
+	if( fetchWait != 0 )
+		return --fetchWait == 0;
 
-			default:
-				//All other ITYPE instructions left
-				srcRegs[IF][0] = RS( temp );
-				srcRegs[IF][1] = INVAL_REG; 
-				dstRegs[IF][0] = RT( temp );
-				dstRegs[IF][1] = INVAL_REG;
-				break;
+	uint32_t lat = l1i->access( pc, false, pc, cycles );
+	fetchWait = ( lat > 1 ) ? lat - 1 : 0;
+	return fetchWait == 0;
+}
 
-		}
+void mipsPipelined::fetchWord( stageEntry &f )
+{
+	//set IFID intermediate register fields
+	uint32_t temp = mem->loadWord( pc );
+	next.ifid.cmd = temp;
+	if( tracer != NULL )
+		tracer->record( TRACE_FETCH, pc, pc, 4, cycles );
+
+	//set status registers of IF stage.
+	f.cmd = temp;
+	f.pc = pc;
+	f.valid = true;
+	f.delaySlot = delaySlots && fetchedControl;
+	f.exc = NO_EXCEPTION;
+
+	//operands and results, used for checking dependences
+	const instrDesc &d = describe( temp );
+	f.desc = &d;
+	f.srcRegs[0] = roleReg( d.src[0], temp );
+	f.srcRegs[1] = roleReg( d.src[1], temp );
+	f.dstRegs[0] = roleReg( d.dst[0], temp );
+	f.dstRegs[1] = roleReg( d.dst[1], temp );
+
+	f.reads = REG_BIT( f.srcRegs[0] ) | REG_BIT( f.srcRegs[1] ) | d.implicitReads;
+	f.writes = REG_BIT( f.dstRegs[0] ) | REG_BIT( f.dstRegs[1] );
+	f.result = d.result;
+	fetchedControl = d.control != CTRL_NONE;
+	stopped |= stopping && pc == stopPc;
+
+	//after the delay slot of a branch predicted taken, its target
+	if( slotPending ) {
+		pc = slotTarget;
+		slotPending = false;
+	} else
+		pc += 4;
+
+	if( d.control != CTRL_NONE )
+		predict( f, d );
+}
 
+/*
+ * Where fetch goes after f. The return stack has JR $31,
+ * the target buffer the others, and without a target it
+ * goes on at pc+4 whatever the direction.
+ */
+void mipsPipelined::predict( stageEntry &f, const instrDesc &d )
+{
+	f.predPc = f.pc + ( delaySlots ? 8 : 4 );
+
+	uint32_t target = 0;
+	bool known = false;
+	if( ras != NULL && d.control == CTRL_JUMP_REG && RS( f.cmd ) == 31 ) {
+		target = ras->pop();
+		known = true;
+	} else if( btb != NULL )
+		known = btb->lookup( f.pc, target );
+
+	//JAL and JALR call, the return address is where they would go on
+	if( ras != NULL ) {
+		if( d.control != CTRL_BRANCH && d.dst[0] != ROLE_NONE )
+			ras->push( f.predPc );
+		f.rasTop = ras->top();
 	}
 
-	pc += 4;
+	if( d.control == CTRL_BRANCH )
+		f.predTaken = predictor != NULL && predictor->predict( f.pc, f.pc + 4 + IMMED( f.cmd ) * 4 );
+	else
+		f.predTaken = true;
+
+	if( f.predTaken && known ) {
+		f.predPc = target;
+		if( delaySlots ) {
+			slotPending = true;
+			slotTarget = target;
+		} else
+			pc = target;
+	}
 }
 
 
 void mipsPipelined::decode() {
 
-	if( !dependence ) {
-		uint32_t temp = innerRegs->IFID_getPC();
-		innerRegs->IDEX_setNextPC( innerRegs->IFID_getNextPC() );
+	//set fields of IDEX intermediate regiser fields
+	next.idex.rt = reg->getReg( RT( stage( ID ).cmd ) );
+	next.idex.rs = reg->getReg( RS( stage( ID ).cmd ) );
+	next.idex.immed = IMMED( stage( ID ).cmd );
+	next.idex.dest.rd = RD( stage( ID ).cmd );
+	next.idex.dest.rt = RT( stage( ID ).cmd );
+	next.idex.shamt = SHAMT( stage( ID ).cmd );
+
+	next.idex.lo = reg->getLO();	
+	next.idex.hi = reg->getHI();
+
+	//jumps, and branches when the comparator is in ID. Not a
+	//jump in the shadow of a branch EX took this cycle
+	stageEntry &e = stage( ID );
+	uint8_t ctrl = e.desc->control;
+	if( ctrl != CTRL_NONE && !redirect && ( ctrl == CTRL_JUMP || branchStage == ID ) ) {
+		resolve( e, ID, idOperand( RS( e.cmd ) ), idOperand( RT( e.cmd ) ) );
+		e.reads = 0;
 	}
+}
 
-	//set fields of IDEX intermediate regiser fields
-	innerRegs->IDEX_setRT( reg->getReg( RT( cmd[ID] ) ) );
-	innerRegs->IDEX_setRS( reg->getReg( RS( cmd[ID] ) ) );
-	innerRegs->IDEX_setImmed( IMMED( cmd[ID] ) );
-	innerRegs->IDEX_setDestRegs( RD( cmd[ID] ), RT( cmd[ID] ) );
-	innerRegs->IDEX_setShamt( SHAMT( cmd[ID] ) );
+//register r as the comparator in ID sees it, from the EX/MEM latch if it is there
+uint32_t mipsPipelined::idOperand( uint32_t r )
+{
+	stageEntry &m = stage( MEM );
+	if( m.valid && m.result == RESULT_ALU && ( m.writes & REG_BIT( r ) ) )
+		return ( m.dstRegs[0] == r ) ? cur.exmem.aluRes : cur.exmem.aluRes2;
+	return reg->getReg( r );
+}
+
+/*
+ * The instruction in ID waits while one in EX or MEM
+ * writes a register it reads, unless a bypass will hand
+ * the value to EX next cycle. Loads only reach MEM->EX,
+ * so a load followed by a use stalls once. Without WB->ID
+ * the register file is written at the end of the cycle
+ * and the instruction in WB counts too. The nearest
+ * producer and the lowest register in conflict are kept
+ * for the stats.
+ */
+bool mipsPipelined::checkDependence()
+{
+	stageEntry &id = stage( ID );
+	if( !id.valid )
+		return false;
 
-	//TODO: Add functionallity for J-type cases.
-	innerRegs->IDEX_setLO( reg->getLO() );	
-	innerRegs->IDEX_setHI( reg->getHI() );
+	uint64_t conflict;
+	stageEntry &ex = stage( EX );
+	stageEntry &mem = stage( MEM );
+	stageEntry &wb = stage( WB );
 
+	if( ex.valid && ( conflict = id.reads & ex.writes )
+		&& !( ( bypass & BYPASS_EX_EX ) && ex.result == RESULT_ALU ) )
+		stallStage = EX;
+	else if( mem.valid && ( conflict = id.reads & mem.writes )
+		&& !( ( bypass & BYPASS_MEM_EX ) && mem.result != RESULT_NONE ) )
+		stallStage = MEM;
+	else if( !( bypass & BYPASS_WB_ID ) && wb.valid && ( conflict = id.reads & wb.writes ) )
+		stallStage = WB;
+	else if( ( conflict = id.reads & missRegs ) )
+		stallStage = MEM;
+	else
+		return false;
+
+	stallReg = __builtin_ctzll( conflict );
+	return true;
 }
 
-bool mipsPipelined::checkDependence()
+/*
+ * A branch resolved in ID enters it only once its operands
+ * can be read there: not while their producer is about to
+ * run EX, nor while it is a load in MEM or BYPASS_EX_EX is
+ * off, and without BYPASS_WB_ID not while it is in WB. Seen
+ * from before the pipe advances, so one stage earlier.
+ */
+bool mipsPipelined::checkBranchOperands()
+{
+	stageEntry &f = stage( IF );
+	if( branchStage != ID || !f.valid || f.desc->control == CTRL_NONE || f.desc->control == CTRL_JUMP )
+		return false;
+
+	uint64_t conflict;
+	stageEntry &id = stage( ID );
+	stageEntry &ex = stage( EX );
+	stageEntry &mem = stage( MEM );
+
+	if( id.valid && ( conflict = f.reads & id.writes ) )
+		stallStage = EX;
+	else if( ex.valid && ( conflict = f.reads & ex.writes )
+		&& !( ( bypass & BYPASS_EX_EX ) && ex.result == RESULT_ALU ) )
+		stallStage = MEM;
+	else if( !( bypass & BYPASS_WB_ID ) && mem.valid && ( conflict = f.reads & mem.writes ) )
+		stallStage = WB;
+	else if( ( conflict = f.reads & missRegs ) )
+		stallStage = MEM;
+	else
+		return false;
+
+	stallReg = __builtin_ctzll( conflict );
+	return true;
+}
+
+bool mipsPipelined::branchTaken( uint32_t cmd, uint32_t rs, uint32_t rt ) const
+{
+	switch( OP( cmd ) ) {
+		case( BEQ ): return rs == rt;
+		case( BNE ): return rs != rt;
+		case( BLEZ ): return (int32_t) rs <= 0;
+		case( BGTZ ): return (int32_t) rs > 0;
+		case( REGIMM ): return ( RT( cmd ) & REGIMM_BGEZ ) ? (int32_t) rs >= 0 : (int32_t) rs < 0;
+		default: return true;
+	}
+}
+
+/*
+ * e was resolved in stage s and the predictors learn how.
+ * If fetch went elsewhere what it fetched after e, but for
+ * the delay slot, is dropped at the end of the cycle.
+ */
+void mipsPipelined::resolve( stageEntry &e, int s, uint32_t rs, uint32_t rt )
 {
-	if( (valid[EX] && DEP_ID_EX) || (valid[MEM] && DEP_ID_MEM) || (valid[WB] && DEP_ID_WB) )
-		return true;
+	uint32_t target;
+	bool taken = true;
+
+	if( e.desc->control == CTRL_JUMP ) {
+		++branches.jumps;
+		target = ( ( e.pc + 4 ) & 0xf0000000 ) | ( TARG( e.cmd ) << 2 );
+	} else {
+		++branches.branches;
+		taken = branchTaken( e.cmd, rs, rt );
+		branches.taken += taken;
+		target = ( e.desc->control == CTRL_JUMP_REG ) ? rs : e.pc + 4 + IMMED( e.cmd ) * 4;
+		if( predictor != NULL && e.desc->control == CTRL_BRANCH ) {
+			predictor->update( e.pc, taken, target );
+			predictor->record( e.pc, taken != e.predTaken );
+		}
+	}
 
-	return false;
+	if( taken && btb != NULL )
+		btb->update( e.pc, target );
+
+	uint32_t next = taken ? target : e.pc + ( delaySlots ? 8 : 4 );
+	if( next == e.predPc )
+		return;
+
+	++branches.mispredicted;
+	redirect = true;
+	redirectPc = next;
+	squash = s - IF;
+	rasTop = e.rasTop;
+}
+
+/*
+ * Bypass muxes in front of EX. The operands decoded last
+ * cycle are replaced by results still in the EX/MEM and
+ * MEM/WB latches, the nearer one last so that it wins.
+ */
+void mipsPipelined::forward()
+{
+	stageEntry &ex = stage( EX );
+	stageEntry &mem = stage( MEM );
+	stageEntry &wb = stage( WB );
+
+	if( ( bypass & BYPASS_MEM_EX ) && wb.valid && wb.result != RESULT_NONE && ( ex.reads & wb.writes ) ) {
+		uint32_t val = ( wb.result == RESULT_LOAD ) ? cur.memwb.mem : cur.memwb.alu;
+		forwardValue( ex, wb.dstRegs[0], val );
+		forwardValue( ex, wb.dstRegs[1], cur.memwb.alu2 );
+	}
+
+	if( ( bypass & BYPASS_EX_EX ) && mem.valid && mem.result == RESULT_ALU && ( ex.reads & mem.writes ) ) {
+		forwardValue( ex, mem.dstRegs[0], cur.exmem.aluRes );
+		forwardValue( ex, mem.dstRegs[1], cur.exmem.aluRes2 );
+	}
+}
+
+//give val to every operand of the instruction in EX that reads r
+void mipsPipelined::forwardValue( const stageEntry &ex, uint32_t r, uint32_t val )
+{
+	if( !( ex.reads & REG_BIT( r ) ) )
+		return;
+
+	if( r == LO_REG )
+		cur.idex.lo = val;
+	else if( r == HI_REG )
+		cur.idex.hi = val;
+	else {
+		if( RS( ex.cmd ) == r )
+			cur.idex.rs = val;
+		if( RT( ex.cmd ) == r )
+			cur.idex.rt = val;
+	}
 }
 
 
@@ -297,665 +856,568 @@ bool mipsPipelined::checkDependence()
 
 
 void mipsPipelined::execute() {
-	uint32_t op = OP( cmd[EX] );
-	if( op == RTYPE1 ) {
-
-		//RTYPE1 operations
-		switch( FUNCT( cmd[EX] ) ) {
-			case( SLL ): executeSLL(); break;
-			case( SRL ): executeSRL(); break;
-			case( SRA ): executeSRA(); break;
-			case( SLLV ): executeSLLV(); break;
-			case( SRLV ): executeSRLV(); break;
-			case( SRAV ): executeSRAV(); break;
-			case( JR ): executeJR(); break;
-			case( JALR ): executeJALR(); break;
-			case( BREAK ): executeBREAK(); break;
-			case( MFHI ): executeMFHI(); break;
-			case( MTHI ): executeMTHI(); break;
-			case( MFLO ): executeMFLO(); break;
-			case( MTLO ): executeMTLO(); break;
-			case( MULT ): executeMULT(); break;
-			case( MULTU ): executeMULTU(); break;
-			case( DIV ): executeDIV(); break;
-			case( DIVU ): executeDIVU(); break;
-			case( ADD ): executeADD(); break;
-			case( ADDU ): executeADDU(); break;
-			case( SUB ): executeSUB(); break;
-			case( SUBU ): executeSUBU(); break;
-			case( AND ): executeAND(); break;
-			case( OR ): executeOR(); break;
-			case( XOR ): executeXOR(); break;
-			case( NOR ): executeNOR(); break;
-			case( SLT ): executeSLT(); break;
-			case( SLTU ): executeSLTU(); break;
-			default:
-				throw "Unhandled operation EX";
-		} 
-
-	} else if ( op == RTYPE2 ) {
-	
-		//RTYPE2 operations
-		switch( FUNCT( cmd[EX] ) ) {
-			case( MADD ): executeMADD(); break;
-			case( MADDU ): executeMADDU(); break;
-			case( MUL ): executeMUL(); break;
-			case( MSUB ): executeMSUB(); break;
-			case( MSUBU ): executeMSUBU(); break;
-			case( CLZ ): executeCLZ(); break;
-			case( CLO ): executeCLO(); break;
-			case( MOVZ ): executeMOVZ(); break;
-			case( MOVN ): executeMOVN(); break;
-			default:
-				throw "Unhandled operation EX";
-		}
-
-	} else if ( op == J ) { 
-		executeJ();
-		
-	} else if ( op == JAL ) {
-		executeJAL();
-
-
-	} else { //ITYPE here
-		
-		switch( op ) {
-			case( BGEZ ):
-				//TODO: handle case of BGEZ, BGEZAL, BLTZAL, BLTZ
-				break;
-			case( BEQ ): executeBEQ(); break;
-			case( BNE ): executeBNE(); break;
-			case( BLEZ ): executeBLEZ(); break;
-			case( BGTZ ): executeBGEZ(); break;
-			case( ADDI ): executeADDI(); break;
-			case( ADDIU ): executeADDIU(); break;
-			case( SLTI ): executeSLTI(); break;
-			case( SLTIU ): executeSLTIU(); break;
-			case( ANDI ): executeANDI(); break;
-			case( ORI ): executeORI(); break;
-			case( XORI ): executeXORI(); break;
-			case( LUI ): executeLUI(); break;
-			case( LB ): executeLB(); break;
-			case( LH ): executeLH(); break;
-			case( LWL ): executeLWL(); break;
-			case( LW ): executeLW(); break;
-			case( LBU ): executeLBU(); break;
-			case( LHU ): executeLHU(); break;
-			case( LWR ): executeLWR(); break;
-			case( SB ): executeSB(); break;
-			case( SH ): executeSH(); break;
-			case( SWL ): executeSWL(); break;
-			case( SW ): executeSW(); break;
-			case( SWR ): executeSWR(); break;
-			case( LL ): executeLL(); break;
-			case( SC ): executeSC(); break;
-			default:
-				throw "Unhandled operation EX";
-		} 	
-	}
+	stageHandler h = stage( EX ).desc->execute;
+	if( h != NULL )
+		( this->*h )();
 }
 
 //functionality of MIPS instruction
 //in execute stage.
 void mipsPipelined::executeSLL()
 {
-	uint32_t shamt = innerRegs->IDEX_getShamt();
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt << shamt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t shamt = cur.idex.shamt;
+	uint32_t rt = cur.idex.rt;
+	next.exmem.aluRes = rt << shamt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSRL()
 {
-	uint32_t shamt = innerRegs->IDEX_getShamt();
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt >> shamt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t shamt = cur.idex.shamt;
+	uint32_t rt = cur.idex.rt;
+	next.exmem.aluRes = rt >> shamt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSRA()
 {
-	uint32_t shamt = innerRegs->IDEX_getShamt();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt >> shamt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t shamt = cur.idex.shamt;
+	int32_t rt = (int32_t) cur.idex.rt;
+	next.exmem.aluRes = rt >> shamt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSLLV()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt << rs );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
+	next.exmem.aluRes = rt << rs;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSRLV()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt >> rs );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
+	next.exmem.aluRes = rt >> rs;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSRAV()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	int32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setAluRes( rt >> rs );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	int32_t rt = cur.idex.rt;
+	next.exmem.aluRes = rt >> rs;
+	next.exmem.dest = cur.idex.dest;
 }
 
-void mipsPipelined::executeJR()
+//the link, written by those that have a destination, and the target unless ID had it
+void mipsPipelined::executeBranch()
 {
-	//TODO
+	stageEntry &e = stage( EX );
+	next.exmem.aluRes = e.pc + ( delaySlots ? 8 : 4 );
+	next.exmem.dest = cur.idex.dest;
+
+	if( branchStage == EX && e.desc->control != CTRL_JUMP )
+		resolve( e, EX, cur.idex.rs, cur.idex.rt );
 }
 
-void mipsPipelined::executeJALR()
+void mipsPipelined::executeSYSCALL()
 {
-	//TODO
+	raise( stage( EX ), Sys, 0 );
 }
 
 void mipsPipelined::executeBREAK()
 {
-	//TODO
+	raise( stage( EX ), Bp, 0 );
 }
 
 void mipsPipelined::executeMFHI()
 {
-	uint32_t hi = reg->getHI();
-	innerRegs->EXMEM_setAluRes( hi );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t hi = cur.idex.hi;
+	next.exmem.aluRes = hi;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeMTHI()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( rs );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = rs;
 }
 
 void mipsPipelined::executeMFLO()
 {
-	uint32_t lo = reg->getLO();
-	innerRegs->EXMEM_setAluRes( lo );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t lo = cur.idex.lo;
+	next.exmem.aluRes = lo;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeMTLO()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( rs );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = rs;
 }
 
 void mipsPipelined::executeMULT()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 
-	int64_t result = rs * rt;
+	int64_t result = (int64_t) rs * rt;
 
-	innerRegs->EXMEM_setAluRes(result && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((result >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) result;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( result >> 32 ); // Stores into that register the result for HI
 }
 
 void mipsPipelined::executeMULTU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 
-	uint64_t result = rs * rt;
+	uint64_t result = (uint64_t) rs * rt;
 
-	innerRegs->EXMEM_setAluRes(result && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((result >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) result;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( result >> 32 ); // Stores into that register the result for HI
 }
 
 void mipsPipelined::executeDIV()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 
-	innerRegs->EXMEM_setAluRes(rs / rt);
-	innerRegs->EXMEM_setAluRes2(rs % rt);
+	//HI and LO keep their values when the result is UNPREDICTABLE, read for that
+	if( !DIVIDES( rs, rt ) ) {
+		next.exmem.aluRes = cur.idex.lo;
+		next.exmem.aluRes2 = cur.idex.hi;
+		return;
+	}
+
+	next.exmem.aluRes = rs / rt;
+	next.exmem.aluRes2 = rs % rt;
 
 	//TODO -> Ask silverwind for overflow + safeops...
 }
 
 void mipsPipelined::executeDIVU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 
-	innerRegs->EXMEM_setAluRes(rs / rt);
-	innerRegs->EXMEM_setAluRes2(rs % rt);
+	if( rt == 0 ) {
+		next.exmem.aluRes = cur.idex.lo;
+		next.exmem.aluRes2 = cur.idex.hi;
+		return;
+	}
+
+	next.exmem.aluRes = rs / rt;
+	next.exmem.aluRes2 = rs % rt;
 }
 
 void mipsPipelined::executeADD()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 
-	innerRegs->EXMEM_setAluRes( add(rt,rs) );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = add(rt,rs);
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeADDU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( rt + rs );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs()) ;
+	next.exmem.aluRes = rt + rs;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSUB()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 
-	innerRegs->EXMEM_setAluRes( subtract(rs,rt) );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = subtract(rs,rt);
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSUBU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( rs - rt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = rs - rt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeAND()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( rs & rt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = rs & rt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeOR()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( rs | rt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = rs | rt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeXOR()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( rs ^ rt );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );	
+	next.exmem.aluRes = rs ^ rt;
+	next.exmem.dest = cur.idex.dest;	
 }
 
 void mipsPipelined::executeNOR()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( ~(rs | rt) );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = ~(rs | rt);
+	next.exmem.dest = cur.idex.dest;
 }
 
 
 void mipsPipelined::executeSLT()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( (rs<rt) ? 1U : 0 );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = (rs<rt) ? 1U : 0;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSLTU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 	
-	innerRegs->EXMEM_setAluRes( (rs<rt) ? 1U : 0  );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	next.exmem.aluRes = (rs<rt) ? 1U : 0;
+	next.exmem.dest = cur.idex.dest;
 }
 
 
 void mipsPipelined::executeMADD()
 {
 	//TODO -> Tsekare an einai swsta ta orismata signed - unsigned (dimitris)
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
-	uint64_t lo = (uint64_t) innerRegs->IDEX_getLO();
-	uint64_t hi =  ( (uint64_t) innerRegs->IDEX_getHI() ) << 32  ;
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
+	uint64_t lo = (uint64_t) cur.idex.lo;
+	uint64_t hi =  ( (uint64_t) cur.idex.hi ) << 32  ;
 
 	int64_t result = (int64_t) rs * rt;
 	int64_t hi_lo = ( hi | lo );
 	result += hi_lo;
 
-	innerRegs->EXMEM_setAluRes(result && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((result >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) result;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( result >> 32 ); // Stores into that register the result for HI
 }
 
 void mipsPipelined::executeMADDU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
-	uint64_t lo = (uint64_t) innerRegs->IDEX_getLO();
-	uint64_t hi =  ( (uint64_t) innerRegs->IDEX_getHI() ) << 32  ;
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
+	uint64_t lo = (uint64_t) cur.idex.lo;
+	uint64_t hi =  ( (uint64_t) cur.idex.hi ) << 32  ;
 
-	uint64_t result = rs * rt;
+	uint64_t result = (uint64_t) rs * rt;
 	uint64_t hi_lo = ( hi | lo );
 	result += hi_lo;
 
-	innerRegs->EXMEM_setAluRes(result && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((result >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) result;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( result >> 32 ); // Stores into that register the result for HI
 }
 
 void mipsPipelined::executeMUL()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
 
-	int64_t result = rs * rt;
+	int64_t result = (int64_t) rs * rt;
 
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
-	innerRegs->EXMEM_setAluRes(result && 0xffffffff);  // Stores into that register the result for register rd
+	next.exmem.dest = cur.idex.dest;
+	next.exmem.aluRes = (uint32_t) result;  // Stores into that register the result for register rd
 }
 
 void mipsPipelined::executeMSUB()
 {
 	//TODO -> Tsekare an einai swsta ta orismata signed - unsigned (dimitris)
 
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	int32_t rt = (int32_t) innerRegs->IDEX_getRT();
-	uint64_t lo = (uint64_t) innerRegs->IDEX_getLO();
-	uint64_t hi =  ( (uint64_t) innerRegs->IDEX_getHI() ) << 32  ;
+	int32_t rs = (int32_t) cur.idex.rs;
+	int32_t rt = (int32_t) cur.idex.rt;
+	uint64_t lo = (uint64_t) cur.idex.lo;
+	uint64_t hi =  ( (uint64_t) cur.idex.hi ) << 32  ;
 
-	int64_t result = (int32_t) rs * rt;
+	int64_t result = (int64_t) rs * rt;
 	int64_t hi_lo = ( hi | lo );
 	hi_lo -= result;
 	
-	innerRegs->EXMEM_setAluRes(hi_lo && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((hi_lo >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) hi_lo;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( hi_lo >> 32 ); // Stores into that register the result for HI
 }
 
 
 void mipsPipelined::executeMSUBU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 
-	uint64_t result = rs * rt;
-	uint64_t lo = (uint64_t) innerRegs->IDEX_getLO();
-	uint64_t hi =  ( (uint64_t) innerRegs->IDEX_getHI() ) << 32  ;
+	uint64_t result = (uint64_t) rs * rt;
+	uint64_t lo = (uint64_t) cur.idex.lo;
+	uint64_t hi =  ( (uint64_t) cur.idex.hi ) << 32  ;
 
 	uint64_t hi_lo = ( hi | lo );
 
 	hi_lo -= result;
 
-	innerRegs->EXMEM_setAluRes(hi_lo && 0xffffffff);  // Stores into that register the result for LO
-	innerRegs->EXMEM_setAluRes2((hi_lo >> 32 ) && 0xffffffff); // Stores into that register the result for HI
+	next.exmem.aluRes = (uint32_t) hi_lo;  // Stores into that register the result for LO
+	next.exmem.aluRes2 = (uint32_t)( hi_lo >> 32 ); // Stores into that register the result for HI
 }
 
 void mipsPipelined::executeCLZ()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
+	uint32_t rs = cur.idex.rs;
 	uint32_t count = 0;
 
-	__asm__("again1:");
-	rs<<1;
-	__asm__("jc stop1");
-	count++;
-	__asm__("jmp again1");
-	__asm__("stop1:");
+	while( count < 32 && !( rs & 0x80000000 ) ) {
+		rs <<= 1;
+		count++;
+	}
 
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
-	innerRegs->EXMEM_setAluRes( count ); // Stores into that register the result for register rd
+	next.exmem.dest = cur.idex.dest;
+	next.exmem.aluRes = count; // Stores into that register the result for register rd
 }
 
 void mipsPipelined::executeCLO()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
+	uint32_t rs = cur.idex.rs;
 	uint32_t count = 0;
 
-	__asm__("again2:");
-	rs<<1;
-	__asm__("jnc stop2");
-	count++;
-	__asm__("jmp again2");
-	__asm__("stop2:");
+	while( count < 32 && ( rs & 0x80000000 ) ) {
+		rs <<= 1;
+		count++;
+	}
 
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
-	innerRegs->EXMEM_setAluRes( count );
+	next.exmem.dest = cur.idex.dest;
+	next.exmem.aluRes = count;
 }
 
 void mipsPipelined::executeMOVZ()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 
-	innerRegs->EXMEM_setAluRes( (rt == 0) ? 1U :0 ) ; // Stores the comparison's result, in order to have it at WB stage
-	innerRegs->EXMEM_setAluRes2(rs); 				// Stores rs' value in order to have it at WB stage.
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs()) ;
+	next.exmem.aluRes = (rt == 0) ? 1U :0; // Stores the comparison's result, in order to have it at WB stage
+	next.exmem.aluRes2 = rs; 				// Stores rs' value in order to have it at WB stage.
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeMOVN()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	uint32_t rt = innerRegs->IDEX_getRT();
-
-	innerRegs->EXMEM_setAluRes( (rt != 0) ? 1U :0 ) ; // Stores the comparison's result, in order to have it at WB stage
-	innerRegs->EXMEM_setAluRes2(rs); // Stores rs' value in order to have it at WB stage.
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs()) ;
-}
-
-void mipsPipelined::executeJ()
-{
-	//TODO
-}
-
-void mipsPipelined::executeJAL()
-{
-	//TODO
-}
+	uint32_t rs = cur.idex.rs;
+	uint32_t rt = cur.idex.rt;
 
-//TODO -> Fix branch cases, ask teammates for MIPS's delay slots issue.
-void mipsPipelined::executeBEQ()
-{
-	//TODO	
-}
-
-void mipsPipelined::executeBNE()
-{
-	//TODO	
-}
-
-void mipsPipelined::executeBLEZ()
-{
-	//TODO	
-}
-
-void mipsPipelined::executeBGEZ()
-{
-	//TODO	
+	next.exmem.aluRes = (rt != 0) ? 1U :0; // Stores the comparison's result, in order to have it at WB stage
+	next.exmem.aluRes2 = rs; // Stores rs' value in order to have it at WB stage.
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeADDI()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( add( signExtend( (int16_t) innerRegs->IDEX_getImmed() ), rs ) );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	int32_t rs = (int32_t) cur.idex.rs;
+	next.exmem.aluRes = add( signExtend( (int16_t) cur.idex.immed ), rs );
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeADDIU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( rs + signExtend( (int16_t) innerRegs->IDEX_getImmed() ) );
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = rs + signExtend( (int16_t) cur.idex.immed );
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeSLTI()
 {
-	int32_t rs = (int32_t) innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( ( rs < signExtend( (int16_t) innerRegs->IDEX_getImmed() )  )  ? 1U : 0  );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );	
+	int32_t rs = (int32_t) cur.idex.rs;
+	next.exmem.aluRes = ( rs < signExtend( (int16_t) cur.idex.immed )  )  ? 1U : 0;
+	next.exmem.dest = cur.idex.dest;	
 }
 
 void mipsPipelined::executeSLTIU()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( ( rs < (uint32_t) innerRegs->IDEX_getImmed()   )  ? 1U : 0  );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = ( rs < (uint32_t) cur.idex.immed   )  ? 1U : 0;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeANDI()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( rs & (uint32_t) innerRegs->IDEX_getImmed()  );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = rs & (uint32_t) cur.idex.immed;
+	next.exmem.dest = cur.idex.dest;
 }
 
 
 void mipsPipelined::executeORI()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( rs | (uint32_t) innerRegs->IDEX_getImmed()  );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = rs | (uint32_t) cur.idex.immed;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeXORI()
 {
-	uint32_t rs = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( ( rs ^ (uint32_t) innerRegs->IDEX_getImmed() ) );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
+	uint32_t rs = cur.idex.rs;
+	next.exmem.aluRes = ( rs ^ (uint32_t) cur.idex.immed );
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeLUI()
 {
-	uint32_t res = (uint32_t) innerRegs->IDEX_getImmed();
-	innerRegs->EXMEM_setAluRes( res << 16 );
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() );
+	uint32_t res = (uint32_t) cur.idex.immed;
+	next.exmem.aluRes = res << 16;
+	next.exmem.dest = cur.idex.dest;
 }
 
 void mipsPipelined::executeLB()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 void mipsPipelined::executeLH()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass halfword's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs( innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass halfword's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 void mipsPipelined::executeLWL()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass word's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass word's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 
 void mipsPipelined::executeLW()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass word's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass word's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 
 void mipsPipelined::executeLBU()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 
 void mipsPipelined::executeLHU()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass halfword's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass halfword's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 
 void mipsPipelined::executeLWR()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass words's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass words's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 void mipsPipelined::executeSB()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt && 0xff );
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt & 0xff;
 }
 
 void mipsPipelined::executeSH()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt && 0xffff );
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt & 0xffff;
 }
 
 void mipsPipelined::executeSWL()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt );
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt;
 }
 
 void mipsPipelined::executeSW()
 {
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	int32_t base = innerRegs->IDEX_getRS();
-	innerRegs->EXMEM_setAluRes( base + offset );  
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt );
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	int32_t base = cur.idex.rs;
+	next.exmem.aluRes = base + offset;  
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt;
 }
 
 void mipsPipelined::executeSWR()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt );
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt;
 }
 
 void mipsPipelined::executeLL()
 {
-	int32_t base = innerRegs->IDEX_getRS();
-	int32_t offset = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( base + offset );  // pass byte's address at EXMEM register
-	innerRegs->EXMEM_setDestRegs(innerRegs->IDEX_getDestRegs() ); 
+	int32_t base = cur.idex.rs;
+	int32_t offset = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = base + offset;  // pass byte's address at EXMEM register
+	next.exmem.dest = cur.idex.dest; 
 }
 
 void mipsPipelined::executeSC()
 {
-	int32_t addr = (int32_t) signExtend( (int16_t) innerRegs->IDEX_getImmed() );
-	innerRegs->EXMEM_setAluRes( addr );  
-	uint32_t rt = innerRegs->IDEX_getRT();
-	innerRegs->EXMEM_setStoreData( rt );
+	int32_t addr = (int32_t) signExtend( (int16_t) cur.idex.immed );
+	next.exmem.aluRes = addr;  
+	uint32_t rt = cur.idex.rt;
+	next.exmem.storeData = rt;
+}
+
+void mipsPipelined::executeMFC0()
+{
+	next.exmem.aluRes = readCP0( RD( stage( EX ).cmd ) );
+	next.exmem.dest = cur.idex.dest;
+}
+
+void mipsPipelined::executeMTC0()
+{
+	next.exmem.aluRes = cur.idex.rt;
+	next.exmem.dest = cur.idex.dest;
 }
 
 
@@ -966,100 +1428,76 @@ void mipsPipelined::executeSC()
 
 void mipsPipelined::memory()
 {
-	uint32_t op = OP( cmd[MEM] );
-	if( op == RTYPE1 ) {
-		switch( FUNCT( cmd[MEM] ) ) {		
-
-			case( SLL ): memorySLL(); break;
-			case( SRL ): memorySRL(); break;
-			case( SRA ): memorySRA(); break;
-			case( SLLV ): memorySLLV(); break;
-			case( SRLV ): memorySRLV(); break;
-			case( SRAV ): memorySRAV(); break;
-			case( JR ): memoryJR(); break;
-			case( JALR ): memoryJALR(); break;
-			case( BREAK ): memoryBREAK(); break;
-			case( MFHI ): memoryMFHI(); break;
-			case( MTHI ): memoryMTHI(); break;
-			case( MFLO ): memoryMFLO(); break;
-			case( MTLO ): memoryMTLO(); break;
-			case( MULT ): memoryMULT(); break;
-			case( MULTU ): memoryMULTU(); break;
-			case( DIV ): memoryDIV(); break;
-			case( DIVU ): memoryDIVU(); break;
-			case( ADD ): memoryADD(); break;
-			case( ADDU ): memoryADDU(); break;
-			case( SUB ): memorySUB(); break;
-			case( SUBU ): memorySUBU(); break;
-			case( AND ): memoryAND(); break;
-			case( OR ): memoryOR(); break;
-			case( XOR ): memoryXOR(); break;
-			case( NOR ): memoryNOR(); break;
-			case( SLT ): memorySLT(); break;
-			case( SLTU ): memorySLTU(); break;
-			default:
-				throw "Unhandled operation MEM";
-		}
-			
-	} else if ( op == RTYPE2 ) {
-	
-		//RTYPE2 operations
-		switch( FUNCT( cmd[EX] ) ) {
-			case( MADD ): memoryMADD(); break;
-			case( MADDU ): memoryMADDU(); break;
-			case( MUL ): memoryMUL(); break;
-			case( MSUB ): memoryMSUB(); break;
-			case( MSUBU ): memoryMSUBU(); break;
-			case( CLZ ): memoryCLZ(); break;
-			case( CLO ): memoryCLO(); break;
-			case( MOVZ ): memoryMOVZ(); break;
-			case( MOVN ): memoryMOVN(); break;
-			default:
-				throw "Unhandled operation MEM";
-		}
+	const instrDesc *d = stage( MEM ).desc;
+	if( d->memory != NULL )
+		( this->*d->memory )();
 
-	} else if ( op == J ) { //the two JTYPE operations are following
-		
-	} else if ( op == JAL ) {
+	/*
+	 * The address is still in the latch, faulting accesses
+	 * never reach the cache. Loads carry their pc down for
+	 * the prefetchers, it came along the ring from IF.
+	 */
+	if( d->access == ACCESS_NONE || mem->fault() != NO_FAULT )
+		return;
+	if( tracer != NULL )
+		traceAccess( stage( MEM ), d->access, cur.exmem.aluRes );
+	if( lsu != NULL )
+		accessNonBlocking( stage( MEM ), d->access, cur.exmem.aluRes );
+	else if( l1d != NULL ) {
+		bool load = d->access == ACCESS_READ;
+		uint32_t lat = l1d->access( cur.exmem.aluRes, !load, load ? stage( MEM ).pc : NO_PC, cycles );
+		memWait = ( lat > 1 ) ? lat - 1 : 0;
+	}
+}
 
-	// TODO -> simplirwse J kai JAL
+/*
+ * The value is loaded already, only its register is marked
+ * as not there until the line is. Without a miss it is
+ * there next cycle, as MEM->EX would have it.
+ */
+void mipsPipelined::accessNonBlocking( const stageEntry &m, uint8_t access, uint32_t addr )
+{
+	if( access == ACCESS_WRITE ) {
+		memWait = lsu->store( addr, cycles );
+		return;
+	}
 
+	uint64_t ready;
+	memWait = lsu->load( addr, m.pc, cycles, ready );
+	if( ready > cycles + memWait + 1 )
+		for( uint64_t w=m.writes; w != 0; w &= w - 1 ) {
+			int r = __builtin_ctzll( w );
+			missRegs |= 1ULL << r;
+			missReady[r] = ready;
+		}
+}
 
-	} else { //ITYPE here
+//the bytes the handler touched, a failed SC touches none
+void mipsPipelined::traceAccess( const stageEntry &m, uint8_t access, uint32_t addr )
+{
+	uint8_t size = 4;
+	switch( m.desc->size ) {
+		case SIZE_BYTE: size = 1; break;
+		case SIZE_HALF: size = 2; break;
+		case SIZE_LEFT: size = 4 - addr % 4; break;
+		case SIZE_RIGHT:
+			size = 1 + addr % 4;
+			addr -= addr % 4;
+			break;
+		case SIZE_COND:
+			if( ll != 1 )
+				return;
+			break;
+	}
+	tracer->record( ( access == ACCESS_READ ) ? TRACE_READ : TRACE_WRITE, m.pc, addr, size, cycles );
+}
 
-		switch( op ) {
-			case( BGEZ ):
-				//TODO: handle case of BGEZ, BGEZAL, BLTZAL, BLTZ
-				break;
-			case( BEQ ): memoryBEQ(); break;
-			case( BNE ): memoryBNE(); break;
-			case( BLEZ ): memoryBLEZ(); break;
-			case( BGTZ ): memoryBGEZ(); break;
-			case( ADDI ): memoryADDI(); break;
-			case( ADDIU ): memoryADDIU(); break;
-			case( SLTI ): memorySLTI(); break;
-			case( SLTIU ): memorySLTIU(); break;
-			case( ANDI ): memoryANDI(); break;
-			case( ORI ): memoryORI(); break;
-			case( XORI ): memoryXORI(); break;
-			case( LUI ): memoryLUI(); break;
-			case( LB ): memoryLB(); break;
-			case( LH ): memoryLH(); break;
-			case( LWL ): memoryLWL(); break;
-			case( LW ): memoryLW(); break;
-			case( LBU ): memoryLBU(); break;
-			case( LHU ): memoryLHU(); break;
-			case( LWR ): memoryLWR(); break;
-			case( SB ): memorySB(); break;
-			case( SH ): memorySH(); break;
-			case( SWL ): memorySWL(); break;
-			case( SW ): memorySW(); break;
-			case( SWR ): memorySWR(); break;
-			case( LL ): memoryLL(); break;
-			case( SC ): memorySC(); break;
-			default:
-				throw "Unhandled operation MEM";
-		} 	
+void mipsPipelined::retireMisses()
+{
+	for( uint64_t w=missRegs; w != 0; w &= w - 1 ) {
+		int r = __builtin_ctzll( w );
+		if( missReady[r] <= cycles )
+			missRegs &= ~( 1ULL << r );
 	}
 }
 
@@ -1067,383 +1505,351 @@ void mipsPipelined::memory()
 //in memory stage.
 void mipsPipelined::memorySLL()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySRL()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySRA()
 {	
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySLLV()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySRLV()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySRAV()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
-void mipsPipelined::memoryJR()
+void mipsPipelined::memoryLink()
 {
-	//TODO
-}
-
-void mipsPipelined::memoryJALR()
-{
-	//TODO
-}
-
-void mipsPipelined::memoryBREAK()
-{
-	//TODO
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryMFHI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryMTHI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
+	next.memwb.alu = cur.exmem.aluRes;
 }
 
 void mipsPipelined::memoryMFLO()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryMTLO()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
+	next.memwb.alu = cur.exmem.aluRes;
 }
 
 void mipsPipelined::memoryMULT()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 
 }
 
 void mipsPipelined::memoryMULTU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 }
 
 void mipsPipelined::memoryDIV()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 
 }
 
 void mipsPipelined::memoryDIVU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 
 }
 
 void mipsPipelined::memoryADD()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryADDU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySUB()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySUBU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryAND()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryOR()
 {
 
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryXOR()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryNOR()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 
 void mipsPipelined::memorySLT()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySLTU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 
 void mipsPipelined::memoryMADD()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 }
 
 void mipsPipelined::memoryMADDU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 }
 
 void mipsPipelined::memoryMUL()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryMSUB()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 }
 
 
 void mipsPipelined::memoryMSUBU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
 }
 
 void mipsPipelined::memoryCLZ()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryCLO()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 
 void mipsPipelined::memoryMOVZ()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryMOVN()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setAlu2( innerRegs->EXMEM_getAluRes2() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
-}
-
-
-// TODO -> simplirwse J kai JAL
-
-
-void mipsPipelined::memoryBEQ()
-{
-
-}
-
-void mipsPipelined::memoryBNE()
-{
-
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.alu2 = cur.exmem.aluRes2;
+	next.memwb.dest = cur.exmem.dest;
 }
 
-void mipsPipelined::memoryBLEZ()
-{
-
-}
-
-void mipsPipelined::memoryBGEZ()
-{
-
-}
 
 void mipsPipelined::memoryADDI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );	
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;	
 }
 
 void mipsPipelined::memoryADDIU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );;
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySLTI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySLTIU()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryANDI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 
 void mipsPipelined::memoryORI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 
 }
 
 void mipsPipelined::memoryXORI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLUI()
 {
-	innerRegs->MEMWB_setAlu( innerRegs->EXMEM_getAluRes() );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLB()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint8_t val = mem->loadByte( addr );
-	innerRegs->MEMWB_setMem( signExtend( (int8_t)val ) );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = signExtend( (int8_t)val );
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLH()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint16_t val = mem->loadHalfWord( addr );
-	innerRegs->MEMWB_setMem( signExtend( (int16_t)val ) );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = signExtend( (int16_t)val );
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLWL() 
 {
 	uint32_t res = 0;
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint8_t bytes = 4 - addr%4;
 	for( int i=1; i<=bytes; ++i ) {
 		res = res | ( ( (uint32_t) mem->loadByte( addr ) ) << ( (4-i)*8 ) ); 
 		addr++;
 	}
-	innerRegs->MEMWB_setMem( res );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = res;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLW()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint32_t val = mem->loadWord( addr );
-	innerRegs->MEMWB_setMem( val );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = val;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLBU()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint8_t val = mem->loadByte( addr );
-	innerRegs->MEMWB_setMem( (uint32_t)val );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = (uint32_t)val;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLHU()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint16_t val = mem->loadHalfWord( addr );
-	innerRegs->MEMWB_setMem( (uint32_t) val  );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = (uint32_t) val;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memoryLWR()
 {
 	uint32_t res = 0;
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint8_t bytes = 1 + addr%4;
 	for( int i=0; i<bytes; ++i ) {
 		res = res | ( mem->loadByte( addr ) << (i*8) );
 		addr--;
 	}
-	innerRegs->MEMWB_setMem( res );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = res;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 void mipsPipelined::memorySB()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	mem->storeByte( addr,  (uint8_t) data );
 }
 
 void mipsPipelined::memorySH()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	mem->storeHalfWord( addr, (uint16_t) data);
 }
 
 void mipsPipelined::memorySWL()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	uint8_t bytes = 4 - addr%4;
 	for( int i=1; i<=bytes; ++i ) {
 		mem->storeByte( addr, ( data >> ((4-i)*8) ) & 0xff );
@@ -1452,14 +1858,14 @@ void mipsPipelined::memorySWL()
 }
 void mipsPipelined::memorySW()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	mem->storeWord( addr,data );
 }
 void mipsPipelined::memorySWR()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	uint8_t bytes = 1 + addr%4;
 	for( int i=0; i<bytes; ++i ) {
 		mem->storeByte( addr, ( data >> (i*8) ) & 0xff );
@@ -1469,22 +1875,34 @@ void mipsPipelined::memorySWR()
 
 void mipsPipelined::memoryLL() 
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
+	uint32_t addr = cur.exmem.aluRes;
 	uint32_t val = mem->loadWord( addr );
-	innerRegs->MEMWB_setMem( val );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.mem = val;
+	next.memwb.dest = cur.exmem.dest;
 	ll = 1;
 }
 
 void mipsPipelined::memorySC()
 {
-	uint32_t addr = innerRegs->EXMEM_getAluRes();
-	uint32_t data = innerRegs->EXMEM_getStoreData();
+	uint32_t addr = cur.exmem.aluRes;
+	uint32_t data = cur.exmem.storeData;
 	if( ll == 1 ) 
 		mem->storeWord( addr,data );
 
-	innerRegs->MEMWB_setAlu( ll );
-	innerRegs->MEMWB_setDestRegs( innerRegs->EXMEM_getDestRegs() );
+	next.memwb.alu = ll;
+	next.memwb.dest = cur.exmem.dest;
+}
+
+void mipsPipelined::memoryMFC0()
+{
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
+}
+
+void mipsPipelined::memoryMTC0()
+{
+	next.memwb.alu = cur.exmem.aluRes;
+	next.memwb.dest = cur.exmem.dest;
 }
 
 
@@ -1496,94 +1914,9 @@ void mipsPipelined::memorySC()
 
 void mipsPipelined::writeback() 
 {
-	uint32_t op = OP( cmd[WB] );
-	if( op == RTYPE1 ) {
-
-		//RTYPE1 operations
-		switch( FUNCT( cmd[WB] ) ) {
-			case( SLL ): writebackSLL(); break;
-			case( SRL ): writebackSRL(); break;
-			case( SRA ): writebackSRA(); break;
-			case( SLLV ): writebackSLLV(); break;
-			case( SRLV ): writebackSRLV(); break;
-			case( SRAV ): writebackSRAV(); break;
-			//case( JR ): executeJR(); break;
-			//case( JALR ): executeJAR(); break;
-			//case( BREAK ): executeBREAK(); break;
-			case( MFHI ): writebackMFHI(); break;
-			case( MTHI ): writebackMTHI(); break;
-			case( MFLO ): writebackMFLO(); break;
-			case( MTLO ): writebackMTLO(); break;
-			case( MULT ): writebackMULT(); break;
-			case( MULTU ): writebackMULTU(); break;
-			case( DIV ): writebackDIV(); break;
-			case( DIVU ): writebackDIVU(); break;
-			case( ADD ): writebackADD(); break;
-			case( ADDU ): writebackADDU(); break;
-			case( SUB ): writebackSUB(); break;
-			case( SUBU ): writebackSUBU(); break;
-			case( AND ): writebackAND(); break;
-			case( OR ): writebackOR(); break;
-			case( XOR ): writebackXOR(); break;
-			case( NOR ): writebackNOR(); break;
-			case( SLT ): writebackSLT(); break;
-			case( SLTU ): writebackSLTU(); break;
-			default:
-				throw "Unhandled operation WB";
-		} 
-
-	} else if ( op == RTYPE2 ) {
-	
-		//RTYPE2 operations
-		switch( FUNCT( cmd[WB] ) ) {
-			case( MADD ): writebackMADD(); break;
-			case( MADDU ): writebackMADDU(); break;
-			case( MUL ): writebackMUL(); break;
-			case( MSUB ): writebackMSUB(); break;
-			case( MSUBU ): writebackMSUBU(); break;
-			case( CLZ ): writebackCLZ(); break;
-			case( CLO ): writebackCLO(); break;
-			case( MOVZ ): writebackMOVZ(); break;
-			case( MOVN ): writebackMOVN(); break;
-			default:
-				throw "Unhandled operation WB";
-		}
-
-	} else if ( op == J ) { //the two JTYPE operations are following
-		
-	} else if ( op == JAL ) {
-
-
-	} else { //ITYPE here
-		
-		switch( op ) {
-			case( ADDI ): writebackADDI(); break;
-			case( ADDIU ): writebackADDIU(); break;
-			case( SLTI ): writebackSLTI(); break;
-			case( SLTIU ): writebackSLTIU(); break;
-			case( ANDI ): writebackANDI(); break;
-			case( ORI ): writebackORI(); break;
-			case( XORI ): writebackXORI(); break;
-			case( LUI ): writebackLUI(); break;
-			case( LB ): writebackLB(); break;
-			case( LH ): writebackLH(); break;
-			case( LWL ): writebackLWL(); break;
-			case( LW ): writebackLW(); break;
-			case( LBU ): writebackLBU(); break;
-			case( LHU ): writebackLHU(); break;
-			case( LWR ): writebackLWR(); break;
-			case( LL ): writebackLL(); break;		//???
-			case( SC ): writebackSC(); break;
-			case( SB ): writebackSB(); break;
-			case( SH ): writebackSH(); break;
-			case( SWL ): writebackSWL(); break;
-			case( SW ): writebackSW(); break;
-			case( SWR ): writebackSWR(); break;
-			default:
-				throw "Unhandled operation WB";
-		} 	
-	}
-
+	stageHandler h = stage( WB ).desc->writeback;
+	if( h != NULL )
+		( this->*h )();
 }
 
 
@@ -1609,269 +1942,293 @@ alla rwta teammates an toulaxiston eksasfalizw orthotita
 
 void mipsPipelined::writebackSLL()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSRL()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSRA()
 {	
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSLLV()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSRLV()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSRAV()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
+}
+
+void mipsPipelined::writebackLink()
+{
+	reg->setReg( stage( WB ).dstRegs[0], cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMFHI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMTHI()
 {
-	reg->setHI( innerRegs->MEMWB_getAlu() );
+	reg->setHI( cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMFLO()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMTLO()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
+	reg->setLO( cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMULT()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackMULTU()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackDIV()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 
 }
 
 void mipsPipelined::writebackDIVU()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackADD()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackADDU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSUB()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSUBU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackAND()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackOR()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackXOR()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackNOR()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSLT()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSLTU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMADD()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 
 }
 
 void mipsPipelined::writebackMADDU()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI(  innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI(  cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackMUL()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackMSUB()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 }
 
 
 void mipsPipelined::writebackMSUBU()
 {
-	reg->setLO( innerRegs->MEMWB_getAlu() );
-	reg->setHI( innerRegs->MEMWB_getAlu2() );
+	reg->setLO( cur.memwb.alu );
+	reg->setHI( cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackCLZ()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 	
 }
 
 void mipsPipelined::writebackCLO()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rd, cur.memwb.alu );
 }
 
 
 void mipsPipelined::writebackMOVZ()
 {
-	if ( innerRegs->MEMWB_getAlu() == 1 )
-		reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu2() );
+	if ( cur.memwb.alu == 1 )
+		reg->setReg( cur.memwb.dest.rd, cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackMOVN()
 {
-	if ( innerRegs->MEMWB_getAlu() == 1 )
-		reg->setReg( innerRegs->MEMWB_getDestRegRD(), innerRegs->MEMWB_getAlu2() );
+	if ( cur.memwb.alu == 1 )
+		reg->setReg( cur.memwb.dest.rd, cur.memwb.alu2 );
 }
 
 void mipsPipelined::writebackADDI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackADDIU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSLTI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackSLTIU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackANDI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackORI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackXORI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 
 void mipsPipelined::writebackLUI()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
 }
 
 void mipsPipelined::writebackLB()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLH()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLWL() 
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLW()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLBU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLHU()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 
 }
 
 void mipsPipelined::writebackLWR()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackLL() 
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getMem() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.mem );
 }
 
 void mipsPipelined::writebackSC()
 {
-	reg->setReg( innerRegs->MEMWB_getDestRegRT(), innerRegs->MEMWB_getAlu() );
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
+}
+
+void mipsPipelined::writebackMFC0()
+{
+	reg->setReg( cur.memwb.dest.rt, cur.memwb.alu );
+}
+
+void mipsPipelined::writebackMTC0()
+{
+	writeCP0( cur.memwb.dest.rd, cur.memwb.alu );
+}
+
+//back to EPC out of the exception level, what was fetched after ERET is dropped
+void mipsPipelined::writebackERET()
+{
+	pc = epc;
+	status &= ~EL;
+	updateInterrupts();
+	flushYounger();
 }
 
 /*
@@ -7,7 +7,12 @@
 
 #include "pipelineRegisters.h"
 #include "processor.h"
+#include "branchPredictor.h"
+#include "../memory/cache.h"
+#include "../memory/trace.h"
 #include <stdio.h>
+#include <string.h>
+#include <string>
 
 #define STAGES 5
 #define IF  0
@@ -16,6 +21,155 @@
 #define MEM 3
 #define WB  4
 
+//slots of the ring, a power of two with room for STAGES
+#define RING_SIZE 8
+#define RING_MASK ( RING_SIZE - 1 )
+
+//registers in the scoreboard masks: the GPRs, LO_REG, HI_REG and CP0_REG
+#define SCOREBOARD_REGS 64
+
+//one scoreboard bit for all of coprocessor 0
+#define CP0_REG 34
+
+//general exception vector, no handler unless it is in the text area
+#define EXC_VECTOR 0x80000180
+
+//exc of an instruction without an exception
+#define NO_EXCEPTION -1
+
+//bypass paths, see setBypass()
+#define BYPASS_EX_EX	1	//EX/MEM latch to EX
+#define BYPASS_MEM_EX	2	//MEM/WB latch to EX
+#define BYPASS_WB_ID	4	//register file written before ID reads it
+#define BYPASS_ALL	( BYPASS_EX_EX | BYPASS_MEM_EX | BYPASS_WB_ID )
+
+//where the result of an instruction can be forwarded from
+typedef enum {
+	RESULT_ALU,	//computed in EX: exmem.aluRes(2), then memwb.alu(2)
+	RESULT_LOAD,	//loaded in MEM: memwb.mem
+	RESULT_MEM,	//computed in MEM (SC): memwb.alu
+	RESULT_NONE	//conditional write, never forwarded
+} resultKind;
+
+//register named by a field of the instruction, or a fixed one
+typedef enum {
+	ROLE_NONE,
+	ROLE_RS,
+	ROLE_RT,
+	ROLE_RD,
+	ROLE_LO,
+	ROLE_HI,
+	ROLE_CP0,
+	ROLE_RA		//$31, linked by JAL, BLTZAL and BGEZAL
+} regRole;
+
+//how an instruction changes the flow, and where it is resolved
+typedef enum {
+	CTRL_NONE,
+	CTRL_BRANCH,	//compares registers, in the stage of setBranchStage()
+	CTRL_JUMP,	//target in the instruction, always in ID
+	CTRL_JUMP_REG	//target in rs, in the stage of setBranchStage()
+} controlKind;
+
+//what an instruction asks of the data cache in MEM
+typedef enum {
+	ACCESS_NONE,
+	ACCESS_READ,
+	ACCESS_WRITE
+} memAccess;
+
+//bytes an access touches, the unaligned ones depend on the address
+typedef enum {
+	SIZE_WORD,
+	SIZE_BYTE,
+	SIZE_HALF,
+	SIZE_LEFT,	//LWL and SWL, from the address to the end of its word
+	SIZE_RIGHT,	//LWR and SWR, from the start of the word to the address
+	SIZE_COND	//SC, a word if it stored, nothing if it failed
+} accessSize;
+
+class mipsPipelined;
+
+//what an instruction does in one stage, NULL if nothing
+typedef void ( mipsPipelined::*stageHandler )();
+
+/*
+ * Everything the pipeline needs to know about an
+ * instruction, looked up once when it is fetched.
+ */
+struct instrDesc {
+	stageHandler execute;
+	stageHandler memory;
+	stageHandler writeback;
+	uint8_t src[2];		//regRole
+	uint8_t dst[2];
+	uint8_t result;		//resultKind
+	uint64_t implicitReads;	//LO and HI for the accumulating multiplies
+	uint8_t control;	//controlKind
+	uint8_t access;		//memAccess
+	uint8_t size;		//accessSize
+};
+
+//state of one instruction in the pipe
+struct stageEntry {
+	uint32_t cmd;
+	uint32_t pc;
+	const instrDesc *desc;
+	uint32_t srcRegs[2];
+	uint32_t dstRegs[2];
+	uint64_t reads;		//bit n set if register n is read
+	uint64_t writes;	//and written
+	uint8_t result;		//resultKind
+	bool valid;
+	bool delaySlot;		//fetched right after a branch or jump
+	bool predTaken;		//as predicted in IF, for branches and jumps
+	uint32_t predPc;	//where fetch went after it and its delay slot
+	uint32_t rasTop;	//of the return stack once it was fetched
+	int8_t exc;		//exception code to take in WB, or NO_EXCEPTION
+	uint32_t badAddr;	//for address errors
+};
+
+//why run() returned
+typedef enum {
+	RUN_DONE,	//the pipeline drained past the end of the text area
+	RUN_LIMIT,	//the cycles asked for were simulated
+	RUN_PC,		//runUntil() reached its pc
+	RUN_ERROR	//an exception without a handler stopped the pipeline, see runError()
+} runStatus;
+
+struct runResult {
+	runStatus status;
+	uint64_t cycles;	//simulated by this call
+	uint64_t instructions;	//retired by this call
+};
+
+/*
+ * Control hazards. Taken branches flush what was fetched
+ * after them, or after their delay slot, and branches
+ * resolved in ID wait for operands EX can not forward.
+ */
+struct branchStats {
+	uint64_t branches;	//conditional branches and JR/JALR
+	uint64_t taken;
+	uint64_t jumps;		//J and JAL
+	uint64_t mispredicted;	//of both, resolved elsewhere than fetch went
+	uint64_t flushed;	//wrong-path instructions, a cycle each
+	uint64_t operandStalls;	//cycles a branch waited to enter ID
+};
+
+/*
+ * Stall cycles, by the stage of the producer and the register
+ * waited for. The caches are counted apart, as the cycles IF
+ * had nothing to fetch and the pipe waited for MEM.
+ */
+struct stallStats {
+	uint64_t cycles;
+	uint64_t byStage[ STAGES ];
+	uint64_t byReg[ SCOREBOARD_REGS ];
+	uint64_t fetchCycles;
+	uint64_t memoryCycles;
+};
+
 
 class mipsPipelined : simpleProcessor {
 
@@ -23,51 +177,105 @@ public:
 	void reset(){};
 	void run();
 	void step();
+
+	/*
+	 * Step at most maxCycles times, or until the cycle that
+	 * fetches stopPc is over, with its instruction in IF.
+	 * That is also the case for the exception vector and the
+	 * EPC ERET returns to, fetched in the cycle that takes
+	 * them. Faults are not thrown, the status says how it
+	 * ended. step() throws runError() instead.
+	 */
+	runResult run( uint64_t maxCycles );
+	runResult runUntil( uint32_t stopPc, uint64_t maxCycles );
+
+	//why the pipeline stopped, for RUN_ERROR
+	const std::string &runError() const { return error; }
+
+	uint64_t cycleCount() const { return cycles; }
+	uint64_t retiredCount() const { return retired; }
 	void setTextArea( uint32_t, uint32_t ){};
 
 
 	//constructors and destructor
-	mipsPipelined() : simpleProcessor() {
-		
-		innerRegs = new intermediateRegisters();
-		cmd = new uint32_t[STAGES];
-		valid = new bool[STAGES];
-		srcRegs = new uint32_t*[STAGES];
-		dstRegs = new uint32_t*[STAGES];
-		dependence = false;
-
-		for( int i=0; i<STAGES; ++i ) {
-			srcRegs[i] = new uint32_t[2];
-			dstRegs[i] = new uint32_t[2];
-			cmd[i] = 0;
-			valid[i] = false;
-		}
-
-	}	
-
-	mipsPipelined( simpleMemory *mem, RegisterFile *reg, uint32_t startAddress, uint32_t endAddress ) : simpleProcessor( mem,reg,startAddress,endAddress ) {
-
-		innerRegs = new intermediateRegisters();
-		cmd = new uint32_t[STAGES];
-		valid = new bool[STAGES];
-		srcRegs = new uint32_t*[STAGES];
-		dstRegs = new uint32_t*[STAGES];
-		dependence = false;
-
-		for( int i=0; i<STAGES; ++i ) {
-			srcRegs[i] = new uint32_t[2];
-			dstRegs[i] = new uint32_t[2];
-			cmd[i] = 0;
-			valid[i] = false;
-		}
+	mipsPipelined() : simpleProcessor() { init(); }
+
+	mipsPipelined( Memory *mem, RegisterFile *reg, uint32_t startAddress, uint32_t endAddress ) : simpleProcessor( mem,reg,startAddress,endAddress ) {
+		init();
 	}
 
-	~mipsPipelined() 
-	{
-		delete[] cmd;
-		delete[] innerRegs;
+	~mipsPipelined() {}
+
+	const stallStats &stallCounts() const { return stalls; }
+
+	//BYPASS_* paths in use, all of them by default. 0 stalls on every dependence
+	void setBypass( unsigned paths ) { bypass = paths; }
+
+	/*
+	 * Branches and JR/JALR are resolved in EX by default, or
+	 * in ID by a comparator of their own, which is fed by the
+	 * EX/MEM latch when BYPASS_EX_EX is set. Fetch goes on at
+	 * pc+4 until then. With delay slots, as MIPS has them, the
+	 * instruction after a branch always runs. Set both before
+	 * the first cycle.
+	 */
+	void setBranchStage( int s ) { branchStage = s; }
+	void setDelaySlot( bool on ) { delaySlots = on; }
+	const branchStats &branchCounts() const { return branches; }
+
+	/*
+	 * Fetch follows p for the direction of conditional
+	 * branches, btb for the targets of taken ones and of
+	 * jumps, and ras for JR $31. Any can be NULL, without
+	 * all of them branches are predicted not taken. None
+	 * is owned by the pipeline.
+	 */
+	void setPredictor( branchPredictor *p, branchTargetBuffer *b, returnStack *r ) {
+		predictor = p;
+		btb = b;
+		ras = r;
 	}
 
+	/*
+	 * Fetch waits for l1i and loads and stores for l1d,
+	 * as many cycles as they take. A miss in MEM holds every
+	 * stage, a miss in IF only sends bubbles down. NULL is a
+	 * memory that always answers in the same cycle, as without
+	 * caches. Neither is owned by the pipeline.
+	 */
+	void setCaches( memoryLevel *l1i, memoryLevel *l1d ) {
+		this->l1i = l1i;
+		this->l1d = l1d;
+	}
+
+	/*
+	 * Loads and stores go through n instead of l1d. Only
+	 * a full MSHR file or store buffer holds the pipe, the
+	 * register of a load that missed is waited for in ID.
+	 */
+	void setNonBlocking( nonBlockingCache *n ) { lsu = n; }
+
+	/*
+	 * Every fetch and every load and store that does not
+	 * fault go to t with the pc and cycle. NULL records
+	 * nothing. Not owned.
+	 */
+	void setTracer( traceRecorder *t ) { tracer = t; }
+
+	/*
+	 * Exceptions and interrupts are taken when the instruction
+	 * reaches WB, everything younger is flushed and fetch goes
+	 * on at vector. Without a handler in the text area the
+	 * pipeline stops instead.
+	 */
+	void setExceptionVector( uint32_t vector ) { excVector = vector; }
+
+	//raise or lower one of the eight interrupt lines of cause
+	void setInterrupt( int line, bool on );
+
+	//CP0_* registers, as MFC0 sees them
+	uint32_t readCP0( uint32_t r ) const;
+
 	void showMemory( uint32_t start, uint32_t end ) {
 		mem->showMemory( start, end );
 	}
@@ -75,40 +283,139 @@ public:
 	void printRegisters() {
 		reg->printRegisters();
 		printf( "PC:\t%d\n", pc );
-		printf( "IF: %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
-					valid[IF] ? cmd[IF] : 0x00000000, ( valid[IF] )? "true" : "false", srcRegs[IF][0], srcRegs[IF][1], dstRegs[IF][0], dstRegs[IF][1] );
-		printf( "ID:  %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
-					valid[ID] ? cmd[ID] : 0x00000000, valid[ID] ? "true" : "false", srcRegs[ID][0], srcRegs[ID][1], dstRegs[ID][0], dstRegs[ID][1] );
-		printf( "EX:  %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
-					valid[EX] ? cmd[EX] : 0x00000000, valid[EX] ? "true" : "false", srcRegs[EX][0], srcRegs[EX][1], dstRegs[EX][0], dstRegs[EX][1] );
-		printf( "MEM: %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
-					valid[MEM] ? cmd[MEM] : 0x00000000, valid[MEM] ? "true" : "false", srcRegs[MEM][0], srcRegs[MEM][1], dstRegs[MEM][0], dstRegs[MEM][1] );
-		printf( "WB:  %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
-					valid[WB] ? cmd[WB] : 0x00000000, valid[WB] ? "true" : "false", srcRegs[WB][0], srcRegs[WB][1], dstRegs[WB][0], dstRegs[WB][1] );
+		printStage( "IF: ", IF );
+		printStage( "ID: ", ID );
+		printStage( "EX: ", EX );
+		printStage( "MEM:", MEM );
+		printStage( "WB: ", WB );
+	}
+
+private:
 
+	//latches between the stages, as of this cycle and as written for the next
+	pipelineLatches cur;
+	pipelineLatches next;
 
+	/*
+	 * In-flight instructions. Stage s holds ring[ head - s ],
+	 * so bumping head moves every instruction down the pipe.
+	 */
+	stageEntry ring[ RING_SIZE ];
+	size_t head;		//not uint32_t, stores into the ring can not alias it
 
-	
-}
+	stageEntry &stage( int s ) { return ring[ ( head - s ) & RING_MASK ]; }
 
-private:
+	void printStage( const char *name, int s ) {
+		stageEntry &e = stage( s );
+		printf( "%s %x,\tvalid: %s,\tsrc[0]: %d,\tsrc[1]: %d,\tdst[0]: %d,\tdst[1]: %d\n",
+					name, e.valid ? e.cmd : 0x00000000, e.valid ? "true" : "false", e.srcRegs[0], e.srcRegs[1], e.dstRegs[0], e.dstRegs[1] );
+	}
 
-	intermediateRegisters *innerRegs;
-	uint32_t *cmd;
-	bool *valid;
-	uint32_t **srcRegs;
-	uint32_t **dstRegs;
 	bool dependence;
+	bool branchWait;	//the branch in IF waits for its operands, see checkBranchOperands()
+	unsigned bypass;
+	uint64_t cycles;
+	uint64_t retired;
+	std::string error;
+	stallStats stalls;
+
+	int branchStage;
+	bool delaySlots;
+	bool fetchedControl;	//the last instruction fetched was a branch or jump
+	bool redirect;		//a branch taken this cycle, fetch goes on at redirectPc
+	uint32_t redirectPc;
+	int squash;		//stages younger than it
+	uint32_t rasTop;	//of the branch that redirects
+	bool slotPending;	//fetch goes to slotTarget after the delay slot
+	uint32_t slotTarget;
+	branchStats branches;
+
+	branchPredictor *predictor;
+	branchTargetBuffer *btb;
+	returnStack *ras;
+
+	memoryLevel *l1i;
+	memoryLevel *l1d;
+	uint32_t fetchWait;	//cycles until the line at pc is in
+	uint32_t memWait;	//cycles the access in MEM still takes
+	nonBlockingCache *lsu;
+	uint64_t missRegs;	//destinations of loads whose data is not there yet
+	uint64_t missReady[ SCOREBOARD_REGS ];	//the cycle it is
+	traceRecorder *tracer;
+
+	uint32_t excVector;
+	bool irqReady;		//an interrupt is pending, enabled and not masked
+	bool halted;		//an exception without a handler was taken
+
+	//for runUntil(): the pc to stop at, and whether fetch got to it
+	bool stopping;
+	uint32_t stopPc;
+	bool stopped;
+
+	void init();
+
+	//cause of the current stall, set by checkDependence()
+	int stallStage;
+	int stallReg;
+
 	int ll;
 
 
+	//descriptors of the I and J-type opcodes, and of the functs of both R-types
+	struct descTable {
+		instrDesc itype[ 64 ];
+		instrDesc rtype1[ 64 ];
+		instrDesc rtype2[ 64 ];
+		instrDesc regimmLink;	//BLTZAL and BGEZAL
+		instrDesc mfc0, mtc0, eret;
+		instrDesc excepted;	//what an instruction becomes once it raised an exception
+		constexpr descTable();
+	};
+	static const descTable descriptors;
+
+	const instrDesc &describe( uint32_t cmd ) const;
+	uint32_t roleReg( uint8_t role, uint32_t cmd ) const;
+
+	//instructions the pipeline does not know raise RI in EX
+	void executeReserved() { raise( stage( EX ), RI, 0 ); }
+
+	bool cycle();
+
+	//mark e to take code when it reaches WB, the first exception wins
+	void raise( stageEntry &e, exception code, uint32_t addr );
+
+	//faults left by the memory and registers, and interrupts
+	bool attend( memFault inMem );
+
+	//WB of an instruction that raised an exception, and of ERET
+	void takeException();
+	void flushYounger();
+	void updateInterrupts();
+	void writeCP0( uint32_t r, uint32_t val );
+
 	void fetch();
+	bool fetchReady();
+	void fetchWord( stageEntry &f );
+	void predict( stageEntry &f, const instrDesc &d );
 	void decode();
 	void execute();
 	void memory();
+	void accessNonBlocking( const stageEntry &m, uint8_t access, uint32_t addr );
+	void retireMisses();
+	void traceAccess( const stageEntry &m, uint8_t access, uint32_t addr );
 	void writeback(); 
 
+	runResult runCycles( uint32_t stopPc, bool atPc, uint64_t maxCycles );
+
 	bool checkDependence();
+	bool checkBranchOperands();
+
+	//branches and jumps
+	bool branchTaken( uint32_t cmd, uint32_t rs, uint32_t rt ) const;
+	void resolve( stageEntry &e, int s, uint32_t rs, uint32_t rt );
+	uint32_t idOperand( uint32_t r );
+	void forward();
+	void forwardValue( const stageEntry &ex, uint32_t r, uint32_t val );
 
 	/*********************
 	 * execute functions *
@@ -119,8 +426,7 @@ private:
 	void executeSLLV();
 	void executeSRLV();
 	void executeSRAV();
-	void executeJR();
-	void executeJALR();
+	void executeBranch();
 	void executeBREAK();
 	void executeMFHI();
 	void executeMTHI();
@@ -149,12 +455,6 @@ private:
 	void executeCLO();
 	void executeMOVZ();
 	void executeMOVN();
-	void executeJ();
-	void executeJAL();
-	void executeBEQ();
-	void executeBNE();
-	void executeBLEZ();
-	void executeBGEZ();
 	void executeADDI();
 	void executeADDIU();
 	void executeSLTI();
@@ -177,6 +477,9 @@ private:
 	void executeSWR();
 	void executeLL();
 	void executeSC();
+	void executeSYSCALL();
+	void executeMFC0();
+	void executeMTC0();
 
 
 	
@@ -190,9 +493,7 @@ private:
 	void memorySLLV();
 	void memorySRLV();
 	void memorySRAV();
-	void memoryJR();
-	void memoryJALR();
-	void memoryBREAK();
+	void memoryLink();
 	void memoryMFHI();
 	void memoryMTHI();
 	void memoryMFLO();
@@ -220,12 +521,6 @@ private:
 	void memoryCLO();
 	void memoryMOVZ();
 	void memoryMOVN();
-	void memoryJ();
-	void memoryJAL();
-	void memoryBEQ();
-	void memoryBNE();
-	void memoryBLEZ();
-	void memoryBGEZ();
 	void memoryADDI();
 	void memoryADDIU();
 	void memorySLTI();
@@ -248,6 +543,8 @@ private:
 	void memorySWR();
 	void memoryLL();
 	void memorySC();
+	void memoryMFC0();
+	void memoryMTC0();
 
 
 	/************************
@@ -260,6 +557,7 @@ private:
 	void writebackSLLV();
 	void writebackSRLV();
 	void writebackSRAV();
+	void writebackLink();
 	void writebackMFHI();
 	void writebackMTHI();
 	void writebackMFLO();
@@ -309,6 +607,9 @@ private:
 	void writebackSWL();
 	void writebackSW();
 	void writebackSWR();
+	void writebackMFC0();
+	void writebackMTC0();
+	void writebackERET();
 /*
 
 SOOOOOOOOS
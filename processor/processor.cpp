@@ -21,23 +21,19 @@ void simpleProcessor::setTextArea( uint32_t startAddr, uint32_t endAddr )
 {
 	this->startAddr = startAddr;
 	this->endAddr = endAddr;
+	flushPredecoded();
 }
 
 void simpleProcessor::step()
 {
-	stringstream ex;
-	
-	//set console output to represent numbers as hexademicals with 0x in front of them.
-	ex.setf( ios::hex, ios::basefield );
-	ex.setf( ios::showbase );
-	if( pc < startAddr || pc > endAddr ) {
-			ex << "Error: pc out of range" << pc << endl;
-			throw ex.str();
-	}
+	if( pc < startAddr || pc > endAddr )
+		pcOutOfRange();
 
-	//if pc is in range load next instruction and execute it
-	uint32_t cmd = mem->loadWord( pc );
-	executeCmd( cmd );
+	//if pc is in range execute the (pre)decoded instruction
+	const decodedCmd &d = predecoded( pc );
+	( this->*d.exec )( d );
+	if( faultPending() )
+		pendingFault();
 
 	//update pc
 	pc += 4;
@@ -45,29 +41,128 @@ void simpleProcessor::step()
 }
 
 void simpleProcessor::run()
+{
+	while( true )
+		execute();
+}
+
+/*
+ * Execute the instruction at pc, the way run() does. 
+ * Unknown operations throw. The exception messages are 
+ * only built when they are needed.
+ */
+void simpleProcessor::execute()
+{
+	if( pc < startAddr || pc > endAddr )
+		pcOutOfRange();
+
+	//if pc is in range execute the (pre)decoded instruction
+	const decodedCmd &d = predecoded( pc );
+	if( !( this->*d.exec )( d ) ) {
+		stringstream ex;
+		ex.setf( ios::hex, ios::basefield );
+		ex.setf( ios::showbase );
+		ex << "Unknown operation at pc " << pc << ". Funct " << FUNCT( mem->loadWord( pc ) ); 
+		throw ex.str();
+	}
+	if( faultPending() )
+		pendingFault();
+
+	//update pc
+	pc += 4;
+}
+
+void simpleProcessor::pcOutOfRange()
 {
 	stringstream ex;
 	
 	//set console output to represent numbers as hexademicals with 0x in front of them.
 	ex.setf( ios::hex, ios::basefield );
 	ex.setf( ios::showbase );
-	while( true ) {
+	ex << "Error: pc out of range" << pc << endl;
+	throw ex.str();
+}
 
-		if( pc < startAddr || pc > endAddr ) {
-			ex << "Error: pc out of range" << pc << endl;
-			throw ex.str();
-		}
 
-		//if pc is in range load next instruction and execute it
+/*
+ * Return the decoded form of the instruction at pc, 
+ * decoding it on first use. pc must be in the text area.
+ * Misaligned or faulting fetches are decoded every time
+ * so that the memory gets to complain about them.
+ */
+decodedCmd &simpleProcessor::predecoded( uint32_t pc )
+{
+	static decodedCmd uncached;
+
+	if( pc % 4 != 0 ) {
+		decode( mem->loadWord( pc ), uncached );
+		return uncached;
+	}
+
+	if( icache == NULL ) {
+		uint32_t entries = ( endAddr - startAddr ) / 4 + 1;
+		icache = new decodedCmd[ entries ];
+		for( uint32_t i=0; i<entries; ++i )
+			icache[i].exec = NULL;
+	}
+
+	decodedCmd &d = icache[ ( pc - startAddr ) >> 2 ];
+	if( d.exec == NULL ) {
 		uint32_t cmd = mem->loadWord( pc );
-		if( !executeCmd( cmd ) ) {
-			ex << "Unknown operation at pc " << pc << ". Funct " << FUNCT( cmd ); 
-			throw ex.str();
+		if( mem->fault() != NO_FAULT ) {
+			decode( cmd, uncached );
+			return uncached;
 		}
-		//update pc
-		pc += 4;
+		decode( cmd, d );
+	}
+
+	return d;
+}
+
+void simpleProcessor::flushPredecoded()
+{
+	delete[] icache;
+	icache = NULL;
+}
+
+void simpleProcessor::enterException( exception code )
+{
+	cause = ( cause & ~EC ) | ( code << 2 );
+	if( !( status & EL ) )
+		epc = pc;
+	status |= EL;
+}
+
+/*
+ * Memories leave their faults pending instead of throwing.
+ * Record it in CP0 and report it as the matching address
+ * error exception.
+ */
+void simpleProcessor::memoryFault()
+{
+	stringstream ex;
+	ex.setf( ios::hex, ios::basefield );
+	ex.setf( ios::showbase );
+
+	exception code = ( mem->fault() == STORE_FAULT ) ? AdEs : AdEl;
+	badVAddr = mem->faultAddr();
+	enterException( code );
+
+	ex << ( ( code == AdEs ) ? "AdES" : "AdEL" ) << " exception at pc " << pc
+	   << ", address " << mem->faultAddr() << endl;
+	mem->clearFault();
+	throw ex.str();
+}
+
+//a bad stack pointer is no MIPS exception, it stops the simulation
+void simpleProcessor::pendingFault()
+{
+	if( reg->fault() ) {
+		reg->clearFault();
+		throw "Not valid address for stack pointer";
 	}
 
+	memoryFault();
 }
 
 int32_t simpleProcessor::signExtend( int16_t halfword )
@@ -87,266 +182,457 @@ int32_t simpleProcessor::signExtend( int8_t byte )
 
 }
 
+/*
+ * Functions implementing the predecoded operations,
+ * in decodedOp order.
+ */
+const cmdHandler simpleProcessor::handlers[ OP_COUNT ] = {
+	&simpleProcessor::cmdUnknown,
+	&simpleProcessor::cmdADD,
+	&simpleProcessor::cmdAND,
+	&simpleProcessor::cmdBREAK,
+	&simpleProcessor::cmdDIV,
+	&simpleProcessor::cmdDIVU,
+	&simpleProcessor::cmdJALR,
+	&simpleProcessor::cmdJR,
+	&simpleProcessor::cmdMFHI,
+	&simpleProcessor::cmdMFLO,
+	&simpleProcessor::cmdMTHI,
+	&simpleProcessor::cmdMTLO,
+	&simpleProcessor::cmdMULT,
+	&simpleProcessor::cmdMULTU,
+	&simpleProcessor::cmdNOR,
+	&simpleProcessor::cmdOR,
+	&simpleProcessor::cmdXOR,
+	&simpleProcessor::cmdSLL,
+	&simpleProcessor::cmdSLLV,
+	&simpleProcessor::cmdSRL,
+	&simpleProcessor::cmdSRLV,
+	&simpleProcessor::cmdSLT,
+	&simpleProcessor::cmdSLTU,
+	&simpleProcessor::cmdSRA,
+	&simpleProcessor::cmdSUB,
+	&simpleProcessor::cmdJ,
+	&simpleProcessor::cmdJAL,
+	&simpleProcessor::cmdADDI,
+	&simpleProcessor::cmdANDI,
+	&simpleProcessor::cmdBEQ,
+	&simpleProcessor::cmdNOP,
+	&simpleProcessor::cmdBNE,
+	&simpleProcessor::cmdLB,
+	&simpleProcessor::cmdLBU,
+	&simpleProcessor::cmdLH,
+	&simpleProcessor::cmdLHU,
+	&simpleProcessor::cmdLUI,
+	&simpleProcessor::cmdLW,
+	&simpleProcessor::cmdORI,
+	&simpleProcessor::cmdSB,
+	&simpleProcessor::cmdSLTI,
+	&simpleProcessor::cmdSLTIU,
+	&simpleProcessor::cmdSH,
+	&simpleProcessor::cmdSW,
+	&simpleProcessor::cmdXORI,
+};
+
 bool simpleProcessor::executeCmd( uint32_t cmd )
 {
+	decodedCmd d;
+	decode( cmd, d );
+	return ( this->*d.exec )( d );
+}
+
+
+/*
+ * Extract the fields of an instruction and pick the 
+ * function executing it.
+ */
+void simpleProcessor::decode( uint32_t cmd, decodedCmd &d )
+{
+	d.rs = RS( cmd );
+	d.rt = RT( cmd );
+	d.rd = RD( cmd );
+	d.shamt = SHAMT( cmd );
+	d.immed = IMMED( cmd );
+	d.op = opUnknown;
+
 	if( OP( cmd ) == RTYPE1 ) {
 	
 		//R-TYPE instructions
-		int32_t rd =  RD(cmd);
-		int32_t rs =  reg->getReg( RS(cmd) );
-		int32_t rt =  reg->getReg( RT(cmd) );
-		int32_t shamt = SHAMT( cmd );
-
 		switch( FUNCT( cmd ) ) {
-			case( ADD ):
-				reg->setReg( rd, add( rs, rt ) );
-				//what about overflow?
-				break;
-		
-			case( ADDU ):
-				reg->setReg( rd, add( rs, rt ) );
-				//what about overflow?
-				break;
-		
-			case( AND ):
-				reg->setReg( rd, rs & rt );
-		
-			case( BREAK ):
-				throw "BREAK unimplemented";
-			
-			case( DIV ):
-				reg->setHI( rs / rt );
-				reg->setLO( rs % rt );
-				break;
-			
-			case( DIVU ):
-				reg->setHI( (uint32_t) rs / rt );
-				reg->setLO( (uint32_t) rs % rt );
-				break;
-			case( JALR ):
-				reg->setReg( 31, pc+4 );
-				pc = rs - 4;
-				break;
-			case( JR ):
-				pc = rs - 4;
-				break;
-
-			case( MFHI ):
-				reg->setReg( rd, reg->getHI() );
-				break;
-
-			case( MFLO ):
-				reg->setReg( rd, reg->getLO() );
-				break;
-
-			case( MTHI ):
-				reg->setHI( rd );
-				break;
-		
-			case( MTLO ):
-				reg->setLO( rd );
-				break;
-
-			case( MULT ):
-				reg->setLO( multiply( rs,rt ) );
-				break;
-
-			case( MULTU ):
-				reg->setLO( multiplyUnsigned( rs,rt ) ); 
-				break;
-
-			case( NOR ):
-				reg->setReg( rd, ~( rs | rt ) );
-				break;
-	
-			case( OR ):
-				reg->setReg( rd, rs|rt );
-				break;
-
-			case( XOR ):
-				reg->setReg( rd, rs^rt );
-				break;
-
-			case( SLL ):
-				reg->setReg( rd, (uint32_t)rs << shamt );
-				break;
-
-			case( SLLV ):
-				reg->setReg( rd, (uint32_t)rs << rt );
-				break;
-
-			case( SRL ):
-				reg->setReg( rd, (uint32_t)rs >> shamt );
-				break;
-
-			case( SRLV ):
-				reg->setReg( rd, (uint32_t)rs >> rt );
-				break;
-
-			case( SLT ):
-				if( rs < rt ) 
-					reg->setReg( rd, 1 );
-				else
-					reg->setReg( rd, 0 );
-				break;
-
-			case( SLTU ):
-				if( (uint32_t) rs < (uint32_t) rt )
-					reg->setReg( rd,1 );
-				else
-					reg->setReg( rd, 0 );
-				break;
-
-			case( SRA ):
-				reg->setReg( rd, rs >> shamt );
-				break;
-
-			case( SUB ):
-				reg->setReg( rd, subtract( rs, rt ) );
-				break;
-
-			case( SUBU ):
-				reg->setReg( rd, subtract( rs, rt ) );
-				break;
-
-			default:
-				return false;	
+			case( ADD ): d.op = opADD; break;
+			case( ADDU ): d.op = opADD; break;
+			case( AND ): d.op = opAND; break;
+			case( BREAK ): d.op = opBREAK; break;
+			case( DIV ): d.op = opDIV; break;
+			case( DIVU ): d.op = opDIVU; break;
+			case( JALR ): d.op = opJALR; break;
+			case( JR ): d.op = opJR; break;
+			case( MFHI ): d.op = opMFHI; break;
+			case( MFLO ): d.op = opMFLO; break;
+			case( MTHI ): d.op = opMTHI; break;
+			case( MTLO ): d.op = opMTLO; break;
+			case( MULT ): d.op = opMULT; break;
+			case( MULTU ): d.op = opMULTU; break;
+			case( NOR ): d.op = opNOR; break;
+			case( OR ): d.op = opOR; break;
+			case( XOR ): d.op = opXOR; break;
+			case( SLL ): d.op = opSLL; break;
+			case( SLLV ): d.op = opSLLV; break;
+			case( SRL ): d.op = opSRL; break;
+			case( SRLV ): d.op = opSRLV; break;
+			case( SLT ): d.op = opSLT; break;
+			case( SLTU ): d.op = opSLTU; break;
+			case( SRA ): d.op = opSRA; break;
+			case( SUB ): d.op = opSUB; break;
+			case( SUBU ): d.op = opSUB; break;
 		}
 	
 	//next two instructions are JTYPE instructions
 	} else if ( OP(cmd) == J ){
-		int32_t target = TARG( cmd );
-		pc = ( ( pc & 0xf0000000 ) | ( target << 2 ) ) - 4;
+		d.immed = TARG( cmd );
+		d.op = opJ;
 			
 	} else if ( OP(cmd) == JAL ) {	
-		//diafora me to niko
-		int32_t target = TARG( cmd );
-		reg->setReg( 31, pc + 8 );
-		pc = ( ( pc & 0xf0000000 ) | ( target << 2 ) ) - 4;
+		d.immed = TARG( cmd );
+		d.op = opJAL;
 			
 	//and all next are ITYPE
 	} else {
-		int32_t rs = reg->getReg( RS( cmd ) );
-		int32_t rt = RT( cmd );
-		int32_t immed = IMMED( cmd );
-
 		switch( OP(cmd) ) {
-			case( ADDI ):
-				reg->setReg( rt, add( rs, immed ) );
-				break;
-
-			case( ADDIU ):
-				reg->setReg( rt, add( rs, immed ) );
-				break;
-
-			case( ANDI ):
-				reg->setReg( rt, rs & immed );
-				break;
-
-			case( BEQ ):
-				if( reg->getReg( rt ) == rs )
-					pc += ( immed << 2 ) - 4;
-				break;
-			
-			case( BGEZ ):		//BGEZ,	BGEZAL, BLTZAL, BLTZ all have opcode 0x01
-				switch( rt ) {
-					case( 1 ):
-						//BGEZ
-						break;
-					case( 0x11 ):
-						//BGEZAL
-						break;
-					case( 0x10 ):
-						//BLTZAL
-						break;
-					case( 0 ):
-						//BLTZ
-						break;
-
-				}
-
-				break;
-
-			case( BGTZ ):
-				if( rt == 0 ) { //rt field must be 0
-
-				}
-				break;
-
-			case( BLEZ ):
-				if( rt == 0 ) { //rt field must be 0
-
-				}
-				break;
-
-			case( BNE ):
-				if( reg->getReg( rt ) != rs )
-					pc += ( immed << 2 ) - 4;
-				break;
-
-			case( LB ):
-				reg->setReg( rt, signExtend( (int8_t) mem->loadByte( rs + signExtend( (int16_t) immed ) ) ) ); //Sign Extension
-				break;
-	
-			case( LBU ):
-				reg->setReg( rt, mem->loadByte( rs + signExtend( (int16_t) immed ) ) ); //TODO: Byte returned from mem must be sign extended.
-				break; 
+			case( ADDI ): d.op = opADDI; break;
+			case( ADDIU ): d.op = opADDI; break;
+			case( ANDI ): d.op = opANDI; break;
+			case( BEQ ): d.op = opBEQ; break;
+			case( BGEZ ): d.op = opNOP; break;	//BGEZ, BGEZAL, BLTZAL, BLTZ, not yet
+			case( BGTZ ): d.op = opNOP; break;
+			case( BLEZ ): d.op = opNOP; break;
+			case( BNE ): d.op = opBNE; break;
+			case( LB ): d.op = opLB; break;
+			case( LBU ): d.op = opLBU; break;
+			case( LH ): d.op = opLH; break;
+			case( LHU ): d.op = opLHU; break;
+			case( LUI ): d.op = opLUI; break;
+			case( LW ): d.op = opLW; break;
+			case( ORI ): d.op = opORI; break;
+			case( SB ): d.op = opSB; break;
+			case( SLTI ): d.op = opSLTI; break;
+			case( SLTIU ): d.op = opSLTIU; break;
+			case( SH ): d.op = opSH; break;
+			case( SW ): d.op = opSW; break;
+			case( XORI ): d.op = opXORI; break;
+		}	
 
-			case( LH ):
-				reg->setReg( rt, signExtend( (int16_t) mem->loadHalfWord( rs + signExtend( (int16_t) immed ) ) ) );
-				break;
+	}
 
-			case( LHU ):
-				reg->setReg( rt, mem->loadHalfWord( rs + signExtend( (int16_t) immed ) ) );
-				break; 
+	d.exec = handlers[ d.op ];
+}
 
-			case( LUI ):
-				reg->setReg( rt, immed << 16 );
-				break;
-			
-			case( LW ):
-				reg->setReg( rt, mem->loadWord( rs + immed ) );
-				break;
-			
-			case( ORI ):
-				reg->setReg( rt, rs | immed );
-				break; 
-
-			case( SB ):
-				mem->storeByte( rs+immed, reg->getReg( rt ) );
-				break;
-				
-			case( SLTI ):
-				if(  rs < immed )
-					reg->setReg( rt, 1 );
-				else
-					reg->setReg( rt, 0 );
-				break;
-
-			case( SLTIU ):
-				if( (uint32_t) rs < (uint32_t) immed )
-					reg->setReg( rt,1 );
-				else 
-					reg->setReg( rt, 0 );
-				break;
-
-			case( SH ): 
-				mem->storeHalfWord( rs+immed, reg->getReg( rt ) );
-				break;
-
-			case( SW ):
-				mem->storeWord( rs+immed, reg->getReg( rt ) );
-				break;
-
-			case( XORI ):
-				reg->setReg( rt, rs^immed );
-				break;
-
-			default:
-				return false;
 
-		}	
+/*
+ * Instructions. They return false for operations
+ * we don't know about.
+ */
+bool simpleProcessor::cmdUnknown( const decodedCmd &d )
+{
+	return false;
+}
 
-	}
+//R-TYPE
+bool simpleProcessor::cmdADD( const decodedCmd &d )
+{
+	//what about overflow?
+	reg->setReg( d.rd, add( reg->getReg( d.rs ), reg->getReg( d.rt ) ) );
+	return true;
+}
+
+bool simpleProcessor::cmdAND( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getReg( d.rs ) & reg->getReg( d.rt ) );
+	return true;
+}
+
+//there is no handler to go to, so like an address error it stops the run
+bool simpleProcessor::cmdBREAK( const decodedCmd &d )
+{
+	stringstream ex;
+	ex.setf( ios::hex, ios::basefield );
+	ex.setf( ios::showbase );
+
+	enterException( Bp );
+	ex << "Bp exception at pc " << pc << endl;
+	throw ex.str();
+}
+
+bool simpleProcessor::cmdDIV( const decodedCmd &d )
+{
+	int32_t rs = reg->getReg( d.rs );
+	int32_t rt = reg->getReg( d.rt );
+
+	//HI and LO keep their values when the result is UNPREDICTABLE
+	if( !DIVIDES( rs, rt ) )
+		return true;
+	reg->setLO( rs / rt );
+	reg->setHI( rs % rt );
+	return true;
+}
+
+bool simpleProcessor::cmdDIVU( const decodedCmd &d )
+{
+	int32_t rs = reg->getReg( d.rs );
+	int32_t rt = reg->getReg( d.rt );
+	if( rt == 0 )
+		return true;
+	reg->setLO( (uint32_t) rs / rt );
+	reg->setHI( (uint32_t) rs % rt );
+	return true;
+}
+
+bool simpleProcessor::cmdJALR( const decodedCmd &d )
+{
+	int32_t rs = reg->getReg( d.rs );
+	reg->setReg( 31, pc+4 );
+	pc = rs - 4;
+	return true;
+}
+
+bool simpleProcessor::cmdJR( const decodedCmd &d )
+{
+	pc = reg->getReg( d.rs ) - 4;
+	return true;
+}
+
+bool simpleProcessor::cmdMFHI( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getHI() );
+	return true;
+}
+
+bool simpleProcessor::cmdMFLO( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getLO() );
+	return true;
+}
+
+bool simpleProcessor::cmdMTHI( const decodedCmd &d )
+{
+	reg->setHI( d.rd );
+	return true;
+}
+
+bool simpleProcessor::cmdMTLO( const decodedCmd &d )
+{
+	reg->setLO( d.rd );
+	return true;
+}
+
+bool simpleProcessor::cmdMULT( const decodedCmd &d )
+{
+	int64_t result = (int64_t) reg->getReg( d.rs ) * reg->getReg( d.rt );
+	reg->setLO( (uint32_t) result );
+	reg->setHI( (uint32_t)( result >> 32 ) );
+	return true;
+}
+
+bool simpleProcessor::cmdMULTU( const decodedCmd &d )
+{
+	uint64_t result = (uint64_t)(uint32_t) reg->getReg( d.rs ) * (uint32_t) reg->getReg( d.rt );
+	reg->setLO( (uint32_t) result );
+	reg->setHI( (uint32_t)( result >> 32 ) );
+	return true;
+}
+
+bool simpleProcessor::cmdNOR( const decodedCmd &d )
+{
+	reg->setReg( d.rd, ~( reg->getReg( d.rs ) | reg->getReg( d.rt ) ) );
+	return true;
+}
+
+bool simpleProcessor::cmdOR( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getReg( d.rs ) | reg->getReg( d.rt ) );
+	return true;
+}
+
+bool simpleProcessor::cmdXOR( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getReg( d.rs ) ^ reg->getReg( d.rt ) );
+	return true;
+}
+
+bool simpleProcessor::cmdSLL( const decodedCmd &d )
+{
+	reg->setReg( d.rd, (uint32_t) reg->getReg( d.rs ) << d.shamt );
+	return true;
+}
+
+bool simpleProcessor::cmdSLLV( const decodedCmd &d )
+{
+	reg->setReg( d.rd, (uint32_t) reg->getReg( d.rs ) << reg->getReg( d.rt ) );
+	return true;
+}
+
+bool simpleProcessor::cmdSRL( const decodedCmd &d )
+{
+	reg->setReg( d.rd, (uint32_t) reg->getReg( d.rs ) >> d.shamt );
+	return true;
+}
+
+bool simpleProcessor::cmdSRLV( const decodedCmd &d )
+{
+	reg->setReg( d.rd, (uint32_t) reg->getReg( d.rs ) >> reg->getReg( d.rt ) );
+	return true;
+}
+
+bool simpleProcessor::cmdSLT( const decodedCmd &d )
+{
+	reg->setReg( d.rd, ( reg->getReg( d.rs ) < reg->getReg( d.rt ) ) ? 1 : 0 );
+	return true;
+}
+
+bool simpleProcessor::cmdSLTU( const decodedCmd &d )
+{
+	reg->setReg( d.rd, ( (uint32_t) reg->getReg( d.rs ) < (uint32_t) reg->getReg( d.rt ) ) ? 1 : 0 );
+	return true;
+}
+
+bool simpleProcessor::cmdSRA( const decodedCmd &d )
+{
+	reg->setReg( d.rd, reg->getReg( d.rs ) >> d.shamt );
+	return true;
+}
+
+bool simpleProcessor::cmdSUB( const decodedCmd &d )
+{
+	reg->setReg( d.rd, subtract( reg->getReg( d.rs ), reg->getReg( d.rt ) ) );
+	return true;
+}
+
+//J-TYPE
+bool simpleProcessor::cmdJ( const decodedCmd &d )
+{
+	pc = ( ( pc & 0xf0000000 ) | ( d.immed << 2 ) ) - 4;
+	return true;
+}
+
+bool simpleProcessor::cmdJAL( const decodedCmd &d )
+{
+	reg->setReg( 31, pc + 8 );
+	pc = ( ( pc & 0xf0000000 ) | ( d.immed << 2 ) ) - 4;
+	return true;
+}
+
+//I-TYPE
+bool simpleProcessor::cmdADDI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, add( reg->getReg( d.rs ), d.immed ) );
+	return true;
+}
+
+bool simpleProcessor::cmdANDI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, reg->getReg( d.rs ) & d.immed );
+	return true;
+}
+
+bool simpleProcessor::cmdBEQ( const decodedCmd &d )
+{
+	if( reg->getReg( d.rt ) == reg->getReg( d.rs ) )
+		pc += ( d.immed << 2 ) - 4;
+	return true;
+}
+
+bool simpleProcessor::cmdNOP( const decodedCmd &d )
+{
+	return true;
+}
+
+bool simpleProcessor::cmdBNE( const decodedCmd &d )
+{
+	if( reg->getReg( d.rt ) != reg->getReg( d.rs ) )
+		pc += ( d.immed << 2 ) - 4;
+	return true;
+}
+
+bool simpleProcessor::cmdLB( const decodedCmd &d )
+{
+	reg->setReg( d.rt, signExtend( (int8_t) mem->loadByte( reg->getReg( d.rs ) + d.immed ) ) ); //Sign Extension
+	return true;
+}
+
+bool simpleProcessor::cmdLBU( const decodedCmd &d )
+{
+	reg->setReg( d.rt, mem->loadByte( reg->getReg( d.rs ) + d.immed ) );
+	return true;
+}
+
+bool simpleProcessor::cmdLH( const decodedCmd &d )
+{
+	reg->setReg( d.rt, signExtend( (int16_t) mem->loadHalfWord( reg->getReg( d.rs ) + d.immed ) ) );
+	return true;
+}
+
+bool simpleProcessor::cmdLHU( const decodedCmd &d )
+{
+	reg->setReg( d.rt, mem->loadHalfWord( reg->getReg( d.rs ) + d.immed ) );
+	return true;
+}
+
+bool simpleProcessor::cmdLUI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, d.immed << 16 );
+	return true;
+}
+
+bool simpleProcessor::cmdLW( const decodedCmd &d )
+{
+	reg->setReg( d.rt, mem->loadWord( reg->getReg( d.rs ) + d.immed ) );
+	return true;
+}
+
+bool simpleProcessor::cmdORI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, reg->getReg( d.rs ) | d.immed );
+	return true;
+}
+
+bool simpleProcessor::cmdSB( const decodedCmd &d )
+{
+	uint32_t addr = reg->getReg( d.rs ) + d.immed;
+	mem->storeByte( addr, reg->getReg( d.rt ) );
+	textWritten( addr & ~3 );
+	return true;
+}
+
+bool simpleProcessor::cmdSLTI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, ( reg->getReg( d.rs ) < d.immed ) ? 1 : 0 );
+	return true;
+}
+
+bool simpleProcessor::cmdSLTIU( const decodedCmd &d )
+{
+	reg->setReg( d.rt, ( (uint32_t) reg->getReg( d.rs ) < (uint32_t) d.immed ) ? 1 : 0 );
+	return true;
+}
+
+bool simpleProcessor::cmdSH( const decodedCmd &d )
+{
+	uint32_t addr = reg->getReg( d.rs ) + d.immed;
+	mem->storeHalfWord( addr, reg->getReg( d.rt ) );
+	textWritten( addr & ~3 );
+	return true;
+}
+
+bool simpleProcessor::cmdSW( const decodedCmd &d )
+{
+	uint32_t addr = reg->getReg( d.rs ) + d.immed;
+	mem->storeWord( addr, reg->getReg( d.rt ) );
+	textWritten( addr );
+	return true;
+}
+
+bool simpleProcessor::cmdXORI( const decodedCmd &d )
+{
+	reg->setReg( d.rt, reg->getReg( d.rs ) ^ d.immed );
 	return true;
 }
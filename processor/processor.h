@@ -7,6 +7,7 @@
  */
 #include <stdint.h>
 #include "../memory/memory.h"
+#include "../memory/pagedMemory.h"
 #include "register_file.h"
 #include "mipsISA.h"
 
@@ -17,6 +18,9 @@
 #define DATA_LOW	0x10000000
 #define TEXT_LOW	0x00400000
 
+//signed division the host can do. By 0 and INT_MIN by -1 it traps, the guest result is UNPREDICTABLE
+#define DIVIDES( rs, rt )	( ( rt ) != 0 && !( ( rs ) == INT32_MIN && ( rt ) == -1 ) )
+
 
 /*
  * Interface of a simple processor.
@@ -31,14 +35,14 @@ public:
 
 	processor() {};
 	processor( uint32_t startAddr, uint32_t endAddr ) : startAddr( startAddr ), endAddr( endAddr ) {};
-	processor( simpleMemory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) :  mem( mem ), reg( reg ),  pc( startAddr ), startAddr( startAddr ), endAddr( endAddr ) {};
+	processor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) :  mem( mem ), reg( reg ),  pc( startAddr ), startAddr( startAddr ), endAddr( endAddr ) {};
 
 
 
 protected:
 	
 	//Memory
-	simpleMemory *mem;
+	Memory *mem;
 
 	//Registers
 	RegisterFile *reg;
@@ -55,10 +59,39 @@ protected:
 
 };
 
+class simpleProcessor;
+struct decodedCmd;
+
+typedef bool (simpleProcessor::*cmdHandler)( const decodedCmd & );
+
+/*
+ * Operations an instruction is decoded to. opUnknown
+ * is anything we can not execute.
+ */
+typedef enum {
+	opUnknown, opADD, opAND, opBREAK, opDIV, opDIVU, opJALR, opJR, opMFHI,
+	opMFLO, opMTHI, opMTLO, opMULT, opMULTU, opNOR, opOR, opXOR, opSLL,
+	opSLLV, opSRL, opSRLV, opSLT, opSLTU, opSRA, opSUB, opJ, opJAL,
+	opADDI, opANDI, opBEQ, opNOP, opBNE, opLB, opLBU, opLH, opLHU, opLUI,
+	opLW, opORI, opSB, opSLTI, opSLTIU, opSH, opSW, opXORI,
+	OP_COUNT
+} decodedOp;
+
+/*
+ * An instruction decoded once and kept in the predecode
+ * cache. exec points to the function implementing it.
+ */
+struct decodedCmd {
+	cmdHandler exec;
+	uint8_t op;
+	uint8_t rs, rt, rd, shamt;
+	int32_t immed;		//sign extended immediate, or target of J/JAL
+};
+
 /*
  * A Basic MIPS processor.
  */
-class simpleProcessor : processor {
+class simpleProcessor : public processor {
 
 
 public:
@@ -70,27 +103,35 @@ public:
 
 	simpleProcessor() 
 	{
-		 this->mem = new simpleMemory( 1UL << 22 );
+		 this->mem = new pagedMemory<BIG_END>( MEM_SIZE );
 		 this->reg = new RegisterFile();
 		 this->startAddr = 0;
 		 this->endAddr = 0;
+		 this->icache = NULL;
+		 this->cause = this->status = this->epc = this->badVAddr = 0;
 	}
 
 	simpleProcessor( uint32_t startAddr, uint32_t endAddr ) 
 	{
 		this->startAddr = startAddr;
 		this->endAddr = endAddr;
+		this->icache = NULL;
+		this->cause = this->status = this->epc = this->badVAddr = 0;
 	}
 
-	simpleProcessor( simpleMemory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) 
+	simpleProcessor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) 
 	{
 		 this->mem = mem;
 		 this->reg = reg;
 		 this->startAddr = startAddr;
 		 this->endAddr = endAddr;
 		 this->pc = startAddr;
+		 this->icache = NULL;
+		 this->cause = this->status = this->epc = this->badVAddr = 0;
 	}
 
+	virtual ~simpleProcessor() { delete[] icache; }
+
 //protected:
 protected:
 	/*
@@ -100,7 +141,7 @@ protected:
 	 */
 
 	//Memory
-	simpleMemory *mem;
+	Memory *mem;
 
 	//Registers
 	RegisterFile *reg;
@@ -149,8 +190,8 @@ protected:
 	uint32_t cause;
 	// this enum contains the bits of interest in cause register
 	typedef enum {
-		BD = 0x10000000, //Branch Delay
-		IM = 0x0000ff00, //Interupt Mack
+		BD = 0x80000000, //Branch Delay
+		IP = 0x0000ff00, //Interrupts Pending
 		EC = 0x0000007C, //Exception Code
 	}exception_cause;
 
@@ -158,15 +199,98 @@ protected:
 	// similarly to exception_cause this enum contains the
  	// bits of interest in status register.
 	typedef enum {
-		PI = 0x0000ff00, //Pending Interrupt
+		IM = 0x0000ff00, //Interrupt Mask
 		UM = 0x00000010, //User Mode
 		EL = 0x00000002, //Exception Level
 		IE = 0x00000001, //Interrupt Enable
 	}exception_status;
 
+	uint32_t epc;		//pc of the instruction that took the exception
+	uint32_t badVAddr;	//address of the last address error
+
+
+	//set Cause.EC, EPC unless at exception level already, and Status.EL
+	void enterException( exception code );
+
+	//turn a fault left pending by the memory into AdEL/AdES
+	void memoryFault();
+
+	//checked after every instruction, raises what the memory or registers left
+	bool faultPending() const { return mem->fault() != NO_FAULT || reg->fault(); }
+	void pendingFault();
 
-private:
 	bool executeCmd( uint32_t cmd );
+
+	//one instruction the way run() does it, and its range error
+	void execute();
+	void pcOutOfRange();
+
+	/*
+	 * Predecode cache. One entry per word of the text area,
+	 * filled the first time the word is executed.
+	 */
+	decodedCmd *icache;
+	decodedCmd &predecoded( uint32_t pc );
+	void decode( uint32_t cmd, decodedCmd &d );
+	void flushPredecoded();
+	static const cmdHandler handlers[ OP_COUNT ];
+
+	//stores into the text area drop the stale entry
+	virtual void textWritten( uint32_t addr )
+	{
+		if( icache != NULL && addr >= startAddr && addr <= endAddr )
+			icache[ ( addr - startAddr ) >> 2 ].exec = NULL;
+	}
+
+	/*
+	 * One function per instruction, working on the
+	 * predecoded fields.
+	 */
+	bool cmdUnknown( const decodedCmd & );
+	bool cmdADD( const decodedCmd & );
+	bool cmdAND( const decodedCmd & );
+	bool cmdBREAK( const decodedCmd & );
+	bool cmdDIV( const decodedCmd & );
+	bool cmdDIVU( const decodedCmd & );
+	bool cmdJALR( const decodedCmd & );
+	bool cmdJR( const decodedCmd & );
+	bool cmdMFHI( const decodedCmd & );
+	bool cmdMFLO( const decodedCmd & );
+	bool cmdMTHI( const decodedCmd & );
+	bool cmdMTLO( const decodedCmd & );
+	bool cmdMULT( const decodedCmd & );
+	bool cmdMULTU( const decodedCmd & );
+	bool cmdNOR( const decodedCmd & );
+	bool cmdOR( const decodedCmd & );
+	bool cmdXOR( const decodedCmd & );
+	bool cmdSLL( const decodedCmd & );
+	bool cmdSLLV( const decodedCmd & );
+	bool cmdSRL( const decodedCmd & );
+	bool cmdSRLV( const decodedCmd & );
+	bool cmdSLT( const decodedCmd & );
+	bool cmdSLTU( const decodedCmd & );
+	bool cmdSRA( const decodedCmd & );
+	bool cmdSUB( const decodedCmd & );
+	bool cmdJ( const decodedCmd & );
+	bool cmdJAL( const decodedCmd & );
+	bool cmdADDI( const decodedCmd & );
+	bool cmdANDI( const decodedCmd & );
+	bool cmdBEQ( const decodedCmd & );
+	bool cmdNOP( const decodedCmd & );
+	bool cmdBNE( const decodedCmd & );
+	bool cmdLB( const decodedCmd & );
+	bool cmdLBU( const decodedCmd & );
+	bool cmdLH( const decodedCmd & );
+	bool cmdLHU( const decodedCmd & );
+	bool cmdLUI( const decodedCmd & );
+	bool cmdLW( const decodedCmd & );
+	bool cmdORI( const decodedCmd & );
+	bool cmdSB( const decodedCmd & );
+	bool cmdSLTI( const decodedCmd & );
+	bool cmdSLTIU( const decodedCmd & );
+	bool cmdSH( const decodedCmd & );
+	bool cmdSW( const decodedCmd & );
+	bool cmdXORI( const decodedCmd & );
 	
 };
 
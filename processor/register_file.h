@@ -29,9 +29,26 @@ public:
 	//constructors
 	RegisterFile(); 
 	
-	//register handlers
-	int32_t getReg( unsigned int ) const;
-	void setReg( unsigned int, int32_t );
+	//register handlers, reg is below REG_NR
+	int32_t getReg( unsigned int reg ) const { return registers[reg]; }
+	void setReg( unsigned int reg, int32_t val )
+	{
+		if( reg == 0 )
+			return;
+		if( reg == 29 && val > STACK_MAX ) {
+			badStack = true;
+			return;
+		}
+		registers[reg] = val;
+	}
+
+	/*
+	 * setReg() refuses bad values for the stack pointer
+	 * and leaves the fault here, for the processor to
+	 * check once per instruction like the memory's.
+	 */
+	bool fault() const { return badStack; }
+	void clearFault() { badStack = false; }
 
 	//HI, LO registers
 	int32_t getHI() const { return HI; }
@@ -59,6 +76,7 @@ private:
 	int32_t HI, LO;
 	uint32_t EX;		//exceptions bitmap		?? maybe uint32_t
 	int32_t BRK;		//determines the upper limit of the current data segment.
+	bool badStack;
 
 	
 };
@@ -0,0 +1,296 @@
+/*
+ * threadedProcessor.cpp
+ * Threaded code interpreter for the functional model.
+ * Every predecoded operation has a label, and each
+ * instruction ends by jumping to the label of the next
+ * one. Anything out of the ordinary (pc outside the text
+ * area or misaligned, an instruction not decoded yet,
+ * unknown operations and BREAK) goes through
+ * simpleProcessor::execute() one instruction at a time.
+ */
+
+#include "threadedProcessor.h"
+#include "safeops.h"
+
+using namespace std;
+
+/*
+ * Same checks as RegisterFile::setReg. r[0] is zeroed before 
+ * every instruction. ADD/SUB wrap inline, the overflow flag
+ * of safeops is not architectural state.
+ */
+#define SET( n, v ) do {						\
+		int32_t val_ = ( v );					\
+		if( ( n ) == 29 && val_ > STACK_MAX )			\
+			throw "Not valid address for stack pointer";	\
+		r[ n ] = val_;						\
+	} while( 0 )
+
+#define NEXT()		do { pc_ += 4; goto dispatch; } while( 0 )
+#define CHECK_FAULT()	do { if( mem->fault() != NO_FAULT ) goto fault; } while( 0 )
+
+void threadedProcessor::run()
+{
+	while( true )
+		run( ~(uint64_t)0 );
+}
+
+uint64_t threadedProcessor::run( uint64_t budget )
+{
+	//in decodedOp order
+	static void *const labels[ OP_COUNT ] = {
+		&&Unknown, &&ADD, &&AND, &&BREAK, &&DIV, &&DIVU, &&JALR, &&JR, &&MFHI,
+		&&MFLO, &&MTHI, &&MTLO, &&MULT, &&MULTU, &&NOR, &&OR, &&XOR, &&SLL,
+		&&SLLV, &&SRL, &&SRLV, &&SLT, &&SLTU, &&SRA, &&SUB, &&J, &&JAL,
+		&&ADDI, &&ANDI, &&BEQ, &&NOP, &&BNE, &&LB, &&LBU, &&LH, &&LHU, &&LUI,
+		&&LW, &&ORI, &&SB, &&SLTI, &&SLTIU, &&SH, &&SW, &&XORI
+	};
+
+	int32_t r[ REG_NR ];
+	int32_t hi, lo;
+	uint32_t pc_ = pc;
+	uint64_t left = budget;
+	const uint32_t span = endAddr - startAddr;
+	const decodedCmd *d;
+	uint32_t addr;
+	uint64_t wide;		//product of MULT and MULTU
+
+	//true while the register file and pc hold the state, not the locals
+	bool synced = false;
+
+	loadRegisters( r, hi, lo );
+
+	try {
+
+dispatch:
+		r[0] = 0;
+		if( left == 0 )
+			goto done;
+		--left;
+
+		if( pc_ - startAddr > span || ( pc_ & 3 ) || icache == NULL )
+			goto slow;
+		d = &icache[ ( pc_ - startAddr ) >> 2 ];
+		if( d->exec == NULL )
+			goto slow;
+		goto *labels[ d->op ];
+
+slow:
+		storeRegisters( r, hi, lo );
+		pc = pc_;
+		synced = true;
+		execute();
+		synced = false;
+		loadRegisters( r, hi, lo );
+		pc_ = pc;
+		goto dispatch;
+
+fault:
+		storeRegisters( r, hi, lo );
+		pc = pc_;
+		synced = true;
+		memoryFault();
+
+Unknown:
+BREAK:
+		goto slow;
+
+	//R-TYPE
+ADD:
+		SET( d->rd, (uint32_t) r[ d->rs ] + r[ d->rt ] );
+		NEXT();
+AND:
+		SET( d->rd, r[ d->rs ] & r[ d->rt ] );
+		NEXT();
+DIV:
+		if( DIVIDES( r[ d->rs ], r[ d->rt ] ) ) {
+			lo = r[ d->rs ] / r[ d->rt ];
+			hi = r[ d->rs ] % r[ d->rt ];
+		}
+		NEXT();
+DIVU:
+		if( r[ d->rt ] != 0 ) {
+			lo = (uint32_t) r[ d->rs ] / r[ d->rt ];
+			hi = (uint32_t) r[ d->rs ] % r[ d->rt ];
+		}
+		NEXT();
+JALR:
+		addr = r[ d->rs ];
+		SET( 31, pc_ + 4 );
+		pc_ = addr;
+		goto dispatch;
+JR:
+		pc_ = r[ d->rs ];
+		goto dispatch;
+MFHI:
+		SET( d->rd, hi );
+		NEXT();
+MFLO:
+		SET( d->rd, lo );
+		NEXT();
+MTHI:
+		hi = d->rd;
+		NEXT();
+MTLO:
+		lo = d->rd;
+		NEXT();
+MULT:
+		wide = (int64_t) r[ d->rs ] * r[ d->rt ];
+		lo = (uint32_t) wide;
+		hi = (uint32_t)( wide >> 32 );
+		NEXT();
+MULTU:
+		wide = (uint64_t)(uint32_t) r[ d->rs ] * (uint32_t) r[ d->rt ];
+		lo = (uint32_t) wide;
+		hi = (uint32_t)( wide >> 32 );
+		NEXT();
+NOR:
+		SET( d->rd, ~( r[ d->rs ] | r[ d->rt ] ) );
+		NEXT();
+OR:
+		SET( d->rd, r[ d->rs ] | r[ d->rt ] );
+		NEXT();
+XOR:
+		SET( d->rd, r[ d->rs ] ^ r[ d->rt ] );
+		NEXT();
+SLL:
+		SET( d->rd, (uint32_t) r[ d->rs ] << d->shamt );
+		NEXT();
+SLLV:
+		SET( d->rd, (uint32_t) r[ d->rs ] << r[ d->rt ] );
+		NEXT();
+SRL:
+		SET( d->rd, (uint32_t) r[ d->rs ] >> d->shamt );
+		NEXT();
+SRLV:
+		SET( d->rd, (uint32_t) r[ d->rs ] >> r[ d->rt ] );
+		NEXT();
+SLT:
+		SET( d->rd, ( r[ d->rs ] < r[ d->rt ] ) ? 1 : 0 );
+		NEXT();
+SLTU:
+		SET( d->rd, ( (uint32_t) r[ d->rs ] < (uint32_t) r[ d->rt ] ) ? 1 : 0 );
+		NEXT();
+SRA:
+		SET( d->rd, r[ d->rs ] >> d->shamt );
+		NEXT();
+SUB:
+		SET( d->rd, (uint32_t) r[ d->rs ] - r[ d->rt ] );
+		NEXT();
+
+	//J-TYPE
+J:
+		pc_ = ( pc_ & 0xf0000000 ) | ( d->immed << 2 );
+		goto dispatch;
+JAL:
+		SET( 31, pc_ + 8 );
+		pc_ = ( pc_ & 0xf0000000 ) | ( d->immed << 2 );
+		goto dispatch;
+
+	//I-TYPE
+ADDI:
+		SET( d->rt, (uint32_t) r[ d->rs ] + d->immed );
+		NEXT();
+ANDI:
+		SET( d->rt, r[ d->rs ] & d->immed );
+		NEXT();
+BEQ:
+		if( r[ d->rt ] == r[ d->rs ] )
+			pc_ += d->immed << 2;
+		else
+			pc_ += 4;
+		goto dispatch;
+NOP:
+		NEXT();
+BNE:
+		if( r[ d->rt ] != r[ d->rs ] )
+			pc_ += d->immed << 2;
+		else
+			pc_ += 4;
+		goto dispatch;
+LB:
+		SET( d->rt, (int8_t) mem->loadByte( r[ d->rs ] + d->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LBU:
+		SET( d->rt, mem->loadByte( r[ d->rs ] + d->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LH:
+		SET( d->rt, (int16_t) mem->loadHalfWord( r[ d->rs ] + d->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LHU:
+		SET( d->rt, mem->loadHalfWord( r[ d->rs ] + d->immed ) );
+		CHECK_FAULT();
+		NEXT();
+LUI:
+		SET( d->rt, d->immed << 16 );
+		NEXT();
+LW:
+		SET( d->rt, mem->loadWord( r[ d->rs ] + d->immed ) );
+		CHECK_FAULT();
+		NEXT();
+ORI:
+		SET( d->rt, r[ d->rs ] | d->immed );
+		NEXT();
+SB:
+		addr = r[ d->rs ] + d->immed;
+		mem->storeByte( addr, r[ d->rt ] );
+		if( addr - startAddr <= span )
+			textWritten( addr & ~3 );
+		CHECK_FAULT();
+		NEXT();
+SLTI:
+		SET( d->rt, ( r[ d->rs ] < d->immed ) ? 1 : 0 );
+		NEXT();
+SLTIU:
+		SET( d->rt, ( (uint32_t) r[ d->rs ] < (uint32_t) d->immed ) ? 1 : 0 );
+		NEXT();
+SH:
+		addr = r[ d->rs ] + d->immed;
+		mem->storeHalfWord( addr, r[ d->rt ] );
+		if( addr - startAddr <= span )
+			textWritten( addr & ~3 );
+		CHECK_FAULT();
+		NEXT();
+SW:
+		addr = r[ d->rs ] + d->immed;
+		mem->storeWord( addr, r[ d->rt ] );
+		if( addr - startAddr <= span )
+			textWritten( addr );
+		CHECK_FAULT();
+		NEXT();
+XORI:
+		SET( d->rt, r[ d->rs ] ^ d->immed );
+		NEXT();
+
+	} catch( ... ) {
+		if( !synced ) {
+			storeRegisters( r, hi, lo );
+			pc = pc_;
+		}
+		throw;
+	}
+
+done:
+	storeRegisters( r, hi, lo );
+	pc = pc_;
+	return budget - left;
+}
+
+void threadedProcessor::loadRegisters( int32_t *r, int32_t &hi, int32_t &lo ) const
+{
+	for( int i=0; i<REG_NR; ++i )
+		r[i] = reg->getReg( i );
+	hi = reg->getHI();
+	lo = reg->getLO();
+}
+
+void threadedProcessor::storeRegisters( const int32_t *r, int32_t hi, int32_t lo )
+{
+	for( int i=1; i<REG_NR; ++i )
+		reg->setReg( i, r[i] );
+	reg->setHI( hi );
+	reg->setLO( lo );
+}
@@ -0,0 +1,37 @@
+/*
+ * threadedProcessor.h
+ * The functional MIPS model run as threaded code.
+ * Predecoded instructions jump straight to the code
+ * of the next one (GCC computed goto) and registers
+ * stay in locals while it runs. Results are the same
+ * as simpleProcessor's.
+ */
+#ifndef __THREADED_PROCESSOR_H__
+#define __THREADED_PROCESSOR_H__
+
+#include "processor.h"
+
+class threadedProcessor : public simpleProcessor {
+
+public:
+	//run until an exception
+	virtual void run();
+
+	/*
+	 * Run at most budget instructions. Returns how many
+	 * were executed. Exceptions leave the registers and
+	 * pc as simpleProcessor would.
+	 */
+	uint64_t run( uint64_t budget );
+
+	threadedProcessor() : simpleProcessor() {}
+	threadedProcessor( Memory *mem, RegisterFile *reg, uint32_t startAddr, uint32_t endAddr ) : simpleProcessor( mem, reg, startAddr, endAddr ) {}
+
+private:
+	//copy the register file in and out of the locals
+	void loadRegisters( int32_t *r, int32_t &hi, int32_t &lo ) const;
+	void storeRegisters( const int32_t *r, int32_t hi, int32_t lo );
+
+};
+
+#endif /* __THREADED_PROCESSOR_H__ */
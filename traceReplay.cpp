@@ -0,0 +1,75 @@
+/*
+ * traceReplay.cpp
+ * Reads a trace of main -T. Prints what is in it, every
+ * record with -d, and with -C plays the accesses into the
+ * caches of main -C at the cycles they were recorded.
+ */
+#include "memory/trace.h"
+#include "memory/cache.h"
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static const char *kindNames[] = { "fetch", "read", "write" };
+
+static void usage( const char *name )
+{
+	fprintf( stderr, "usage: %s [-d] [-C] trace\n", name );
+	fprintf( stderr, "  -d prints every record, -C replays the accesses into 16K L1 caches and a 256K L2.\n" );
+	exit( 2 );
+}
+
+int main( int argc, char **argv )
+{
+	bool dump = false, withCaches = false;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "dCh" ) ) != -1 ) {
+		switch( opt ) {
+			case 'd': dump = true; break;
+			case 'C': withCaches = true; break;
+			default: usage( argv[0] );
+		}
+	}
+	if( optind != argc - 1 )
+		usage( argv[0] );
+
+	uint64_t counts[3] = { 0, 0, 0 };
+	uint64_t bytes[3] = { 0, 0, 0 };
+	uint64_t first = 0, last = 0;
+	cacheHierarchy caches( l1Config, l1Config, l2Config, MEM_LATENCY );
+
+	try {
+		traceReader trace( argv[ optind ] );
+		traceRecord r;
+		while( trace.next( r ) ) {
+			if( counts[0] + counts[1] + counts[2] == 0 )
+				first = r.cycle;
+			last = r.cycle;
+			++counts[ r.kind ];
+			bytes[ r.kind ] += r.size;
+
+			if( dump )
+				printf( "%llu %s pc %08x addr %08x size %u\n", (unsigned long long) r.cycle, kindNames[ r.kind ],
+					r.pc, r.addr, r.size );
+			if( withCaches ) {
+				if( r.kind == TRACE_FETCH )
+					caches.l1i.access( r.addr, false, r.pc, r.cycle );
+				else
+					caches.l1d.access( r.addr, r.kind == TRACE_WRITE, ( r.kind == TRACE_READ ) ? r.pc : NO_PC, r.cycle );
+			}
+		}
+	}
+	catch( const char *e ) {
+		fprintf( stderr, "%s: %s\n", argv[ optind ], e );
+		return 1;
+	}
+
+	for( int k=0; k<3; ++k )
+		printf( "%-6s %llu, %llu bytes\n", kindNames[k], (unsigned long long) counts[k], (unsigned long long) bytes[k] );
+	printf( "cycles %llu to %llu\n", (unsigned long long) first, (unsigned long long) last );
+	if( withCaches )
+		caches.printStats();
+	return 0;
+}